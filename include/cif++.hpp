@@ -28,7 +28,10 @@
 
 #include "cif++/utilities.hpp"
 #include "cif++/file.hpp"
+#include "cif++/bcif.hpp"
 #include "cif++/parser.hpp"
+#include "cif++/category_view.hpp"
+#include "cif++/category_writer.hpp"
 #include "cif++/format.hpp"
 
 #include "cif++/compound.hpp"
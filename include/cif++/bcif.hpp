@@ -0,0 +1,70 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/file.hpp"
+
+#include <istream>
+#include <ostream>
+
+/** \file bcif.hpp
+ *
+ * Reading and writing BinaryCIF. BinaryCIF is a MessagePack container
+ * in which the values of each item are stored as a column, encoded using
+ * run-length, delta, integer packing, fixed-point and string array
+ * encodings.
+ *
+ * Normally you don't need these functions, cif::file::load recognizes
+ * BinaryCIF data automatically and cif::file::save writes BinaryCIF when
+ * the file name has the extension .bcif, optionally followed by a
+ * compression extension like .gz
+ */
+
+namespace cif::bcif
+{
+
+/// \brief Return true if the data in @a is looks like BinaryCIF, this
+/// only peeks at the first character in @a is
+bool is_bcif(std::istream &is);
+
+/// \brief Read the BinaryCIF data in @a is and append the datablocks to @a f
+///
+/// Numbers stored as integer or fixed-point columns are converted to text
+/// without the need for text parsing. Masked values are stored as '.' or '?'.
+void read(std::istream &is, file &f);
+
+/// \brief Write the contents of @a f to @a os in BinaryCIF format
+///
+/// For each item an encoding is selected based on its values. Items
+/// containing only integers are stored as integers, items containing
+/// numbers with a fixed number of decimals are stored using fixed-point
+/// encoding. Both use the smallest of delta, run-length and integer
+/// packing encodings. All other items are stored as string arrays.
+/// The text of each value is preserved exactly.
+void write(std::ostream &os, const file &f);
+
+} // namespace cif::bcif
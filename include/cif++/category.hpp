@@ -31,10 +31,14 @@
 #include "cif++/condition.hpp"
 #include "cif++/iterator.hpp"
 #include "cif++/row.hpp"
+#include "cif++/statistics.hpp"
 #include "cif++/text.hpp"
 #include "cif++/validate.hpp"
 
 #include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 
 /** \file category.hpp
  * Documentation for the cif::category class
@@ -114,6 +118,30 @@ template <typename _Tp>
 inline constexpr bool is_optional_v<std::optional<_Tp>> = true;
 /// \endcond
 
+/** @cond */
+namespace detail
+{
+	class write_buffer;
+}
+/** @endcond */
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief Set the number of threads used to write datablocks and categories
+ *
+ * When @a n is larger than one, the categories of a datablock are formatted
+ * concurrently and the rows of large categories are formatted in partitions.
+ * The output is the same as when writing sequentially.
+ *
+ * @param n The number of threads, zero means use the number of hardware threads.
+ * The default is one, writing sequentially.
+ */
+void set_write_thread_count(size_t n);
+
+/// @brief Return the number of threads used for writing, see set_write_thread_count
+size_t get_write_thread_count();
+
 // --------------------------------------------------------------------
 
 /// The class category is a sequence container for rows of data values.
@@ -133,6 +161,12 @@ class category
 	template <typename, typename...>
 	friend class iterator_impl;
 
+	template <typename, typename...>
+	friend class conditional_iterator_proxy;
+
+	template <typename, typename...>
+	friend class query_proxy;
+
 	using value_type = row_handle;
 	using reference = value_type;
 	using const_reference = const value_type;
@@ -209,6 +243,31 @@ class category
 	/// @return Returns true is all validations pass
 	bool validate_links() const;
 
+	/// @brief Like is_valid, but only the values in rows that were added or
+	/// modified since the last validation without errors are checked. The
+	/// first validation and the first after changing the items or the
+	/// validator check all rows.
+	/// @return Returns true is all validations pass
+	bool is_valid_incremental() const;
+
+	/// @brief Like validate_links, but only the links of rows that were added
+	/// or modified since the last successful validation are checked. All rows are
+	/// checked for links to a parent that had rows removed or key values changed.
+	/// @return Returns true is all validations pass
+	bool validate_links_incremental() const;
+
+	// --------------------------------------------------------------------
+
+	/// @brief Return the statistics for the item named @a item_name. The first
+	/// call collects the statistics for all items in a single pass, after that
+	/// they are updated as rows are added, modified or removed.
+	/// For an item that does not exist all rows are counted as unknown.
+	/// This may be called concurrently, but not while the category is modified.
+	item_statistics get_item_statistics(std::string_view item_name) const;
+
+	/// @brief Return the statistics for all items in this category
+	std::vector<item_statistics> get_item_statistics() const;
+
 	/// @brief Equality operator, returns true if @a rhs is equal to this
 	/// @param rhs The object to compare with
 	/// @return True if the data contained is equal
@@ -295,7 +354,7 @@ class category
 	/// Return a count of the rows in this container
 	size_t size() const
 	{
-		return std::distance(cbegin(), cend());
+		return m_row_count;
 	}
 
 	/// Return the theoretical maximum number or rows that can be stored
@@ -381,6 +440,10 @@ class category
 	///    .. // do something with rh
 	/// @endcode
 	///
+	/// Numeric comparisons (<, <=, > and >=) on the first key item of the category
+	/// are answered using the index. In that case the rows are returned in the
+	/// order of that key instead of the order in the category.
+	///
 	/// @param cond The condition for the query
 	/// @return A special iterator that loops over all elements that match. The iterator can be dereferenced
 	/// to a @ref row_handle
@@ -427,6 +490,33 @@ class category
 		return conditional_iterator_proxy<const category>{ *this, pos, std::move(cond) };
 	}
 
+	/// @brief Return a special iterator to loop over all rows that conform to
+	/// the prepared condition @a cond. The condition is not copied, it should
+	/// outlive the result. Use this version when the condition contains parameters
+	/// and is reused with different values bound.
+	///
+	/// @param cond The prepared condition for the query
+	/// @return A special iterator that loops over all elements that match. The iterator can be dereferenced
+	/// to a @ref row_handle
+
+	conditional_iterator_proxy<category> find(const condition &cond)
+	{
+		return { *this, begin(), cond };
+	}
+
+	/// @brief Return a special const iterator to loop over all rows that conform to
+	/// the prepared condition @a cond. The condition is not copied, it should
+	/// outlive the result.
+	///
+	/// @param cond The prepared condition for the query
+	/// @return A special iterator that loops over all elements that match. The iterator can be dereferenced
+	/// to a const @ref row_handle
+
+	conditional_iterator_proxy<const category> find(const condition &cond) const
+	{
+		return conditional_iterator_proxy<const category>{ *this, cbegin(), cond };
+	}
+
 	/// @brief Return a special iterator to loop over all rows that conform to @a cond. The resulting
 	/// iterator can be used in a structured binding context.
 	///
@@ -494,6 +584,30 @@ class category
 		return { *this, pos, std::move(cond), std::forward<Ns>(names)... };
 	}
 
+	// --------------------------------------------------------------------
+	// lazy queries
+
+	/// @brief Start a lazy query on this category, see @ref query_proxy
+	///
+	/// @code{.cpp}
+	/// for (const auto &[x, y, z] : cat.query().where(cif::key("type_symbol") == "C").select<float, float, float>("Cartn_x", "Cartn_y", "Cartn_z").limit(10))
+	///    .. // do something with x, y and z
+	/// @endcode
+	///
+	/// @return A query_proxy returning all rows, to be refined using where, select and limit
+	query_proxy<category> query()
+	{
+		return { *this };
+	}
+
+	/// @brief Start a lazy query on this const category, see @ref query_proxy
+	///
+	/// @return A query_proxy returning all rows, to be refined using where, select and limit
+	query_proxy<const category> query() const
+	{
+		return { *this };
+	}
+
 	// --------------------------------------------------------------------
 	// if you only expect a single row
 
@@ -807,11 +921,42 @@ class category
 		if (cond)
 		{
 			cond.prepare(*this);
+			result = contains(std::as_const(cond));
+		}
 
+		return result;
+	}
+
+	/// @brief Return whether a row exists that matches the prepared condition @a cond.
+	/// Use this version when the condition contains parameters and is
+	/// reused with different values bound.
+	/// @param cond The prepared condition to match
+	/// @return True if a row exists
+	bool contains(const condition &cond) const
+	{
+		assert(cond.empty() or cond.is_prepared());
+
+		bool result = false;
+
+		if (not cond.empty())
+		{
 			auto sh = cond.single();
 
-			if (sh.has_value() and *sh)
-				result = true;
+			std::vector<row *> candidates;
+
+			if (sh.has_value())
+				result = (bool)*sh;
+			else if (auto range = cond.range(); range.has_value() and find_in_index(*range, candidates))
+			{
+				for (auto r : candidates)
+				{
+					if (cond({ *this, *r }))
+					{
+						result = true;
+						break;
+					}
+				}
+			}
 			else
 			{
 				for (auto r : *this)
@@ -838,19 +983,29 @@ class category
 		if (cond)
 		{
 			cond.prepare(*this);
+			result = count(std::as_const(cond));
+		}
+
+		return result;
+	}
+
+	/// @brief Return the total number of rows that match the prepared condition @a cond
+	/// @param cond The prepared condition to match
+	/// @return The count
+	size_t count(const condition &cond) const
+	{
+		assert(cond.empty() or cond.is_prepared());
+
+		size_t result = 0;
 
+		if (not cond.empty())
+		{
 			auto sh = cond.single();
 
-			if (sh.has_value() and *sh)
-				result = 1;
+			if (sh.has_value())
+				result = *sh ? 1 : 0;
 			else
-			{
-				for (auto r : *this)
-				{
-					if (cond(r))
-						++result;
-				}
-			}
+				result = count_matches(cond);
 		}
 
 		return result;
@@ -878,6 +1033,32 @@ class category
 	/// for all rows in @a cat that are in any way linked to row @a r
 	std::vector<row_handle> get_linked(row_handle r, const category &cat) const;
 
+	/// @brief The result type for join, each row in this category paired with
+	/// the rows in the other category it is linked to.
+	using join_result_type = std::vector<std::pair<row_handle, std::vector<row_handle>>>;
+
+	/// @brief Using the relation defined in @a link, return for every row in this
+	/// category the rows in @a other that are linked to it.
+	///
+	/// The link may point either way, this category can be the parent or
+	/// the child in @a link. The matching is done using a hash join, making
+	/// the cost linear in the size of both categories instead of doing a find
+	/// in @a other for each row in this category.
+	///
+	/// Matching follows the same rules as get_parents: empty child key values
+	/// are skipped and values are compared case insensitive for items of type
+	/// uchar. Child rows without any key value are not linked at all.
+	///
+	/// @param other The other category, parent or child in @a link
+	/// @param link The link_validator describing the relation
+	/// @return A vector with an entry for each row in this category, in order
+	join_result_type join(const category &other, const link_validator &link) const;
+
+	/// @brief Like join above, but now using all links defined in the validator
+	/// between this category and @a other. Rows linked through more than one
+	/// link are reported only once.
+	join_result_type join(const category &other) const;
+
 	// --------------------------------------------------------------------
 
 	// void insert(const_iterator pos, const row_initializer &row)
@@ -912,6 +1093,13 @@ class category
 	/// @return The number of rows that have been erased
 	size_t erase(condition &&cond, std::function<void(row_handle)> &&visit);
 
+	/// @brief Erase all rows that match the prepared condition @a cond, the condition
+	/// can be reused afterwards. Rows in child categories that are no longer linked
+	/// are removed as well.
+	/// @param cond The prepared condition
+	/// @return The number of rows that have been erased
+	size_t erase(const condition &cond);
+
 	/// @brief Emplace the values in @a ri in a new row
 	/// @param ri An object containing the values to insert
 	/// @return iterator to the newly created row
@@ -1131,6 +1319,7 @@ class category
 			}
 
 			m_items.emplace_back(item_name, item_validator);
+			drop_source_text();
 		}
 
 		return result;
@@ -1191,8 +1380,37 @@ class category
 	/// @param addMissingItems When false, empty items are suppressed from the output
 	void write(std::ostream &os, const std::vector<std::string> &order, bool addMissingItems = true);
 
+	/// @brief Return the text this category was parsed from, or an empty string_view
+	///
+	/// The text is only available when the file was loaded after calling
+	/// file::set_keep_source_text and the category was not modified since.
+	/// In that case write(std::ostream &) writes this text verbatim.
+	std::string_view get_source_text() const
+	{
+		return m_source_text;
+	}
+
   private:
 	void write(std::ostream &os, const std::vector<uint16_t> &order, bool includeEmptyItems) const;
+	void write(detail::write_buffer &buffer, const std::vector<uint16_t> &order) const;
+
+	/// Write the text this category was parsed from, returns false if there is none
+	bool write_source_text(detail::write_buffer &buffer) const;
+
+	friend class parser;
+
+	void set_source_text(std::shared_ptr<const std::string> source, std::string_view text)
+	{
+		m_source = std::move(source);
+		m_source_text = text;
+	}
+
+	/// Forget the source text, called for each modification
+	void drop_source_text()
+	{
+		m_source.reset();
+		m_source_text = {};
+	}
 
   public:
 	/// friend function to make it possible to do:
@@ -1210,6 +1428,45 @@ class category
 
 	void erase_orphans(condition &&cond, category &parent);
 
+	size_t erase_impl(const condition &cond, const std::function<void(row_handle)> &visit);
+
+	size_t count_matches(const condition &cond) const;
+
+	friend class datablock;
+
+	/// Append the work needed to validate this category to @a tasks,
+	/// the items first and then the rows in one or more partitions.
+	void add_validation_tasks(std::vector<std::function<bool()>> &tasks, bool incremental) const;
+
+	bool validate_items() const;
+	bool validate_rows(const row *first, const row *last, bool &clean) const;
+	bool validate_links(bool incremental) const;
+
+	/// Return the rows in @a rows in the order in which they appear in this
+	/// category, so that errors are reported in a stable order
+	std::vector<const row *> in_row_order(const std::unordered_set<const row *> &rows) const;
+
+	/// Record that row @a r was added or modified, for incremental validation
+	void mark_modified(const row *r);
+
+	/// Record a change that may leave rows in child categories without parent
+	void mark_parent_changed();
+
+	/// Return the statistics counters for item @a ix if statistics are maintained
+	detail::item_counters *get_item_counters(uint16_t ix) const;
+
+	/// Update the statistics for row @a r being added or removed
+	void add_to_statistics(const row *r);
+	void remove_from_statistics(const row *r);
+
+	/// Make sure the statistics for all items are up to date, m_mutex must be locked
+	void collect_statistics() const;
+
+	/// Collect the rows in @a rows that have a value for the first key item
+	/// in @a range, using the index. The rows are in the order of the index.
+	/// Returns false if the index cannot be used for this.
+	bool find_in_index(const key_range &range, std::vector<row *> &rows) const;
+
 	using allocator_type = std::allocator<void>;
 
 	constexpr allocator_type get_allocator() const
@@ -1292,6 +1549,28 @@ class category
 	uint32_t m_last_unique_num = 0;
 	class category_index *m_index = nullptr;
 	row *m_head = nullptr, *m_tail = nullptr;
+	size_t m_row_count = 0;
+
+	// Guards the state that is updated by const methods, so these can be
+	// called concurrently
+	mutable std::mutex m_mutex;
+
+	// Statistics for the items, only maintained after they were requested once
+	mutable std::unique_ptr<std::vector<detail::item_counters>> m_statistics;
+
+	// State for incremental validation, rows are only tracked
+	// after a validation of all rows was done. Validation updates
+	// this state while holding m_mutex.
+	mutable std::unordered_set<const row *> m_modified_rows, m_modified_link_rows;
+	mutable bool m_validate_all_rows = true, m_validate_all_links = true;
+	uint64_t m_parent_revision = next_parent_revision();
+	mutable std::map<const category *, uint64_t> m_validated_parent_revisions;
+
+	// The text this category was parsed from, as long as it was not modified
+	std::shared_ptr<const std::string> m_source;
+	std::string_view m_source_text;
+
+	static uint64_t next_parent_revision();
 };
 
 } // namespace cif
@@ -0,0 +1,213 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2022 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/category.hpp"
+
+#include <array>
+#include <iosfwd>
+#include <limits>
+#include <string_view>
+
+/**
+ * @file category_view.hpp
+ *
+ * Base classes for typed views on categories. The classes deriving from
+ * these are normally generated from a dictionary by the category-view-generator
+ * tool, e.g.:
+ *
+ * @code {.cpp}
+ * pdbx::atom_site_view atom_site(db["atom_site"]);
+ *
+ * for (auto r : atom_site)
+ *     std::cout << r.label_atom_id() << ' ' << r.cartn_x() << '\n';
+ * @endcode
+ *
+ * The names of the items are looked up only once, when the view is
+ * constructed. Accessing a value in a row is then a simple index
+ * operation followed by a conversion to the type specified in the
+ * dictionary.
+ */
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief Base class for a typed row in a category_view
+ *
+ * @tparam N The number of items in the category
+ */
+template <size_t N>
+class category_row_view
+{
+  public:
+	/// @brief The index stored for items that were not in the category
+	/// when the view was constructed
+	static constexpr uint16_t k_missing_item = std::numeric_limits<uint16_t>::max();
+
+	/// @brief Constructor taking a row_handle @a rh and the item indices @a item_ix
+	/// for the items in the view
+	category_row_view(row_handle rh, const std::array<uint16_t, N> &item_ix)
+		: m_row(rh)
+		, m_item_ix(&item_ix)
+	{
+	}
+
+	/// @brief Return the row_handle for this row
+	row_handle handle() const { return m_row; }
+
+	/// @brief Return true if this row is empty or uninitialised
+	bool empty() const { return m_row.empty(); }
+
+	/// @brief Convenience method to test for not empty()
+	explicit operator bool() const { return not empty(); }
+
+  protected:
+	/// @brief Return the item_handle for the item at position @a ix in the view
+	const item_handle item(size_t ix) const
+	{
+		auto item_ix = (*m_item_ix)[ix];
+		if (item_ix == k_missing_item)
+			return item_handle::s_null_item;
+		return std::as_const(m_row)[item_ix];
+	}
+
+	/// @brief Return the value of the item at position @a ix in the view
+	/// converted to type @a T
+	template <typename T>
+	T get(size_t ix) const
+	{
+		return item(ix).template as<T>();
+	}
+
+  private:
+	row_handle m_row;
+	const std::array<uint16_t, N> *m_item_ix;
+};
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief Base class for a typed view on a category
+ *
+ * The indices of the items named in the constructor are bound once. Items
+ * that do not exist in the category at that time will return empty
+ * values, also when they are added to the category later on. The rows returned by a view refer to the view, they should not
+ * outlive it.
+ *
+ * @tparam Row The typed row class, derived from category_row_view<N>
+ * @tparam N The number of items in the category
+ */
+template <typename Row, size_t N>
+class category_view
+{
+  public:
+	using row_type = Row; ///< The typed row class
+
+	/// @brief The iterator for a category_view, returns objects of type Row
+	class iterator
+	{
+	  public:
+		/** @cond */
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Row;
+		using difference_type = std::ptrdiff_t;
+		using pointer = value_type *;
+		using reference = value_type;
+
+		iterator(const category_view &view, category::const_iterator pos)
+			: m_view(&view)
+			, m_current(pos)
+		{
+		}
+
+		reference operator*() const { return (*m_view)(m_current); }
+
+		iterator &operator++()
+		{
+			++m_current;
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator result(*this);
+			++m_current;
+			return result;
+		}
+
+		bool operator==(const iterator &rhs) const { return m_current == rhs.m_current; }
+		bool operator!=(const iterator &rhs) const { return m_current != rhs.m_current; }
+		/** @endcond */
+
+	  private:
+		const category_view *m_view;
+		category::const_iterator m_current;
+	};
+
+	/// @brief Constructor, looks up the indices for the items named in @a item_names in @a cat
+	category_view(const category &cat, const std::array<std::string_view, N> &item_names)
+		: m_cat(&cat)
+	{
+		for (size_t i = 0; i < N; ++i)
+			m_item_ix[i] = cat.has_item(item_names[i]) ? cat.get_item_ix(item_names[i]) : Row::k_missing_item;
+	}
+
+	category_view(const category_view &) = delete;
+	category_view &operator=(const category_view &) = delete;
+
+	iterator begin() const { return { *this, m_cat->begin() }; } ///< Return an iterator to the first row
+	iterator end() const { return { *this, m_cat->end() }; }     ///< Return an iterator past the last row
+
+	size_t size() const { return m_cat->size(); } ///< Return the number of rows
+	bool empty() const { return m_cat->empty(); } ///< Return true if the category is empty
+
+	/// @brief Return the typed row for row_handle @a rh, e.g. the result of category::find1
+	Row operator()(row_handle rh) const { return Row(rh, m_item_ix); }
+
+	const category &get_category() const { return *m_cat; } ///< The category this view acts upon
+
+  private:
+	const category *m_cat;
+	std::array<uint16_t, N> m_item_ix;
+};
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief Write the typed row and view classes for the category described
+ * by @a cv to @a os. This is what category-view-generator writes for each
+ * category in a dictionary.
+ *
+ * Items of type int and positive_int are returned as int, items of type
+ * float as float. All other types are returned as std::string.
+ */
+void write_category_view(std::ostream &os, const category_validator &cv);
+
+} // namespace cif
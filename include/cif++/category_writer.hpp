@@ -0,0 +1,220 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/category.hpp"
+
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file category_writer.hpp
+ *
+ * A writer for very large categories that writes rows as they are added,
+ * without building a cif::category in memory first, e.g.:
+ *
+ * @code {.cpp}
+ * cif::category_writer w(std::cout, "atom_site", { "group_PDB", "id", "type_symbol", "Cartn_x" });
+ * w.set_precision("Cartn_x", 3);
+ *
+ * for (auto &atom : atoms)
+ *     w.emplace_row("ATOM", atom.id, atom.symbol, atom.x);
+ *
+ * w.close();
+ * @endcode
+ *
+ * The output is formatted like cif::category::write formats it, that is
+ * a loop_ or, when only a single row was written, a list of item/value pairs.
+ * Since the widths of the items are needed before writing the first row,
+ * these are either specified up front or calculated from a sample of the
+ * first rows. Values that do not fit are still written correctly, they
+ * merely break the alignment of the columns.
+ */
+
+namespace cif
+{
+
+namespace detail
+{
+	class write_buffer;
+}
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief Write the rows of a category to a std::ostream as they are added
+ *
+ * Memory use does not depend on the number of rows written.
+ */
+class category_writer
+{
+  public:
+	/// @brief The number of rows used to calculate the widths of the items by default
+	static constexpr size_t kDefaultSampleSize = 1000;
+
+	/**
+	 * @brief Construct a writer for category @a name with items @a items
+	 * writing to @a os. The widths of the items are calculated from the
+	 * first @a sample_size rows, these rows are kept in memory until
+	 * the widths are known.
+	 */
+	category_writer(std::ostream &os, std::string_view name, std::vector<std::string> items,
+		size_t sample_size = kDefaultSampleSize);
+
+	/**
+	 * @brief Construct a writer for category @a name with items @a items
+	 * writing to @a os. The item at index i has width @a widths[i], the
+	 * number of characters the values in that item normally take. Rows
+	 * are written immediately, except for the first which is kept until
+	 * it is known whether a loop_ is needed.
+	 */
+	category_writer(std::ostream &os, std::string_view name, std::vector<std::string> items,
+		std::vector<size_t> widths);
+
+	category_writer(const category_writer &) = delete;
+	category_writer &operator=(const category_writer &) = delete;
+
+	/// @brief Destructor, calls close. Errors are not reported, except
+	/// on std::cerr when VERBOSE is set. Call close to see them.
+	~category_writer();
+
+	/**
+	 * @brief Format floating point values for the item named @a item using
+	 * fixed notation with @a precision decimals. By default the shortest
+	 * representation is used.
+	 */
+	void set_precision(std::string_view item, int precision);
+
+	/**
+	 * @brief Write a row with @a values, one for each item in the order
+	 * specified in the constructor.
+	 *
+	 * Values can be strings, characters, numbers, booleans or std::optional
+	 * values. Numbers are formatted using std::to_chars, a char is written
+	 * as a single character. Empty strings and
+	 * std::optional values without a value are written as '?'
+	 */
+	template <typename... Ts>
+	void emplace_row(const Ts &...values)
+	{
+		if (sizeof...(Ts) != m_items.size())
+			throw std::runtime_error("Incorrect number of values for category " + m_name);
+
+		m_row.clear();
+		m_row_ends.clear();
+
+		size_t ix = 0;
+		(append_value(ix++, values), ...);
+
+		end_row();
+	}
+
+	/**
+	 * @brief Write the sampled rows, if any, and the end of the category.
+	 * Nothing is written for a category without rows. Throws a
+	 * std::runtime_error when writing to the std::ostream failed.
+	 */
+	void close();
+
+	/// @brief The number of rows written so far
+	size_t row_count() const { return m_row_count; }
+
+  private:
+	template <typename T>
+	void append_value(size_t ix, const T &value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+			m_row += value ? 'y' : 'n';
+		else if constexpr (std::is_same_v<T, char>)
+			m_row += value;
+		else if constexpr (std::is_integral_v<T>)
+		{
+			char b[32];
+			auto r = std::to_chars(b, b + sizeof(b), value);
+			m_row.append(b, r.ptr);
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			using namespace std;
+			using namespace cif;
+
+			char b[64];
+			to_chars_result r = m_precision[ix] >= 0
+			                        ? to_chars(b, b + sizeof(b), value, chars_format::fixed, m_precision[ix])
+			                        : to_chars(b, b + sizeof(b), value, chars_format::general);
+			if ((bool)r.ec)
+				throw std::runtime_error("Could not format number");
+			m_row.append(b, r.ptr);
+		}
+		else if constexpr (is_optional_v<T>)
+		{
+			if (value.has_value())
+			{
+				append_value(ix, *value);
+				return;
+			}
+		}
+		else
+			m_row += std::string_view{ value };
+
+		m_row_ends.push_back(m_row.length());
+	}
+
+	void end_row();
+	void write_header();
+	void write_sample();
+	void write_single_row();
+	void write_row(std::string_view text, const size_t *ends);
+
+	std::ostream &m_os;
+	std::unique_ptr<detail::write_buffer> m_buffer;
+	std::string m_name;
+	std::vector<std::string> m_items;
+	std::vector<size_t> m_widths;
+	std::vector<int> m_precision;
+
+	// the current row, the values are concatenated
+	std::string m_row;
+	std::vector<size_t> m_row_ends;
+
+	// the sampled rows while the widths are not known yet, the ends
+	// of the values are relative to the start of each row
+	size_t m_sample_size = 0;
+	std::string m_sample;
+	std::vector<size_t> m_sample_ends;
+
+	size_t m_row_count = 0;
+	bool m_header_written = false;
+	bool m_closed = false;
+};
+
+} // namespace cif
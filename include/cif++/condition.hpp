@@ -28,10 +28,15 @@
 
 #include "cif++/row.hpp"
 
+#include <array>
+#include <bitset>
 #include <cassert>
+#include <cmath>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <regex>
+#include <span>
 #include <utility>
 
 /** \file condition.hpp
@@ -94,6 +99,22 @@
  * @code{.cpp}
  * auto c8 = std::move(c3) and std::move(c5);
  * @endcode
+ *
+ * When the same query has to be executed many times with different
+ * values, e.g. in a loop, you can use parameters instead of values.
+ * The condition is then prepared once and the actual values are
+ * bound before each use:
+ *
+ * @code{.cpp}
+ * auto c9 = "asym_id"_key == cif::parameter(0) and "seq_id"_key == cif::parameter(1);
+ * c9.prepare(cat);
+ *
+ * for (auto &[asym_id, seq_id] : residues)
+ * {
+ *   if (cat.contains(c9.bind(asym_id, seq_id)))
+ *     ...
+ * }
+ * @endcode
  */
 
 namespace cif
@@ -139,26 +160,106 @@ uint16_t get_item_ix(const category &cat, std::string_view col);
  */
 bool is_item_type_uchar(const category &cat, std::string_view col);
 
+/**
+ * @brief Return whether the item @a col is the first key item in the index of
+ * category @a cat and has a numeric type. Numeric comparisons on such an
+ * item can use the index of the category.
+ * 
+ * @param cat The category
+ * @param col The item name
+ * @param integral Additionally require the type of the item to be an integer type
+ * @return true If the item is the first key item with a numeric type
+ */
+bool is_first_key_numeric(const category &cat, std::string_view col, bool integral);
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief A range of values for the first key item of a category. A condition
+ * that can only match rows with a value in this range can be answered by
+ * walking the index of the category instead of testing all rows.
+ *
+ * The range is a superset, the rows found still need to be tested.
+ */
+struct key_range
+{
+	std::optional<double> m_lower;     ///< The inclusive lower bound, if any
+	std::optional<double> m_upper;     ///< The inclusive upper bound, if any
+	bool m_with_empty = false;         ///< Include rows with an empty value
+	bool m_with_invalid = false;       ///< Include rows with a value that is not a number
+
+	/// Return the intersection of this range with @a rhs
+	key_range operator&(const key_range &rhs) const
+	{
+		key_range result(*this);
+
+		if (rhs.m_lower.has_value() and (not m_lower.has_value() or *rhs.m_lower > *m_lower))
+			result.m_lower = rhs.m_lower;
+		if (rhs.m_upper.has_value() and (not m_upper.has_value() or *rhs.m_upper < *m_upper))
+			result.m_upper = rhs.m_upper;
+
+		result.m_with_empty = m_with_empty and rhs.m_with_empty;
+		result.m_with_invalid = m_with_invalid and rhs.m_with_invalid;
+
+		return result;
+	}
+};
+
+// --------------------------------------------------------------------
+
+/// The number of rows a condition evaluates at once, see condition::filter
+inline constexpr size_t kConditionBlockSize = 1024;
+
+/// The selection bitmap for a block of rows, see condition::filter
+using block_selection = std::bitset<kConditionBlockSize>;
+
 // --------------------------------------------------------------------
 // some more templates to be able to do querying
 
 namespace detail
 {
+	/// Return whether the value @a v is empty, as in item_handle::empty
+	inline bool is_empty_value(const item_value *v)
+	{
+		if (v == nullptr)
+			return true;
+
+		auto txt = v->text();
+		return txt.empty() or (txt.length() == 1 and (txt.front() == '.' or txt.front() == '?'));
+	}
+
+	/// Return the text for value @a v which may be nullptr
+	inline std::string_view value_text(const item_value *v)
+	{
+		return v != nullptr ? v->text() : std::string_view{};
+	}
+
 	struct condition_impl
 	{
 		virtual ~condition_impl() {}
 
 		virtual condition_impl *prepare(const category &) { return this; }
+		virtual void bind([[maybe_unused]] std::span<const std::string_view> values) {}
 		virtual bool test(row_handle) const = 0;
+
+		/// Clear the bits in @a selection for those rows in @a rows that do not match.
+		/// Rows that have their bit cleared on entry are not tested. The default
+		/// tests the rows one by one.
+		virtual void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const;
+
 		virtual void str(std::ostream &) const = 0;
 		virtual std::optional<row_handle> single() const { return {}; };
 
+		/// Return the range of values of the first key item matching rows can have, if known
+		virtual std::optional<key_range> range() const { return {}; }
+
 		virtual bool equals([[maybe_unused]] const condition_impl *rhs) const { return false; }
 	};
 
 	struct all_condition_impl : public condition_impl
 	{
 		bool test(row_handle) const override { return true; }
+		void filter(const category &, std::span<const row *const>, block_selection &) const override {}
 		void str(std::ostream &os) const override { os << "*"; }
 	};
 
@@ -207,6 +308,7 @@ class condition
 		: m_impl(nullptr)
 	{
 		std::swap(m_impl, rhs.m_impl);
+		std::swap(m_prepared, rhs.m_prepared);
 	}
 
 	condition &operator=(const condition &) = delete;
@@ -217,6 +319,7 @@ class condition
 	condition &operator=(condition &&rhs) noexcept
 	{
 		std::swap(m_impl, rhs.m_impl);
+		std::swap(m_prepared, rhs.m_prepared);
 		return *this;
 	}
 
@@ -234,6 +337,49 @@ class condition
 	 */
 	void prepare(const category &c);
 
+	/**
+	 * @brief Return true if this condition was prepared
+	 */
+	bool is_prepared() const { return m_prepared; }
+
+	/**
+	 * @brief Bind the values in @a values to the parameters in this
+	 * condition. The value at index N is assigned to cif::parameter(N).
+	 * An empty value will match empty items, just like comparing a key
+	 * to an empty string.
+	 *
+	 * The condition should have been prepared before and can be reused
+	 * with new values as often as needed.
+	 *
+	 * @param values The values for the parameters
+	 * @return condition& Reference to this, for easy chaining
+	 */
+	condition &bind(std::span<const std::string_view> values)
+	{
+		assert(m_prepared);
+		if (m_impl)
+			m_impl->bind(values);
+		return *this;
+	}
+
+	/**
+	 * @brief Bind the values @a values to the parameters in this condition,
+	 * the first value is assigned to cif::parameter(0), the second to
+	 * cif::parameter(1), etc.
+	 *
+	 * @param values The values for the parameters
+	 * @return condition& Reference to this, for easy chaining
+	 */
+	template <typename... Ts>
+		requires(not(sizeof...(Ts) == 1 and (std::is_convertible_v<Ts, std::span<const std::string_view>> and ...)))
+	condition &bind(const Ts &...values)
+	{
+		std::array<std::string, sizeof...(Ts)> v{ item(std::string_view{}, values).value()... };
+		std::array<std::string_view, sizeof...(Ts)> sv;
+		std::copy(v.begin(), v.end(), sv.begin());
+		return bind(std::span<const std::string_view>(sv));
+	}
+
 	/**
 	 * @brief This operator returns true if the row referenced by @a r is 
 	 * a match for this condition.
@@ -249,6 +395,28 @@ class condition
 		return m_impl ? m_impl->test(r) : false;
 	}
 
+	/**
+	 * @brief Evaluate the condition for a block of rows at once. This is
+	 * more efficient than testing each row separately since the simple
+	 * tests are done in tight loops over all rows in the block.
+	 *
+	 * @param cat The category the rows belong to, the condition should have
+	 * been prepared for this category
+	 * @param rows The rows to test, at most kConditionBlockSize
+	 * @param selection On entry the rows to consider, on exit the bits for rows
+	 * that do not match are cleared
+	 */
+	void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const
+	{
+		assert(m_prepared);
+		assert(rows.size() <= kConditionBlockSize);
+
+		if (m_impl)
+			m_impl->filter(cat, rows, selection);
+		else
+			selection.reset();
+	}
+
 	/**
 	 * @brief Return true if the condition is not empty
 	 */
@@ -271,6 +439,19 @@ class condition
 		return m_impl ? m_impl->single() : std::optional<row_handle>();
 	}
 
+	/**
+	 * @brief If the prepare step found out all matching rows have a value
+	 * for the first key item of the category in a certain range, this
+	 * range is returned. The category can then find the candidate rows
+	 * using its index.
+	 *
+	 * @return std::optional<key_range> The range, if known
+	 */
+	std::optional<key_range> range() const
+	{
+		return m_impl ? m_impl->range() : std::optional<key_range>();
+	}
+
 	friend condition operator||(condition &&a, condition &&b); /**< Return a condition which is the logical OR or condition @a and @b */
 	friend condition operator&&(condition &&a, condition &&b); /**< Return a condition which is the logical AND or condition @a and @b */
 
@@ -330,6 +511,15 @@ namespace detail
 			return r[m_item_ix].empty();
 		}
 
+		void filter(const category &, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (selection[i] and not is_empty_value(rows[i]->get(m_item_ix)))
+					selection[i] = false;
+			}
+		}
+
 		void str(std::ostream &os) const override
 		{
 			os << m_item_name << " IS NULL";
@@ -357,6 +547,15 @@ namespace detail
 			return not r[m_item_ix].empty();
 		}
 
+		void filter(const category &, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (selection[i] and is_empty_value(rows[i]->get(m_item_ix)))
+					selection[i] = false;
+			}
+		}
+
 		void str(std::ostream &os) const override
 		{
 			os << m_item_name << " IS NOT NULL";
@@ -381,6 +580,8 @@ namespace detail
 			return m_single_hit.has_value() ? *m_single_hit == r : r[m_item_ix].compare(m_value, m_icase) == 0;
 		}
 
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override;
+
 		void str(std::ostream &os) const override
 		{
 			os << m_item_name << (m_icase ? "^ " : " ") << " == " << m_value;
@@ -439,6 +640,8 @@ namespace detail
 			return result;
 		}
 
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override;
+
 		void str(std::ostream &os) const override
 		{
 			os << '(' << m_item_name << (m_icase ? "^ " : " ") << " == " << m_value << " OR " << m_item_name << " IS NULL)";
@@ -470,6 +673,50 @@ namespace detail
 		std::optional<row_handle> m_single_hit;
 	};
 
+	struct key_equals_parameter_condition_impl : public condition_impl
+	{
+		key_equals_parameter_condition_impl(const std::string &item_name, size_t param_ix)
+			: m_item_name(item_name)
+			, m_param_ix(param_ix)
+		{
+		}
+
+		condition_impl *prepare(const category &c) override;
+		void bind(std::span<const std::string_view> values) override;
+
+		bool test(row_handle r) const override
+		{
+			if (m_single_hit.has_value())
+				return *m_single_hit == r;
+			if (m_value.empty())
+				return r[m_item_ix].empty();
+			return r[m_item_ix].compare(m_value, m_icase) == 0;
+		}
+
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override;
+
+		void str(std::ostream &os) const override
+		{
+			os << m_item_name << (m_icase ? "^ " : " ") << " == ?" << m_param_ix;
+		}
+
+		virtual std::optional<row_handle> single() const override
+		{
+			return m_single_hit;
+		}
+
+		static constexpr uint16_t kUnknownItem = std::numeric_limits<uint16_t>::max();
+
+		std::string m_item_name;
+		uint16_t m_item_ix = kUnknownItem;
+		bool m_icase = false;
+		size_t m_param_ix;
+		std::string m_value;
+		const category *m_category = nullptr;
+		bool m_indexed = false;
+		std::optional<row_handle> m_single_hit;
+	};
+
 	struct key_compare_condition_impl : public condition_impl
 	{
 		template <typename COMP>
@@ -504,6 +751,134 @@ namespace detail
 		std::string m_str;
 	};
 
+	/// The comparison operators for key_numeric_compare_condition_impl
+	enum class compare_op
+	{
+		less,
+		less_equal,
+		greater,
+		greater_equal
+	};
+
+	template <typename T>
+	struct key_numeric_compare_condition_impl : public condition_impl
+	{
+		key_numeric_compare_condition_impl(const std::string &item_name, compare_op op, const T &value, const std::string &s)
+			: m_item_name(item_name)
+			, m_op(op)
+			, m_value(value)
+			, m_str(s)
+		{
+		}
+
+		condition_impl *prepare(const category &c) override
+		{
+			m_item_ix = get_item_ix(c, m_item_name);
+
+			// Values that do not parse as T compare larger and match for greater (or equal),
+			// but the index sorts e.g. 1.5 before 10 in an int item. Therefore only
+			// integer items can use the index for those with integer values, and
+			// only if all values fit, see category::find_in_index.
+			bool lower_bound = m_op == compare_op::greater or m_op == compare_op::greater_equal;
+
+			m_range.reset();
+			if (is_first_key_numeric(c, m_item_name, lower_bound) and
+				(not lower_bound or (std::is_integral_v<T> and std::is_signed_v<T> and sizeof(T) >= sizeof(int32_t))) and
+				std::isfinite(static_cast<double>(m_value)))
+			{
+				key_range r;
+
+				// Bounds are always inclusive, the index compares as double and floats
+				// rounded to m_value may be slightly off. The rows are tested anyway.
+				double v = static_cast<double>(m_value);
+				if constexpr (std::is_floating_point_v<T>)
+					v = static_cast<double>(std::nextafter(m_value, lower_bound ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity()));
+
+				if (lower_bound)
+				{
+					r.m_lower = v;
+					r.m_with_empty = true;
+				}
+				else
+					r.m_upper = v;
+
+				// values starting with a plus sign do not parse as numbers in the index
+				r.m_with_invalid = true;
+
+				m_range = r;
+			}
+
+			return this;
+		}
+
+		bool test(row_handle r) const override
+		{
+			return match(r[m_item_ix].text());
+		}
+
+		std::optional<key_range> range() const override
+		{
+			return m_range;
+		}
+
+		void filter(const category &, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (selection[i] and not match(value_text(rows[i]->get(m_item_ix))))
+					selection[i] = false;
+			}
+		}
+
+		void str(std::ostream &os) const override
+		{
+			os << m_item_name << m_str;
+		}
+
+		// Same result as item_handle::compare, empty and invalid values compare larger
+		int compare(std::string_view txt) const
+		{
+			if (txt.empty() or (txt.length() == 1 and (txt.front() == '.' or txt.front() == '?')))
+				return 1;
+
+			auto b = txt.data();
+			auto e = txt.data() + txt.size();
+
+			if (b + 1 < e and *b == '+' and std::isdigit(b[1]))
+				++b;
+
+			T v = {};
+			auto r = selected_charconv<T>::from_chars(b, e, v);
+
+			if ((bool)r.ec or r.ptr != e)
+				return 1;
+
+			return v < m_value ? -1 : (v > m_value ? 1 : 0);
+		}
+
+		bool match(std::string_view txt) const
+		{
+			int d = compare(txt);
+
+			switch (m_op)
+			{
+				case compare_op::less: return d < 0;
+				case compare_op::less_equal: return d <= 0;
+				case compare_op::greater: return d > 0;
+				case compare_op::greater_equal: return d >= 0;
+			}
+
+			return false;
+		}
+
+		std::string m_item_name;
+		uint16_t m_item_ix = 0;
+		compare_op m_op;
+		T m_value;
+		std::string m_str;
+		std::optional<key_range> m_range;
+	};
+
 	struct key_matches_condition_impl : public condition_impl
 	{
 		key_matches_condition_impl(const std::string &item_name, const std::regex &rx)
@@ -658,6 +1033,12 @@ namespace detail
 			return this;
 		}
 
+		void bind(std::span<const std::string_view> values) override
+		{
+			for (auto sub : m_sub)
+				sub->bind(values);
+		}
+
 		bool test(row_handle r) const override
 		{
 			bool result = true;
@@ -674,6 +1055,16 @@ namespace detail
 			return result;
 		}
 
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			for (auto sub : m_sub)
+			{
+				if (selection.none())
+					break;
+				sub->filter(cat, rows, selection);
+			}
+		}
+
 		void str(std::ostream &os) const override
 		{
 			os << '(';
@@ -716,6 +1107,26 @@ namespace detail
 			return result;
 		}
 
+		std::optional<key_range> range() const override
+		{
+			std::optional<key_range> result;
+
+			for (auto sub : m_sub)
+			{
+				auto r = sub->range();
+
+				if (not r.has_value())
+					continue;
+
+				if (result.has_value())
+					result = *result & *r;
+				else
+					result = r;
+			}
+
+			return result;
+		}
+
 		static condition_impl *combine_equal(std::vector<and_condition_impl *> &subs, or_condition_impl *oc);
 
 		std::vector<condition_impl *> m_sub;
@@ -754,6 +1165,12 @@ namespace detail
 
 		condition_impl *prepare(const category &c) override;
 
+		void bind(std::span<const std::string_view> values) override
+		{
+			for (auto sub : m_sub)
+				sub->bind(values);
+		}
+
 		bool test(row_handle r) const override
 		{
 			bool result = false;
@@ -769,6 +1186,27 @@ namespace detail
 			return result;
 		}
 
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			// rows still to be decided
+			block_selection todo = selection;
+			block_selection result;
+
+			for (auto sub : m_sub)
+			{
+				if (todo.none())
+					break;
+
+				block_selection s = todo;
+				sub->filter(cat, rows, s);
+
+				result |= s;
+				todo &= ~s;
+			}
+
+			selection = result;
+		}
+
 		void str(std::ostream &os) const override
 		{
 			bool first = true;
@@ -831,11 +1269,23 @@ namespace detail
 			return this;
 		}
 
+		void bind(std::span<const std::string_view> values) override
+		{
+			mA->bind(values);
+		}
+
 		bool test(row_handle r) const override
 		{
 			return not mA->test(r);
 		}
 
+		void filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const override
+		{
+			block_selection s = selection;
+			mA->filter(cat, rows, s);
+			selection &= ~s;
+		}
+
 		void str(std::ostream &os) const override
 		{
 			os << "NOT (";
@@ -979,6 +1429,36 @@ inline condition operator==(const key &key, std::string_view value)
 		return condition(new detail::key_is_empty_condition_impl(key.m_item_name));
 }
 
+/**
+ * @brief A placeholder for a value in a condition. The actual value
+ * is assigned later on using condition::bind
+ *
+ * @code{.cpp}
+ * auto c = "id"_key == cif::parameter(0);
+ * @endcode
+ */
+struct parameter
+{
+	/**
+	 * @brief Construct a new parameter object for the value at index @a ix
+	 * in the list of values passed to condition::bind
+	 */
+	explicit constexpr parameter(size_t ix)
+		: m_ix(ix)
+	{
+	}
+
+	size_t m_ix; ///< The index of the value
+};
+
+/**
+ * @brief Operator to create an equals condition based on a key @a key and a parameter @a p
+ */
+inline condition operator==(const key &key, const parameter &p)
+{
+	return condition(new detail::key_equals_parameter_condition_impl(key.m_item_name, p.m_ix));
+}
+
 /**
  * @brief Operator to create a not equals condition based on a key @a key and a value @a v
  */
@@ -1005,10 +1485,13 @@ condition operator>(const key &key, const T &v)
 	std::ostringstream s;
 	s << " > " << v;
 
-	return condition(new detail::key_compare_condition_impl(
-		key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
-		{ return r[item_name].template compare<T>(v, icase) > 0; },
-		s.str()));
+	if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+		return condition(new detail::key_numeric_compare_condition_impl<T>(key.m_item_name, detail::compare_op::greater, v, s.str()));
+	else
+		return condition(new detail::key_compare_condition_impl(
+			key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
+			{ return r[item_name].template compare<T>(v, icase) > 0; },
+			s.str()));
 }
 
 /**
@@ -1020,10 +1503,13 @@ condition operator>=(const key &key, const T &v)
 	std::ostringstream s;
 	s << " >= " << v;
 
-	return condition(new detail::key_compare_condition_impl(
-		key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
-		{ return r[item_name].template compare<T>(v, icase) >= 0; },
-		s.str()));
+	if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+		return condition(new detail::key_numeric_compare_condition_impl<T>(key.m_item_name, detail::compare_op::greater_equal, v, s.str()));
+	else
+		return condition(new detail::key_compare_condition_impl(
+			key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
+			{ return r[item_name].template compare<T>(v, icase) >= 0; },
+			s.str()));
 }
 
 /**
@@ -1035,10 +1521,13 @@ condition operator<(const key &key, const T &v)
 	std::ostringstream s;
 	s << " < " << v;
 
-	return condition(new detail::key_compare_condition_impl(
-		key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
-		{ return r[item_name].template compare<T>(v, icase) < 0; },
-		s.str()));
+	if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+		return condition(new detail::key_numeric_compare_condition_impl<T>(key.m_item_name, detail::compare_op::less, v, s.str()));
+	else
+		return condition(new detail::key_compare_condition_impl(
+			key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
+			{ return r[item_name].template compare<T>(v, icase) < 0; },
+			s.str()));
 }
 
 /**
@@ -1050,10 +1539,13 @@ condition operator<=(const key &key, const T &v)
 	std::ostringstream s;
 	s << " <= " << v;
 
-	return condition(new detail::key_compare_condition_impl(
-		key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
-		{ return r[item_name].template compare<T>(v, icase) <= 0; },
-		s.str()));
+	if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+		return condition(new detail::key_numeric_compare_condition_impl<T>(key.m_item_name, detail::compare_op::less_equal, v, s.str()));
+	else
+		return condition(new detail::key_compare_condition_impl(
+			key.m_item_name, [item_name = key.m_item_name, v](row_handle r, bool icase)
+			{ return r[item_name].template compare<T>(v, icase) <= 0; },
+			s.str()));
 }
 
 /**
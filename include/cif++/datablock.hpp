@@ -138,6 +138,32 @@ class datablock : public std::list<category>
 	 */
 	bool validate_links() const;
 
+	/**
+	 * @brief Like is_valid, but only checks the rows that were added or
+	 * modified since the last validation without errors, see
+	 * category::is_valid_incremental. The audit_conform category is not updated.
+	 *
+	 * @return true If the content is valid
+	 * @return false If the content is not valid
+	 */
+	bool is_valid_incremental() const;
+
+	/**
+	 * @brief Like validate_links, but only checks the links that may have
+	 * changed since the last successful validation, see
+	 * category::validate_links_incremental
+	 *
+	 * @return true If all links are valid
+	 * @return false If all links are not valid
+	 */
+	bool validate_links_incremental() const;
+
+	/**
+	 * @brief Return the total number of rows in all categories
+	 * of this datablock. Does not require a scan of the rows.
+	 */
+	size_t row_count() const;
+
 	// --------------------------------------------------------------------
 
 	/**
@@ -230,6 +256,10 @@ class datablock : public std::list<category>
 	bool operator==(const datablock &rhs) const;
 
   private:
+	/// Write the categories @a cats in this order, small categories are
+	/// formatted concurrently when more than one write thread was requested
+	void write(std::ostream &os, const std::vector<const category *> &cats) const;
+
 	std::string m_name;
 	const validator *m_validator = nullptr;
 };
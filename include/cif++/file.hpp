@@ -29,6 +29,7 @@
 #include <list>
 
 #include "cif++/datablock.hpp"
+#include "cif++/gzio.hpp"
 #include "cif++/parser.hpp"
 
 /** \file file.hpp
@@ -229,15 +230,94 @@ class file : public std::list<datablock>
 	/** Load the data from the file specified by @a p */
 	void load(const std::filesystem::path &p);
 
-	/** Load the data from @a is */
+	/** Load the data from @a is, which may contain text or BinaryCIF data */
 	void load(std::istream &is);
 
+	/// @brief How values are validated while loading, see load
+	enum class load_validation
+	{
+		none,     ///< Values are not validated
+		report,   ///< Invalid values are reported
+		fail_fast ///< Loading stops with a validation_exception at the first invalid value
+	};
+
+	/**
+	 * @brief Load the data from the file specified by @a p, validating
+	 * the values while parsing, see load(std::istream &, load_validation)
+	 */
+	bool load(const std::filesystem::path &p, load_validation validation);
+
+	/**
+	 * @brief Load the data from @a is, validating the values while parsing
+	 *
+	 * Each value is checked against the type and enumeration of its item
+	 * validator as soon as it is read, using the validator assigned to this
+	 * file. This saves a separate pass over all data. Key uniqueness is
+	 * checked when the indices are built after parsing, a duplicate key
+	 * results in a duplicate_key_error.
+	 *
+	 * @param is The istream containing the data to load
+	 * @param validation The kind of validation
+	 * @return true if no invalid values were found
+	 */
+	bool load(std::istream &is, load_validation validation);
+
+	/**
+	 * @brief Keep the text of the data loaded by the next calls to load
+	 *
+	 * Each category then refers to the text it was parsed from. Categories
+	 * that are not modified afterwards are written exactly as they were
+	 * read, including layout and comments, instead of being formatted
+	 * again. This costs memory for the text, which is kept as long as
+	 * categories refer to it. Data read from BinaryCIF or snapshots is
+	 * always formatted.
+	 */
+	void set_keep_source_text(bool keep)
+	{
+		m_keep_source_text = keep;
+	}
+
 	/** Save the data to the file specified by @a p */
 	void save(const std::filesystem::path &p) const;
 
+	/**
+	 * @brief Save the data to the file specified by @a p, compressing
+	 * the data using @a options when the extension of @a p is .gz, .zst
+	 * or .lz4 or when options.format specifies a format. The data is
+	 * written in BinaryCIF format when the remaining extension is .bcif
+	 */
+	void save(const std::filesystem::path &p, const gzio::compression_options &options) const;
+
 	/** Save the data to @a is */
 	void save(std::ostream &os) const;
 
+	/**
+	 * @brief Save a snapshot of the data to the file specified by @a p
+	 *
+	 * A snapshot is a libcifpp specific binary format meant for caching.
+	 * The values are stored unquoted per item, so opening a snapshot does
+	 * not require parsing text. The header contains a format version and a
+	 * checksum. The file is written to a temporary file first, which is
+	 * then renamed to @a p.
+	 */
+	void save_snapshot(const std::filesystem::path &p) const;
+
+	/**
+	 * @brief Replace the data with the snapshot in @a p, written by save_snapshot
+	 *
+	 * The file is memory mapped, when supported. If @a p does not exist or
+	 * cannot be read, is not a snapshot, was written using another version
+	 * of the format or the checksum does not match, false is returned and
+	 * the data in this file is left untouched. In that case you should load
+	 * the original data instead.
+	 *
+	 * As with load, the validator is kept or a dictionary is loaded
+	 * based on the contents.
+	 *
+	 * @return true if the snapshot was loaded
+	 */
+	bool open_snapshot(const std::filesystem::path &p);
+
 	/**
 	 * @brief Friend operator<< to write file @a f to std::ostream @a os
 	 */
@@ -248,7 +328,11 @@ class file : public std::list<datablock>
 	}
 
   private:
+	/// Reset the validator to @a v after loading failed
+	void restore_validator(const validator *v) noexcept;
+
 	const validator *m_validator = nullptr;
+	bool m_keep_source_text = false;
 };
 
 } // namespace cif
\ No newline at end of file
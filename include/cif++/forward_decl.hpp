@@ -50,4 +50,7 @@ class row_handle;
 class item;
 struct item_handle;
 
+class validator;
+struct category_validator;
+
 } // namespace cif
\ No newline at end of file
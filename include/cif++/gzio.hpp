@@ -5,14 +5,31 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <zlib.h>
 
+#if CIFPP_HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+#if CIFPP_HAVE_LZ4
+# include <lz4frame.h>
+#endif
+
 /** \file gzio.hpp
  * 
  * Single header file for the implementation of stream classes
@@ -26,6 +43,11 @@
  * whether to use a compressions/decompression algorithm is
  * based on the extension of the \a filename argument.
  *
+ * Besides gzip, Zstandard (.zst) and LZ4 (.lz4) compressed data is
+ * supported when libcifpp was built with CIFPP_WITH_ZSTD and
+ * CIFPP_WITH_LZ4 respectively. When reading, the format is recognized
+ * by the magic bytes at the start of the data.
+ *
  * This is a stripped down version of the gxrio library from
  * https://github.com/mhekkel/gxrio.git
  * Most notably, the lzma support has been removed since getting
@@ -38,6 +60,70 @@ namespace cif::gzio
 /** The default buffer size to use */
 const size_t kDefaultBufferSize = 256;
 
+/** The amount of uncompressed data in a block compressed by the parallel gzip writer */
+const size_t kParallelBlockSize = 128 * 1024;
+
+/** The maximum amount of uncompressed data in a BGZF block */
+const size_t kBGZFBlockSize = 0xff00;
+
+/// \brief The compression formats known to gzio
+enum class compression_format
+{
+	automatic, ///< Derived from the extension of the file name when writing, .gz, .zst or .lz4
+	none,      ///< No compression
+	gzip,      ///< gzip, using zlib
+	zstd,      ///< Zstandard, only available when built with CIFPP_WITH_ZSTD
+	lz4        ///< LZ4 frames, only available when built with CIFPP_WITH_LZ4
+};
+
+/// \brief Options used when writing compressed files
+struct compression_options
+{
+	int level = Z_BEST_COMPRESSION;                            ///< The compression level, the range depends on the format, for gzip from 0 (none) to 9 (best)
+	size_t threads = 1;                                        ///< The number of threads compressing data, 0 means one per hardware thread
+	bool bgzf = false;                                         ///< Write blocked gzip (BGZF), allowing random access when reading
+	compression_format format = compression_format::automatic; ///< The format to write
+	bool long_distance_matching = false;                       ///< Let zstd find matches far back in the data, at the cost of memory
+};
+
+/** @cond */
+namespace detail
+{
+	inline void store_uint16(unsigned char *p, uint16_t v)
+	{
+		p[0] = static_cast<unsigned char>(v & 0xff);
+		p[1] = static_cast<unsigned char>(v >> 8);
+	}
+
+	inline void store_uint32(unsigned char *p, uint32_t v)
+	{
+		for (int i = 0; i < 4; ++i, v >>= 8)
+			p[i] = static_cast<unsigned char>(v & 0xff);
+	}
+
+	inline uint16_t load_uint16(const unsigned char *p)
+	{
+		return static_cast<uint16_t>(p[0] | (p[1] << 8));
+	}
+
+	inline uint32_t load_uint32(const unsigned char *p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	/// The header of a BGZF block, the last two bytes contain the block size minus one
+	const unsigned char kBGZFHeader[18] = {
+		0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0, 0
+	};
+
+	/// The empty block marking the end of a BGZF file
+	const unsigned char kBGZFEOFMarker[28] = {
+		0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0, 0x1b, 0,
+		3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	};
+} // namespace detail
+/** @endcond */
+
 // --------------------------------------------------------------------
 
 /// \brief A base class for the streambuf classes in gzio
@@ -180,25 +266,1449 @@ class basic_igzip_streambuf : public basic_streambuf<CharT, Traits>
 			m_zstream->next_in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
 		}
 
-		return *this;
+		return *this;
+	}
+
+	~basic_igzip_streambuf()
+	{
+		close();
+	}
+
+	/** @endcond */
+
+	/// \brief This closes the zlib stream and sets the get pointers to null.
+	base_type *close() override
+	{
+		if (m_zstream)
+		{
+			::inflateEnd(m_zstream.get());
+
+			m_zstream.reset(nullptr);
+			m_gzheader.reset(nullptr);
+		}
+
+		this->setg(nullptr, nullptr, nullptr);
+
+		return this;
+	}
+
+	/// \brief Initialize a zlib stream and set the upstream.
+	///
+	/// \param upstream The upstream streambuf
+	///
+	/// The zstream is constructed and an optional header is
+	/// read from upstream. The contents of the header are ignored
+	/// but we must maintain that structure.
+	base_type *init(streambuf_type *upstream) override
+	{
+		this->set_upstream(upstream);
+
+		close();
+
+		m_zstream.reset(new z_stream_s);
+		m_gzheader.reset(new gz_header_s);
+
+		auto &zstream = *m_zstream.get();
+		zstream = z_stream_s{};
+		auto &header = *m_gzheader.get();
+		header = gz_header_s{};
+
+		int err = ::inflateInit2(&zstream, 47);
+		if (err == Z_OK)
+		{
+			zstream.next_in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
+			zstream.avail_in = static_cast<uInt>(this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size()));
+
+			err = ::inflateGetHeader(&zstream, &header);
+
+			if (err != Z_OK)
+				::inflateEnd(&zstream);
+		}
+
+		if (err != Z_OK)
+			zstream = z_stream_s{};
+
+		return err == Z_OK ? this : nullptr;
+	}
+
+  private:
+	/// \brief The actual work is done here.
+	int_type underflow() override
+	{
+		if (m_zstream and this->m_upstream)
+		{
+			auto &zstream = *m_zstream.get();
+			const std::streamsize kBufferByteSize = m_out_buffer.size();
+
+			while (this->gptr() == this->egptr())
+			{
+				zstream.next_out = reinterpret_cast<unsigned char *>(m_out_buffer.data());
+				zstream.avail_out = static_cast<uInt>(kBufferByteSize);
+
+				if (zstream.avail_in == 0)
+				{
+					zstream.next_in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
+					zstream.avail_in = static_cast<uInt>(this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size()));
+				}
+
+				if (zstream.avail_in == 0)
+					break;
+
+				int err = ::inflate(&zstream, Z_SYNC_FLUSH);
+				std::streamsize n = kBufferByteSize - zstream.avail_out;
+
+				if (n > 0)
+				{
+					this->setg(
+						m_out_buffer.data(),
+						m_out_buffer.data(),
+						m_out_buffer.data() + n);
+					break;
+				}
+
+				if (err == Z_STREAM_END and zstream.avail_in > 0)
+					err = ::inflateReset2(&zstream, 47);
+
+				if (err < Z_OK)
+					break;
+			}
+		}
+
+		return this->gptr() != this->egptr() ? traits_type::to_int_type(*this->gptr()) : traits_type::eof();
+	}
+
+  private:
+	/// \brief The zlib internal structures are mainained as pointers to avoid having
+	/// to copy their content in move constructors.
+	std::unique_ptr<z_stream_s> m_zstream;
+
+	/// \brief The zlib internal structures are mainained as pointers to avoid having
+	/// to copy their content in move constructors.
+	std::unique_ptr<gz_header> m_gzheader;
+
+	/// \brief Input buffer, this is the input for zlib
+	std::array<char_type, BufferSize> m_in_buffer;
+
+	/// \brief Output buffer, where the ostream finds the data
+	std::array<char_type, BufferSize> m_out_buffer;
+};
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that reads blocked gzip (BGZF) data
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+///
+/// BGZF files consist of gzip members containing at most 64 KB of data
+/// each, with the size of the member stored in the header. Positions in
+/// this stream are virtual offsets: the offset of a block in the compressed
+/// data shifted left by 16 bits, combined with the offset in the uncompressed
+/// data of that block. The positions returned by tellg can be passed to
+/// seekg, only the block containing that position is decompressed.
+///
+/// The upstream streambuf must be seekable.
+
+template <typename CharT, typename Traits>
+class basic_ibgzf_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+	using pos_type = typename traits_type::pos_type;
+	using off_type = typename traits_type::off_type;
+
+	basic_ibgzf_streambuf() = default;
+
+	basic_ibgzf_streambuf(const basic_ibgzf_streambuf &) = delete;
+	basic_ibgzf_streambuf &operator=(const basic_ibgzf_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Move constructor
+	basic_ibgzf_streambuf(basic_ibgzf_streambuf &&rhs)
+		: base_type(std::move(rhs))
+	{
+		auto g = rhs.gptr() - rhs.eback();
+
+		std::swap(m_zstream, rhs.m_zstream);
+		m_in_buffer = std::move(rhs.m_in_buffer);
+		m_out_buffer = std::move(rhs.m_out_buffer);
+		m_block_offset = rhs.m_block_offset;
+		m_next_block_offset = rhs.m_next_block_offset;
+
+		this->setg(m_out_buffer.data(), m_out_buffer.data() + g, m_out_buffer.data() + (rhs.egptr() - rhs.eback()));
+		rhs.setg(nullptr, nullptr, nullptr);
+	}
+
+	/// \brief Move operator=
+	basic_ibgzf_streambuf &operator=(basic_ibgzf_streambuf &&rhs)
+	{
+		if (this != &rhs)
+		{
+			close();
+
+			base_type::operator=(std::move(rhs));
+
+			auto g = rhs.gptr() - rhs.eback();
+			auto e = rhs.egptr() - rhs.eback();
+
+			std::swap(m_zstream, rhs.m_zstream);
+			m_in_buffer = std::move(rhs.m_in_buffer);
+			m_out_buffer = std::move(rhs.m_out_buffer);
+			m_block_offset = rhs.m_block_offset;
+			m_next_block_offset = rhs.m_next_block_offset;
+
+			this->setg(m_out_buffer.data(), m_out_buffer.data() + g, m_out_buffer.data() + e);
+			rhs.setg(nullptr, nullptr, nullptr);
+		}
+
+		return *this;
+	}
+
+	~basic_ibgzf_streambuf()
+	{
+		close();
+	}
+
+	/// \brief This closes the zlib stream and sets the get pointers to null.
+	base_type *close() override
+	{
+		if (m_zstream)
+		{
+			::inflateEnd(m_zstream.get());
+			m_zstream.reset(nullptr);
+		}
+
+		this->setg(nullptr, nullptr, nullptr);
+
+		return this;
+	}
+
+	/// \brief Initialize a zlib stream and set the upstream, reading starts
+	/// at the current position of @a upstream
+	base_type *init(streambuf_type *upstream) override
+	{
+		close();
+
+		this->set_upstream(upstream);
+
+		m_zstream.reset(new z_stream_s);
+		*m_zstream = z_stream_s{};
+
+		if (::inflateInit2(m_zstream.get(), -15) != Z_OK)
+		{
+			m_zstream.reset(nullptr);
+			return nullptr;
+		}
+
+		auto pos = this->m_upstream->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+		if (pos == pos_type(off_type(-1)))
+		{
+			close();
+			return nullptr;
+		}
+
+		m_in_buffer.resize(65536);
+		m_out_buffer.resize(65536);
+
+		m_block_offset = m_next_block_offset = static_cast<uint64_t>(off_type(pos));
+		this->setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data());
+
+		return this;
+	}
+
+	/// \brief Return the virtual offset for the current position
+	uint64_t tell() const
+	{
+		return (m_block_offset << 16) | static_cast<uint64_t>(this->gptr() - this->eback());
+	}
+
+	/// \brief Move to virtual offset @a voffset, returns false if this failed
+	bool seek(uint64_t voffset)
+	{
+		auto block_offset = voffset >> 16;
+		auto offset = static_cast<size_t>(voffset & 0xffff);
+
+		if (block_offset != m_block_offset or this->eback() == nullptr)
+		{
+			if (this->m_upstream->pubseekpos(static_cast<off_type>(block_offset), std::ios_base::in) == pos_type(off_type(-1)))
+				return false;
+
+			m_next_block_offset = block_offset;
+			if (not read_block() and offset > 0)
+				return false;
+		}
+
+		if (offset > static_cast<size_t>(this->egptr() - this->eback()))
+			return false;
+
+		this->setg(this->eback(), this->eback() + offset, this->egptr());
+
+		return true;
+	}
+
+  private:
+	/// \brief Read the block at m_next_block_offset, the upstream must be positioned there.
+	/// Returns false at the end of the data or when an error occurred.
+	bool read_block()
+	{
+		if (not m_zstream)
+			return false;
+
+		m_block_offset = m_next_block_offset;
+		this->setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data());
+
+		auto in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
+
+		// The fixed part of the header, followed by the extra field
+		if (this->m_upstream->sgetn(m_in_buffer.data(), 12) != 12)
+			return false;
+
+		if (in[0] != 0x1f or in[1] != 0x8b or in[2] != 8 or (in[3] & 4) == 0)
+			return false;
+
+		// The header comes from the data, reject blocks that do not fit the buffer
+		size_t xlen = detail::load_uint16(in + 10);
+		if (12 + xlen > m_in_buffer.size())
+			return false;
+
+		if (this->m_upstream->sgetn(m_in_buffer.data() + 12, xlen) != static_cast<std::streamsize>(xlen))
+			return false;
+
+		size_t bsize = 0;
+		for (size_t i = 12; i + 4 <= 12 + xlen;)
+		{
+			size_t slen = detail::load_uint16(in + i + 2);
+			if (i + 4 + slen > 12 + xlen)
+				return false;
+
+			if (in[i] == 'B' and in[i + 1] == 'C' and slen == 2)
+			{
+				bsize = detail::load_uint16(in + i + 4) + size_t{ 1 };
+				break;
+			}
+
+			i += 4 + slen;
+		}
+
+		if (bsize < 12 + xlen + 8 or bsize > m_in_buffer.size())
+			return false;
+
+		auto rest = bsize - 12 - xlen;
+		if (this->m_upstream->sgetn(m_in_buffer.data(), rest) != static_cast<std::streamsize>(rest))
+			return false;
+
+		m_next_block_offset = m_block_offset + bsize;
+
+		auto &zstream = *m_zstream;
+		::inflateReset(&zstream);
+
+		zstream.next_in = in;
+		zstream.avail_in = static_cast<uInt>(rest - 8);
+		zstream.next_out = reinterpret_cast<unsigned char *>(m_out_buffer.data());
+		zstream.avail_out = static_cast<uInt>(m_out_buffer.size());
+
+		if (::inflate(&zstream, Z_FINISH) != Z_STREAM_END)
+			return false;
+
+		auto n = m_out_buffer.size() - zstream.avail_out;
+
+		if (detail::load_uint32(in + rest - 4) != n or
+			detail::load_uint32(in + rest - 8) != ::crc32(::crc32(0, nullptr, 0), reinterpret_cast<const Bytef *>(m_out_buffer.data()), static_cast<uInt>(n)))
+		{
+			return false;
+		}
+
+		this->setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data() + n);
+
+		return true;
+	}
+
+	/// \brief Read the next block, skipping empty ones
+	int_type underflow() override
+	{
+		while (this->gptr() == this->egptr())
+		{
+			if (not read_block())
+				break;
+		}
+
+		return this->gptr() != this->egptr() ? traits_type::to_int_type(*this->gptr()) : traits_type::eof();
+	}
+
+	/// \brief Only the current position can be requested, as virtual offset
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+	{
+		if (off != 0 or dir != std::ios_base::cur or (which & std::ios_base::in) == 0 or not m_zstream)
+			return pos_type(off_type(-1));
+
+		return pos_type(static_cast<off_type>(tell()));
+	}
+
+	/// \brief Seek to the virtual offset @a pos
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+	{
+		if ((which & std::ios_base::in) == 0 or not m_zstream or not seek(static_cast<uint64_t>(off_type(pos))))
+			return pos_type(off_type(-1));
+
+		return pos;
+	}
+
+  private:
+	/// \brief The zlib internal structures are mainained as pointers to avoid having
+	/// to copy their content in move constructors.
+	std::unique_ptr<z_stream_s> m_zstream;
+
+	/// \brief The compressed data of the current block
+	std::vector<char_type> m_in_buffer;
+
+	/// \brief The uncompressed data of the current block
+	std::vector<char_type> m_out_buffer;
+
+	/// \brief The offset of the current and the next block in the compressed data
+	uint64_t m_block_offset = 0, m_next_block_offset = 0;
+};
+
+/// \brief Return true if the data in @a sb starts with a BGZF block header,
+/// the position of @a sb is not changed. The streambuf must be seekable.
+template <typename CharT, typename Traits>
+bool is_bgzf(std::basic_streambuf<CharT, Traits> *sb)
+{
+	using pos_type = typename Traits::pos_type;
+	using off_type = typename Traits::off_type;
+
+	auto pos = sb->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+	if (pos == pos_type(off_type(-1)))
+		return false;
+
+	CharT header[16];
+	auto n = sb->sgetn(header, 16);
+	sb->pubseekpos(pos, std::ios_base::in);
+
+	auto h = reinterpret_cast<const unsigned char *>(header);
+	return n == 16 and h[0] == 0x1f and h[1] == 0x8b and h[2] == 8 and (h[3] & 4) != 0 and
+	       h[12] == 'B' and h[13] == 'C' and h[14] == 2 and h[15] == 0;
+}
+
+/// \brief Return the compression format of the data in @a sb, recognized
+/// by the magic bytes at the start. The position of @a sb is not changed.
+/// If @a sb is not seekable, only the bytes already in its get area are
+/// inspected. When that is a single byte, 0x1f is taken as the start of gzip.
+template <typename CharT, typename Traits>
+compression_format sniff_format(std::basic_streambuf<CharT, Traits> *sb)
+{
+	using pos_type = typename Traits::pos_type;
+	using off_type = typename Traits::off_type;
+
+	unsigned char magic[4] = {};
+	size_t n = 0;
+
+	auto pos = sb->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+	if (pos != pos_type(off_type(-1)))
+	{
+		n = sb->sgetn(reinterpret_cast<CharT *>(magic), 4);
+		sb->pubseekpos(pos, std::ios_base::in);
+	}
+	else if (auto ch = sb->sgetc(); not Traits::eq_int_type(ch, Traits::eof()))
+	{
+		// Reading past the get area would discard the characters before
+		// it, so they could not be put back
+		if (auto avail = sb->in_avail(); avail >= 2)
+		{
+			n = static_cast<size_t>(std::min<std::streamsize>(avail, 4));
+
+			for (size_t i = 0; i < n; ++i)
+				magic[i] = static_cast<unsigned char>(sb->sbumpc());
+			for (size_t i = 0; i < n; ++i)
+				sb->sungetc();
+		}
+		else
+			magic[n++] = static_cast<unsigned char>(ch);
+	}
+
+	auto starts_with = [&](std::initializer_list<unsigned char> m)
+	{
+		return n >= m.size() and std::equal(m.begin(), m.end(), magic);
+	};
+
+	// 0x1f cannot start a CIF file
+	if (starts_with({ 0x1f, 0x8b }) or (n == 1 and magic[0] == 0x1f))
+		return compression_format::gzip;
+	if (starts_with({ 0x28, 0xb5, 0x2f, 0xfd }))
+		return compression_format::zstd;
+	if (starts_with({ 0x04, 0x22, 0x4d, 0x18 }))
+		return compression_format::lz4;
+
+	return compression_format::none;
+}
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that can be used to compress data using zlib
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+/// \tparam BufferSize	The size of the internal buffers.
+///
+/// This implementation of streambuf can compress (deflate) data using zlib.
+
+template <typename CharT, typename Traits, size_t BufferSize = kDefaultBufferSize>
+class basic_ogzip_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+	using pos_type = typename traits_type::pos_type;
+	using off_type = typename traits_type::off_type;
+
+	basic_ogzip_streambuf() = default;
+
+	basic_ogzip_streambuf(const basic_ogzip_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Constructor taking the compression level @a level
+	explicit basic_ogzip_streambuf(int level)
+		: m_level(level)
+	{
+	}
+
+	/// \brief Move constructor
+	basic_ogzip_streambuf(basic_ogzip_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_level(rhs.m_level)
+	{
+		std::swap(m_zstream, rhs.m_zstream);
+		std::swap(m_gzheader, rhs.m_gzheader);
+
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+		this->sputn(rhs.pbase(), rhs.pptr() - rhs.pbase());
+		rhs.setp(nullptr, nullptr);
+	}
+
+	/** @cond */
+
+	basic_ogzip_streambuf &operator=(const basic_ogzip_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Move operator=
+	basic_ogzip_streambuf &operator=(basic_ogzip_streambuf &&rhs)
+	{
+		base_type::operator=(std::move(rhs));
+
+		m_level = rhs.m_level;
+
+		std::swap(m_zstream, rhs.m_zstream);
+		std::swap(m_gzheader, rhs.m_gzheader);
+
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+		this->sputn(rhs.pbase(), rhs.pptr() - rhs.pbase());
+		rhs.setp(nullptr, nullptr);
+
+		return *this;
+	}
+
+	~basic_ogzip_streambuf()
+	{
+		close();
+	}
+
+	/// \brief This closes the zlib stream and sets the put pointers to null.
+	base_type *close() override
+	{
+		if (m_zstream)
+		{
+			overflow(traits_type::eof());
+
+			::deflateEnd(m_zstream.get());
+
+			m_zstream.reset(nullptr);
+			m_gzheader.reset(nullptr);
+		}
+
+		this->setp(nullptr, nullptr);
+
+		return this;
+	}
+
+	/// \brief Initialize the internal zlib structures
+	///
+	/// \param upstream The upstream streambuf
+	///
+	/// The zlib stream is initialized as one that can accept
+	/// a gzip header.
+	base_type *init(streambuf_type *upstream) override
+	{
+		this->set_upstream(upstream);
+
+		close();
+
+		m_zstream.reset(new z_stream_s);
+		m_gzheader.reset(new gz_header_s);
+
+		auto &zstream = *m_zstream.get();
+		zstream = z_stream_s{};
+		auto &header = *m_gzheader.get();
+		header = gz_header_s{};
+
+		const int WINDOW_BITS = 15, GZIP_ENCODING = 16;
+
+		int err = deflateInit2(&zstream, m_level, Z_DEFLATED,
+			WINDOW_BITS | GZIP_ENCODING, Z_DEFLATED, Z_DEFAULT_STRATEGY);
+
+		if (err == Z_OK)
+			err = ::deflateSetHeader(&zstream, &header);
+
+		if (err == Z_OK)
+			this->setp(this->m_in_buffer.data(), this->m_in_buffer.data() + this->m_in_buffer.size());
+		else
+			zstream = z_stream_s{};
+
+		return err == Z_OK ? this : nullptr;
+	}
+
+  private:
+	/// \brief The actual work is done here
+	///
+	/// \param ch The character that did not fit, in case it is eof we need to flush
+	///
+	int_type overflow(int_type ch) override
+	{
+		if (not m_zstream)
+			return traits_type::eof();
+
+		auto &zstream = *m_zstream;
+
+		zstream.next_in = reinterpret_cast<unsigned char *>(this->pbase());
+		zstream.avail_in = static_cast<uInt>(this->pptr() - this->pbase());
+
+		char_type buffer[BufferSize];
+
+		for (;;)
+		{
+			zstream.next_out = reinterpret_cast<unsigned char *>(buffer);
+			zstream.avail_out = sizeof(buffer);
+
+			int err = ::deflate(&zstream, ch == traits_type::eof() ? Z_FINISH : Z_NO_FLUSH);
+
+			std::streamsize n = sizeof(buffer) - zstream.avail_out;
+			if (n > 0)
+			{
+				auto r = this->m_upstream->sputn(reinterpret_cast<char_type *>(buffer), n);
+
+				if (r != n)
+					return traits_type::eof();
+			}
+
+			if (zstream.avail_out == 0)
+				continue;
+
+			if (err == Z_OK and ch == traits_type::eof())
+				continue;
+
+			break;
+		}
+
+		this->setp(this->m_in_buffer.data(), this->m_in_buffer.data() + this->m_in_buffer.size());
+
+		if (not traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*this->pptr() = traits_type::to_char_type(ch);
+			this->pbump(1);
+		}
+
+		return ch;
+	}
+
+  private:
+	/// \brief The zlib internal structures are mainained as pointers to avoid having
+	/// to copy their content in move constructors.
+	std::unique_ptr<z_stream_s> m_zstream;
+
+	/// \brief The zlib internal structures are mainained as pointers to avoid having
+	/// to copy their content in move constructors.
+	std::unique_ptr<gz_header> m_gzheader;
+
+	/// \brief Input buffer, this is the input for zlib
+	std::array<char_type, BufferSize> m_in_buffer;
+
+	/// \brief The compression level
+	int m_level = Z_BEST_COMPRESSION;
+};
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that compresses data using multiple threads
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+/// \tparam BlockSize	The amount of uncompressed data in each block.
+///
+/// The data is split into blocks that are deflated independently, the same
+/// way pigz does. Each block uses the last 32 KB of the previous block as
+/// dictionary and all but the last block end with a sync flush. The blocks
+/// are compressed by a fixed number of worker threads, these are started
+/// by init and stopped when the streambuf is destroyed. The compressed
+/// blocks are written in order as a single gzip member, the result can be
+/// read by any gzip decompressor.
+///
+/// In BGZF mode each block of at most kBGZFBlockSize bytes is written as a
+/// separate gzip member containing its compressed size, followed by an empty
+/// end-of-file block. This is still valid gzip, but it can also be read at
+/// random positions using basic_ibgzf_streambuf.
+
+template <typename CharT, typename Traits, size_t BlockSize = kParallelBlockSize>
+class basic_oparallel_gzip_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+	using pos_type = typename traits_type::pos_type;
+	using off_type = typename traits_type::off_type;
+
+	basic_oparallel_gzip_streambuf(const basic_oparallel_gzip_streambuf &) = delete;
+	basic_oparallel_gzip_streambuf &operator=(const basic_oparallel_gzip_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Constructor taking the compression level @a level, the number of
+	/// blocks @a threads that are compressed concurrently and whether to write BGZF
+	basic_oparallel_gzip_streambuf(int level, size_t threads, bool bgzf = false)
+		: m_level(level)
+		, m_threads(threads > 0 ? threads : 1)
+		, m_bgzf(bgzf)
+	{
+	}
+
+	/// \brief Move constructor
+	basic_oparallel_gzip_streambuf(basic_oparallel_gzip_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_level(rhs.m_level)
+		, m_threads(rhs.m_threads)
+		, m_bgzf(rhs.m_bgzf)
+		, m_active(std::exchange(rhs.m_active, false))
+		, m_buffer(std::move(rhs.m_buffer))
+		, m_dictionary(std::move(rhs.m_dictionary))
+		, m_pool(std::move(rhs.m_pool))
+		, m_pending(std::move(rhs.m_pending))
+		, m_crc(rhs.m_crc)
+		, m_size(rhs.m_size)
+	{
+		// the put area still points into m_buffer, its storage was moved
+		rhs.setp(nullptr, nullptr);
+	}
+
+	/// \brief Move operator=
+	basic_oparallel_gzip_streambuf &operator=(basic_oparallel_gzip_streambuf &&rhs)
+	{
+		if (this != &rhs)
+		{
+			close();
+
+			base_type::operator=(std::move(rhs));
+
+			auto b = rhs.pbase(), p = rhs.pptr(), e = rhs.epptr();
+
+			m_level = rhs.m_level;
+			m_threads = rhs.m_threads;
+			m_bgzf = rhs.m_bgzf;
+			m_active = std::exchange(rhs.m_active, false);
+			m_buffer = std::move(rhs.m_buffer);
+			m_dictionary = std::move(rhs.m_dictionary);
+			m_pool = std::move(rhs.m_pool);
+			m_pending = std::move(rhs.m_pending);
+			m_crc = rhs.m_crc;
+			m_size = rhs.m_size;
+
+			this->setp(b, e);
+			this->pbump(static_cast<int>(p - b));
+			rhs.setp(nullptr, nullptr);
+		}
+
+		return *this;
+	}
+
+	~basic_oparallel_gzip_streambuf()
+	{
+		close();
+	}
+
+	/// \brief Compress the last block, wait for all blocks to be written
+	/// and write the gzip trailer.
+	base_type *close() override
+	{
+		base_type *result = this;
+
+		if (m_active)
+		{
+			m_active = false;
+
+			submit(true);
+
+			while (not m_pending.empty())
+			{
+				if (not write_first())
+					result = nullptr;
+			}
+
+			if (m_bgzf)
+			{
+				if (result != nullptr and this->m_upstream->sputn(reinterpret_cast<const char_type *>(detail::kBGZFEOFMarker), 28) != 28)
+					result = nullptr;
+			}
+			else
+			{
+				unsigned char trailer[8];
+				detail::store_uint32(trailer, m_crc);
+				detail::store_uint32(trailer + 4, static_cast<uint32_t>(m_size));
+
+				if (result != nullptr and this->m_upstream->sputn(reinterpret_cast<char_type *>(trailer), 8) != 8)
+					result = nullptr;
+			}
+		}
+
+		this->setp(nullptr, nullptr);
+
+		return result;
+	}
+
+	/// \brief Write the gzip header to @a upstream and prepare for writing
+	base_type *init(streambuf_type *upstream) override
+	{
+		close();
+
+		this->set_upstream(upstream);
+
+		// gzip header: magic, deflate, no flags, no mtime, extra flags and OS unknown
+		// BGZF blocks each have their own header
+		const unsigned char header[10] = {
+			0x1f, 0x8b, 8, 0, 0, 0, 0, 0,
+			static_cast<unsigned char>(m_level >= Z_BEST_COMPRESSION ? 2 : m_level == Z_BEST_SPEED ? 4 : 0), 255
+		};
+
+		if (not m_bgzf and this->m_upstream->sputn(reinterpret_cast<const char_type *>(header), 10) != 10)
+			return nullptr;
+
+		if (not m_pool)
+			m_pool = std::make_unique<worker_pool>(m_threads);
+
+		m_buffer.resize(m_bgzf ? kBGZFBlockSize : BlockSize);
+		m_dictionary.clear();
+		m_crc = ::crc32(0, nullptr, 0);
+		m_size = 0;
+		m_active = true;
+
+		this->setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+
+		return this;
+	}
+
+  private:
+	/// \brief A compressed block and the crc32 of its uncompressed data
+	struct block
+	{
+		std::string m_data;
+		uLong m_crc;
+		size_t m_size;
+	};
+
+	/// \brief A fixed number of threads compressing blocks in the order
+	/// in which they were pushed
+	class worker_pool
+	{
+	  public:
+		worker_pool(size_t threads)
+		{
+			for (size_t i = 0; i < threads; ++i)
+				m_workers.emplace_back([this]()
+					{ run(); });
+		}
+
+		worker_pool(const worker_pool &) = delete;
+		worker_pool &operator=(const worker_pool &) = delete;
+
+		/// \brief The workers finish the tasks still queued before they stop
+		~worker_pool()
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_condition.notify_all();
+
+			for (auto &t : m_workers)
+				t.join();
+		}
+
+		std::future<block> push(std::packaged_task<block()> task)
+		{
+			auto result = task.get_future();
+
+			{
+				std::lock_guard lock(m_mutex);
+				m_queue.push_back(std::move(task));
+			}
+
+			m_condition.notify_one();
+
+			return result;
+		}
+
+	  private:
+		void run()
+		{
+			for (;;)
+			{
+				std::packaged_task<block()> task;
+
+				{
+					std::unique_lock lock(m_mutex);
+					m_condition.wait(lock, [this]()
+						{ return m_stop or not m_queue.empty(); });
+
+					if (m_queue.empty())
+						break;
+
+					task = std::move(m_queue.front());
+					m_queue.pop_front();
+				}
+
+				task();
+			}
+		}
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::deque<std::packaged_task<block()>> m_queue;
+		bool m_stop = false;
+		std::vector<std::thread> m_workers;
+	};
+
+	/// \brief Submit the block as soon as the buffer is full
+	int_type overflow(int_type ch) override
+	{
+		if (not m_active)
+			return traits_type::eof();
+
+		submit(false);
+
+		if (m_pending.size() >= 2 * m_threads and not write_first())
+			return traits_type::eof();
+
+		if (not traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*this->pptr() = traits_type::to_char_type(ch);
+			this->pbump(1);
+		}
+
+		return traits_type::not_eof(ch);
+	}
+
+	/// \brief Start compressing the data in the put area, @a last is true for the final block
+	void submit(bool last)
+	{
+		std::string data(this->pbase(), this->pptr());
+
+		if (m_bgzf)
+		{
+			if (not data.empty())
+			{
+				m_pending.emplace_back(m_pool->push(std::packaged_task<block()>(
+					[level = m_level, data = std::move(data)]() mutable
+					{ return compress_bgzf(level, std::move(data)); })));
+			}
+		}
+		else if (not data.empty() or last)
+		{
+			// the dictionary for the next block is the last part of the data seen so far
+			std::string dictionary = m_dictionary;
+			m_dictionary += data;
+			if (m_dictionary.length() > kWindowSize)
+				m_dictionary.erase(0, m_dictionary.length() - kWindowSize);
+
+			m_size += data.length();
+
+			m_pending.emplace_back(m_pool->push(std::packaged_task<block()>(
+				[level = m_level, data = std::move(data), dictionary = std::move(dictionary), last]() mutable
+				{ return compress(level, std::move(data), std::move(dictionary), last); })));
+		}
+
+		this->setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+	}
+
+	/// \brief Wait for the first pending block and write it to upstream
+	bool write_first()
+	{
+		block b;
+
+		try
+		{
+			b = m_pending.front().get();
+			m_pending.pop_front();
+		}
+		catch (...)
+		{
+			m_pending.pop_front();
+			return false;
+		}
+
+		m_crc = ::crc32_combine(m_crc, b.m_crc, static_cast<z_off_t>(b.m_size));
+
+		auto n = static_cast<std::streamsize>(b.m_data.length());
+		return this->m_upstream->sputn(reinterpret_cast<const char_type *>(b.m_data.data()), n) == n;
+	}
+
+	/// \brief Deflate @a data using @a dictionary as preset dictionary
+	static block compress(int level, std::string data, std::string dictionary, bool last)
+	{
+		block result{ {}, ::crc32(0, nullptr, 0), data.length() };
+		result.m_crc = ::crc32(result.m_crc, reinterpret_cast<const Bytef *>(data.data()), static_cast<uInt>(data.length()));
+
+		z_stream zstream{};
+
+		int err = ::deflateInit2(&zstream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		if (err != Z_OK)
+			throw std::runtime_error("Could not initialize zlib");
+
+		if (not dictionary.empty())
+			::deflateSetDictionary(&zstream, reinterpret_cast<const Bytef *>(dictionary.data()), static_cast<uInt>(dictionary.length()));
+
+		zstream.next_in = reinterpret_cast<Bytef *>(data.data());
+		zstream.avail_in = static_cast<uInt>(data.length());
+
+		result.m_data.resize(::deflateBound(&zstream, zstream.avail_in) + 16);
+
+		size_t n = 0;
+		for (;;)
+		{
+			zstream.next_out = reinterpret_cast<Bytef *>(result.m_data.data() + n);
+			zstream.avail_out = static_cast<uInt>(result.m_data.size() - n);
+
+			err = ::deflate(&zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+			n = result.m_data.size() - zstream.avail_out;
+
+			if (err == Z_STREAM_END or (not last and err == Z_OK and zstream.avail_out > 0) or err < Z_OK)
+				break;
+
+			result.m_data.resize(2 * result.m_data.size());
+		}
+
+		::deflateEnd(&zstream);
+
+		if (err < Z_OK)
+			throw std::runtime_error("Error compressing data");
+
+		result.m_data.resize(n);
+
+		return result;
+	}
+
+	/// \brief Compress @a data into a complete BGZF block
+	static block compress_bgzf(int level, std::string data)
+	{
+		auto b = compress(level, std::move(data), {}, true);
+
+		auto bsize = sizeof(detail::kBGZFHeader) + b.m_data.length() + 8;
+		if (bsize > 65536)
+			throw std::runtime_error("BGZF block too large");
+
+		unsigned char header[18], trailer[8];
+		std::copy(std::begin(detail::kBGZFHeader), std::end(detail::kBGZFHeader), header);
+		detail::store_uint16(header + 16, static_cast<uint16_t>(bsize - 1));
+		detail::store_uint32(trailer, static_cast<uint32_t>(b.m_crc));
+		detail::store_uint32(trailer + 4, static_cast<uint32_t>(b.m_size));
+
+		b.m_data.insert(0, reinterpret_cast<const char *>(header), sizeof(header));
+		b.m_data.append(reinterpret_cast<const char *>(trailer), sizeof(trailer));
+
+		return b;
+	}
+
+	/// \brief The deflate window size, the maximum size of a dictionary
+	static constexpr size_t kWindowSize = 32768;
+
+	int m_level;
+	size_t m_threads;
+	bool m_bgzf;
+	bool m_active = false;
+	std::vector<char_type> m_buffer;
+	std::string m_dictionary;
+	std::unique_ptr<worker_pool> m_pool;
+	std::deque<std::future<block>> m_pending;
+	uLong m_crc = 0;
+	size_t m_size = 0;
+};
+
+#if CIFPP_HAVE_ZSTD
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that decompresses Zstandard data
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+///
+/// Multiple concatenated frames are decompressed as one stream.
+
+template <typename CharT, typename Traits>
+class basic_izstd_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+
+	basic_izstd_streambuf() = default;
+
+	basic_izstd_streambuf(const basic_izstd_streambuf &) = delete;
+	basic_izstd_streambuf &operator=(const basic_izstd_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Move constructor, the buffers move along so the get area remains valid
+	basic_izstd_streambuf(basic_izstd_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_dstream(std::exchange(rhs.m_dstream, nullptr))
+		, m_input(rhs.m_input)
+		, m_output_pending(rhs.m_output_pending)
+		, m_in_buffer(std::move(rhs.m_in_buffer))
+		, m_out_buffer(std::move(rhs.m_out_buffer))
+	{
+		rhs.setg(nullptr, nullptr, nullptr);
+	}
+
+	~basic_izstd_streambuf()
+	{
+		close();
+	}
+
+	/// \brief Free the decompression context and set the get pointers to null.
+	base_type *close() override
+	{
+		if (m_dstream)
+		{
+			::ZSTD_freeDStream(m_dstream);
+			m_dstream = nullptr;
+		}
+
+		this->setg(nullptr, nullptr, nullptr);
+
+		return this;
+	}
+
+	/// \brief Create a decompression context reading from \a upstream
+	base_type *init(streambuf_type *upstream) override
+	{
+		this->set_upstream(upstream);
+
+		close();
+
+		m_dstream = ::ZSTD_createDStream();
+		if (m_dstream == nullptr or ::ZSTD_isError(::ZSTD_initDStream(m_dstream)))
+			return nullptr;
+
+		m_in_buffer.resize(::ZSTD_DStreamInSize());
+		m_out_buffer.resize(::ZSTD_DStreamOutSize());
+
+		m_input = { m_in_buffer.data(), 0, 0 };
+		m_output_pending = false;
+
+		return this;
+	}
+
+  private:
+	int_type underflow() override
+	{
+		if (m_dstream and this->m_upstream)
+		{
+			while (this->gptr() == this->egptr())
+			{
+				// Only read more input when the decompressor has nothing left to write
+				if (m_input.pos == m_input.size and not m_output_pending)
+				{
+					auto n = this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size());
+					if (n <= 0)
+						break;
+
+					m_input = { m_in_buffer.data(), static_cast<size_t>(n), 0 };
+				}
+
+				ZSTD_outBuffer output{ m_out_buffer.data(), m_out_buffer.size(), 0 };
+
+				auto r = ::ZSTD_decompressStream(m_dstream, &output, &m_input);
+				if (::ZSTD_isError(r))
+					break;
+
+				m_output_pending = output.pos == output.size;
+
+				if (output.pos > 0)
+					this->setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data() + output.pos);
+			}
+		}
+
+		return this->gptr() != this->egptr() ? traits_type::to_int_type(*this->gptr()) : traits_type::eof();
+	}
+
+	ZSTD_DStream *m_dstream = nullptr;
+	ZSTD_inBuffer m_input{};
+	bool m_output_pending = false;
+	std::vector<char_type> m_in_buffer, m_out_buffer;
+};
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that compresses data using Zstandard
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+///
+/// When more than one thread is requested and libzstd supports it, the
+/// compression is done by worker threads in the background. Long distance
+/// matching finds repetitions further back in the data than the regular
+/// window, this helps for large files containing many similar rows.
+
+template <typename CharT, typename Traits>
+class basic_ozstd_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+
+	basic_ozstd_streambuf(const basic_ozstd_streambuf &) = delete;
+	basic_ozstd_streambuf &operator=(const basic_ozstd_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Constructor taking the compression \a level, the number of
+	/// worker \a threads and whether to use long distance matching
+	basic_ozstd_streambuf(int level, size_t threads, bool long_distance_matching)
+		: m_level(level)
+		, m_threads(threads)
+		, m_long_distance_matching(long_distance_matching)
+	{
+	}
+
+	/// \brief Move constructor, the buffers move along so the put area remains valid
+	basic_ozstd_streambuf(basic_ozstd_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_level(rhs.m_level)
+		, m_threads(rhs.m_threads)
+		, m_long_distance_matching(rhs.m_long_distance_matching)
+		, m_cstream(std::exchange(rhs.m_cstream, nullptr))
+		, m_in_buffer(std::move(rhs.m_in_buffer))
+		, m_out_buffer(std::move(rhs.m_out_buffer))
+	{
+		rhs.setp(nullptr, nullptr);
+	}
+
+	~basic_ozstd_streambuf()
+	{
+		close();
+	}
+
+	/// \brief Write the end of the frame and free the compression context
+	base_type *close() override
+	{
+		base_type *result = this;
+
+		if (m_cstream)
+		{
+			if (not compress(ZSTD_e_end))
+				result = nullptr;
+
+			::ZSTD_freeCStream(m_cstream);
+			m_cstream = nullptr;
+		}
+
+		this->setp(nullptr, nullptr);
+
+		return result;
+	}
+
+	/// \brief Create a compression context writing to \a upstream
+	base_type *init(streambuf_type *upstream) override
+	{
+		this->set_upstream(upstream);
+
+		close();
+
+		m_cstream = ::ZSTD_createCStream();
+		if (m_cstream == nullptr or
+			::ZSTD_isError(::ZSTD_CCtx_setParameter(m_cstream, ZSTD_c_compressionLevel, m_level)) or
+			::ZSTD_isError(::ZSTD_CCtx_setParameter(m_cstream, ZSTD_c_checksumFlag, 1)) or
+			::ZSTD_isError(::ZSTD_CCtx_setParameter(m_cstream, ZSTD_c_enableLongDistanceMatching, m_long_distance_matching ? 1 : 0)))
+		{
+			return nullptr;
+		}
+
+		// This fails when libzstd was built without support for threads,
+		// in that case compression is done on the calling thread.
+		if (m_threads > 1)
+			::ZSTD_CCtx_setParameter(m_cstream, ZSTD_c_nbWorkers, static_cast<int>(m_threads));
+
+		m_in_buffer.resize(::ZSTD_CStreamInSize());
+		m_out_buffer.resize(::ZSTD_CStreamOutSize());
+
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+
+		return this;
+	}
+
+  private:
+	int_type overflow(int_type ch) override
+	{
+		if (not m_cstream or not compress(ZSTD_e_continue))
+			return traits_type::eof();
+
+		if (not traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*this->pptr() = traits_type::to_char_type(ch);
+			this->pbump(1);
+		}
+
+		return traits_type::not_eof(ch);
+	}
+
+	/// Compress the data in the put area, \a mode tells whether to
+	/// end the frame as well.
+	bool compress(ZSTD_EndDirective mode)
+	{
+		ZSTD_inBuffer input{ this->pbase(), static_cast<size_t>(this->pptr() - this->pbase()), 0 };
+
+		for (;;)
+		{
+			ZSTD_outBuffer output{ m_out_buffer.data(), m_out_buffer.size(), 0 };
+
+			auto remaining = ::ZSTD_compressStream2(m_cstream, &output, &input, mode);
+			if (::ZSTD_isError(remaining))
+				return false;
+
+			if (output.pos > 0 and this->m_upstream->sputn(m_out_buffer.data(), output.pos) != static_cast<std::streamsize>(output.pos))
+				return false;
+
+			if (mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0)
+				break;
+		}
+
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
+
+		return true;
+	}
+
+	int m_level;
+	size_t m_threads;
+	bool m_long_distance_matching;
+	ZSTD_CStream *m_cstream = nullptr;
+	std::vector<char_type> m_in_buffer, m_out_buffer;
+};
+
+#endif
+
+#if CIFPP_HAVE_LZ4
+
+// --------------------------------------------------------------------
+
+/// \brief A streambuf class that decompresses data in the LZ4 frame format
+///
+/// \tparam CharT		Type of the character stream.
+/// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
+
+template <typename CharT, typename Traits>
+class basic_ilz4_streambuf : public basic_streambuf<CharT, Traits>
+{
+  public:
+	/** @cond */
+
+	static_assert(sizeof(CharT) == 1, "Unfortunately, support for wide characters is not implemented yet.");
+
+	using char_type = CharT;
+	using traits_type = Traits;
+
+	using streambuf_type = std::basic_streambuf<char_type, traits_type>;
+	using base_type = basic_streambuf<CharT, Traits>;
+
+	using int_type = typename traits_type::int_type;
+
+	basic_ilz4_streambuf() = default;
+
+	basic_ilz4_streambuf(const basic_ilz4_streambuf &) = delete;
+	basic_ilz4_streambuf &operator=(const basic_ilz4_streambuf &) = delete;
+
+	/** @endcond */
+
+	/// \brief Move constructor, the buffers move along so the get area remains valid
+	basic_ilz4_streambuf(basic_ilz4_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_dctx(std::exchange(rhs.m_dctx, nullptr))
+		, m_in_pos(rhs.m_in_pos)
+		, m_in_size(rhs.m_in_size)
+		, m_output_pending(rhs.m_output_pending)
+		, m_in_buffer(std::move(rhs.m_in_buffer))
+		, m_out_buffer(std::move(rhs.m_out_buffer))
+	{
+		rhs.setg(nullptr, nullptr, nullptr);
 	}
 
-	~basic_igzip_streambuf()
+	~basic_ilz4_streambuf()
 	{
 		close();
 	}
 
-	/** @endcond */
-
-	/// \brief This closes the zlib stream and sets the get pointers to null.
+	/// \brief Free the decompression context and set the get pointers to null.
 	base_type *close() override
 	{
-		if (m_zstream)
+		if (m_dctx)
 		{
-			::inflateEnd(m_zstream.get());
-
-			m_zstream.reset(nullptr);
-			m_gzheader.reset(nullptr);
+			::LZ4F_freeDecompressionContext(m_dctx);
+			m_dctx = nullptr;
 		}
 
 		this->setg(nullptr, nullptr, nullptr);
@@ -206,119 +1716,83 @@ class basic_igzip_streambuf : public basic_streambuf<CharT, Traits>
 		return this;
 	}
 
-	/// \brief Initialize a zlib stream and set the upstream.
-	///
-	/// \param upstream The upstream streambuf
-	///
-	/// The zstream is constructed and an optional header is
-	/// read from upstream. The contents of the header are ignored
-	/// but we must maintain that structure.
+	/// \brief Create a decompression context reading from \a upstream
 	base_type *init(streambuf_type *upstream) override
 	{
 		this->set_upstream(upstream);
 
 		close();
 
-		m_zstream.reset(new z_stream_s);
-		m_gzheader.reset(new gz_header_s);
-
-		auto &zstream = *m_zstream.get();
-		zstream = z_stream_s{};
-		auto &header = *m_gzheader.get();
-		header = gz_header_s{};
-
-		int err = ::inflateInit2(&zstream, 47);
-		if (err == Z_OK)
+		if (::LZ4F_isError(::LZ4F_createDecompressionContext(&m_dctx, LZ4F_VERSION)))
 		{
-			zstream.next_in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
-			zstream.avail_in = static_cast<uInt>(this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size()));
-
-			err = ::inflateGetHeader(&zstream, &header);
-
-			if (err != Z_OK)
-				::inflateEnd(&zstream);
+			m_dctx = nullptr;
+			return nullptr;
 		}
 
-		if (err != Z_OK)
-			zstream = z_stream_s{};
+		m_in_buffer.resize(kBufferSize);
+		m_out_buffer.resize(kBufferSize);
 
-		return err == Z_OK ? this : nullptr;
+		m_in_pos = m_in_size = 0;
+		m_output_pending = false;
+
+		return this;
 	}
 
   private:
-	/// \brief The actual work is done here.
 	int_type underflow() override
 	{
-		if (m_zstream and this->m_upstream)
+		if (m_dctx and this->m_upstream)
 		{
-			auto &zstream = *m_zstream.get();
-			const std::streamsize kBufferByteSize = m_out_buffer.size();
-
 			while (this->gptr() == this->egptr())
 			{
-				zstream.next_out = reinterpret_cast<unsigned char *>(m_out_buffer.data());
-				zstream.avail_out = static_cast<uInt>(kBufferByteSize);
-
-				if (zstream.avail_in == 0)
+				// Only read more input when the decompressor has nothing left to write
+				if (m_in_pos == m_in_size and not m_output_pending)
 				{
-					zstream.next_in = reinterpret_cast<unsigned char *>(m_in_buffer.data());
-					zstream.avail_in = static_cast<uInt>(this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size()));
-				}
+					auto n = this->m_upstream->sgetn(m_in_buffer.data(), m_in_buffer.size());
+					if (n <= 0)
+						break;
 
-				if (zstream.avail_in == 0)
-					break;
+					m_in_pos = 0;
+					m_in_size = static_cast<size_t>(n);
+				}
 
-				int err = ::inflate(&zstream, Z_SYNC_FLUSH);
-				std::streamsize n = kBufferByteSize - zstream.avail_out;
+				size_t src_size = m_in_size - m_in_pos;
+				size_t dst_size = m_out_buffer.size();
 
-				if (n > 0)
-				{
-					this->setg(
-						m_out_buffer.data(),
-						m_out_buffer.data(),
-						m_out_buffer.data() + n);
+				auto r = ::LZ4F_decompress(m_dctx, m_out_buffer.data(), &dst_size, m_in_buffer.data() + m_in_pos, &src_size, nullptr);
+				if (::LZ4F_isError(r))
 					break;
-				}
 
-				if (err == Z_STREAM_END and zstream.avail_in > 0)
-					err = ::inflateReset2(&zstream, 47);
+				m_in_pos += src_size;
+				m_output_pending = dst_size == m_out_buffer.size();
 
-				if (err < Z_OK)
-					break;
+				if (dst_size > 0)
+					this->setg(m_out_buffer.data(), m_out_buffer.data(), m_out_buffer.data() + dst_size);
 			}
 		}
 
 		return this->gptr() != this->egptr() ? traits_type::to_int_type(*this->gptr()) : traits_type::eof();
 	}
 
-  private:
-	/// \brief The zlib internal structures are mainained as pointers to avoid having
-	/// to copy their content in move constructors.
-	std::unique_ptr<z_stream_s> m_zstream;
-
-	/// \brief The zlib internal structures are mainained as pointers to avoid having
-	/// to copy their content in move constructors.
-	std::unique_ptr<gz_header> m_gzheader;
-
-	/// \brief Input buffer, this is the input for zlib
-	std::array<char_type, BufferSize> m_in_buffer;
+	static constexpr size_t kBufferSize = 64 * 1024;
 
-	/// \brief Output buffer, where the ostream finds the data
-	std::array<char_type, BufferSize> m_out_buffer;
+	LZ4F_dctx *m_dctx = nullptr;
+	size_t m_in_pos = 0, m_in_size = 0;
+	bool m_output_pending = false;
+	std::vector<char_type> m_in_buffer, m_out_buffer;
 };
 
 // --------------------------------------------------------------------
 
-/// \brief A streambuf class that can be used to compress data using zlib
+/// \brief A streambuf class that compresses data in the LZ4 frame format
 ///
 /// \tparam CharT		Type of the character stream.
 /// \tparam Traits		Traits for character type, defaults to char_traits<_CharT>.
-/// \tparam BufferSize	The size of the internal buffers.
 ///
-/// This implementation of streambuf can compress (deflate) data using zlib.
+/// Levels below 3 use the fast LZ4 compressor, higher levels LZ4 HC.
 
-template <typename CharT, typename Traits, size_t BufferSize = kDefaultBufferSize>
-class basic_ogzip_streambuf : public basic_streambuf<CharT, Traits>
+template <typename CharT, typename Traits>
+class basic_olz4_streambuf : public basic_streambuf<CharT, Traits>
 {
   public:
 	/** @cond */
@@ -332,168 +1806,242 @@ class basic_ogzip_streambuf : public basic_streambuf<CharT, Traits>
 	using base_type = basic_streambuf<CharT, Traits>;
 
 	using int_type = typename traits_type::int_type;
-	using pos_type = typename traits_type::pos_type;
-	using off_type = typename traits_type::off_type;
 
-	basic_ogzip_streambuf() = default;
+	basic_olz4_streambuf(const basic_olz4_streambuf &) = delete;
+	basic_olz4_streambuf &operator=(const basic_olz4_streambuf &) = delete;
 
-	basic_ogzip_streambuf(const basic_ogzip_streambuf &) = delete;
+	/** @endcond */
 
-	/// \brief Move constructor
-	basic_ogzip_streambuf(basic_ogzip_streambuf &&rhs)
-		: base_type(std::move(rhs))
+	/// \brief Constructor taking the compression \a level
+	explicit basic_olz4_streambuf(int level)
+		: m_level(level)
 	{
-		std::swap(m_zstream, rhs.m_zstream);
-		std::swap(m_gzheader, rhs.m_gzheader);
-
-		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
-		this->sputn(rhs.pbase(), rhs.pptr() - rhs.pbase());
-		rhs.setp(nullptr, nullptr);
 	}
 
-	basic_ogzip_streambuf &operator=(const basic_ogzip_streambuf &) = delete;
-
-	/** @endcond */
-
-	/// \brief Move operator=
-	basic_ogzip_streambuf &operator=(basic_ogzip_streambuf &&rhs)
+	/// \brief Move constructor, the buffers move along so the put area remains valid
+	basic_olz4_streambuf(basic_olz4_streambuf &&rhs)
+		: base_type(std::move(rhs))
+		, m_level(rhs.m_level)
+		, m_cctx(std::exchange(rhs.m_cctx, nullptr))
+		, m_preferences(rhs.m_preferences)
+		, m_in_buffer(std::move(rhs.m_in_buffer))
+		, m_out_buffer(std::move(rhs.m_out_buffer))
 	{
-		base_type::operator=(std::move(rhs));
-
-		std::swap(m_zstream, rhs.m_zstream);
-		std::swap(m_gzheader, rhs.m_gzheader);
-
-		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
-		this->sputn(rhs.pbase(), rhs.pptr() - rhs.pbase());
 		rhs.setp(nullptr, nullptr);
-
-		return *this;
 	}
 
-	~basic_ogzip_streambuf()
+	~basic_olz4_streambuf()
 	{
 		close();
 	}
 
-	/// \brief This closes the zlib stream and sets the put pointers to null.
+	/// \brief Write the end of the frame and free the compression context
 	base_type *close() override
 	{
-		if (m_zstream)
-		{
-			overflow(traits_type::eof());
+		base_type *result = this;
 
-			::deflateEnd(m_zstream.get());
+		if (m_cctx)
+		{
+			if (not compress())
+				result = nullptr;
+			else
+			{
+				auto n = ::LZ4F_compressEnd(m_cctx, m_out_buffer.data(), m_out_buffer.size(), nullptr);
+				if (not write(n))
+					result = nullptr;
+			}
 
-			m_zstream.reset(nullptr);
-			m_gzheader.reset(nullptr);
+			::LZ4F_freeCompressionContext(m_cctx);
+			m_cctx = nullptr;
 		}
 
 		this->setp(nullptr, nullptr);
 
-		return this;
+		return result;
 	}
 
-	/// \brief Initialize the internal zlib structures
-	///
-	/// \param upstream The upstream streambuf
-	///
-	/// The zlib stream is initialized as one that can accept
-	/// a gzip header.
+	/// \brief Create a compression context and write the frame header to \a upstream
 	base_type *init(streambuf_type *upstream) override
 	{
 		this->set_upstream(upstream);
 
 		close();
 
-		m_zstream.reset(new z_stream_s);
-		m_gzheader.reset(new gz_header_s);
-
-		auto &zstream = *m_zstream.get();
-		zstream = z_stream_s{};
-		auto &header = *m_gzheader.get();
-		header = gz_header_s{};
+		if (::LZ4F_isError(::LZ4F_createCompressionContext(&m_cctx, LZ4F_VERSION)))
+		{
+			m_cctx = nullptr;
+			return nullptr;
+		}
 
-		const int WINDOW_BITS = 15, GZIP_ENCODING = 16;
+		m_preferences = LZ4F_preferences_t{};
+		m_preferences.compressionLevel = m_level;
+		m_preferences.frameInfo.blockSizeID = LZ4F_max64KB;
+		m_preferences.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
 
-		int err = deflateInit2(&zstream, Z_BEST_COMPRESSION, Z_DEFLATED,
-			WINDOW_BITS | GZIP_ENCODING, Z_DEFLATED, Z_DEFAULT_STRATEGY);
+		m_in_buffer.resize(kBufferSize);
+		m_out_buffer.resize(std::max<size_t>(::LZ4F_compressBound(kBufferSize, &m_preferences), LZ4F_HEADER_SIZE_MAX));
 
-		if (err == Z_OK)
-			err = ::deflateSetHeader(&zstream, &header);
+		if (not write(::LZ4F_compressBegin(m_cctx, m_out_buffer.data(), m_out_buffer.size(), &m_preferences)))
+			return nullptr;
 
-		if (err == Z_OK)
-			this->setp(this->m_in_buffer.data(), this->m_in_buffer.data() + this->m_in_buffer.size());
-		else
-			zstream = z_stream_s{};
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
 
-		return err == Z_OK ? this : nullptr;
+		return this;
 	}
 
   private:
-	/// \brief The actual work is done here
-	///
-	/// \param ch The character that did not fit, in case it is eof we need to flush
-	///
 	int_type overflow(int_type ch) override
 	{
-		if (not m_zstream)
+		if (not m_cctx or not compress())
 			return traits_type::eof();
 
-		auto &zstream = *m_zstream;
+		if (not traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			*this->pptr() = traits_type::to_char_type(ch);
+			this->pbump(1);
+		}
 
-		zstream.next_in = reinterpret_cast<unsigned char *>(this->pbase());
-		zstream.avail_in = static_cast<uInt>(this->pptr() - this->pbase());
+		return traits_type::not_eof(ch);
+	}
 
-		char_type buffer[BufferSize];
+	/// Compress the data in the put area
+	bool compress()
+	{
+		size_t n = this->pptr() - this->pbase();
 
-		for (;;)
-		{
-			zstream.next_out = reinterpret_cast<unsigned char *>(buffer);
-			zstream.avail_out = sizeof(buffer);
+		bool result = n == 0 or write(::LZ4F_compressUpdate(m_cctx, m_out_buffer.data(), m_out_buffer.size(), this->pbase(), n, nullptr));
 
-			int err = ::deflate(&zstream, ch == traits_type::eof() ? Z_FINISH : Z_NO_FLUSH);
+		this->setp(m_in_buffer.data(), m_in_buffer.data() + m_in_buffer.size());
 
-			std::streamsize n = sizeof(buffer) - zstream.avail_out;
-			if (n > 0)
-			{
-				auto r = this->m_upstream->sputn(reinterpret_cast<char_type *>(buffer), n);
+		return result;
+	}
 
-				if (r != n)
-					return traits_type::eof();
-			}
+	/// Write \a n bytes of the output buffer upstream, \a n is the result of an LZ4F call
+	bool write(size_t n)
+	{
+		return not ::LZ4F_isError(n) and
+		       (n == 0 or this->m_upstream->sputn(m_out_buffer.data(), n) == static_cast<std::streamsize>(n));
+	}
 
-			if (zstream.avail_out == 0)
-				continue;
+	static constexpr size_t kBufferSize = 64 * 1024;
 
-			if (err == Z_OK and ch == traits_type::eof())
-				continue;
+	int m_level;
+	LZ4F_cctx *m_cctx = nullptr;
+	LZ4F_preferences_t m_preferences{};
+	std::vector<char_type> m_in_buffer, m_out_buffer;
+};
 
-			break;
+#endif
+
+// --------------------------------------------------------------------
+
+/** @cond */
+namespace detail
+{
+	/// Return a new streambuf decompressing data in \a format read from
+	/// \a sb, or null if \a format is none. Throws when support for
+	/// \a format was not compiled in.
+	template <typename CharT, typename Traits>
+	std::unique_ptr<basic_streambuf<CharT, Traits>> make_decompressor(compression_format format, std::basic_streambuf<CharT, Traits> *sb)
+	{
+		std::unique_ptr<basic_streambuf<CharT, Traits>> result;
+
+		switch (format)
+		{
+			case compression_format::gzip:
+				if (is_bgzf(sb))
+					result.reset(new basic_ibgzf_streambuf<CharT, Traits>);
+				else
+					result.reset(new basic_igzip_streambuf<CharT, Traits>);
+				break;
+
+			case compression_format::zstd:
+#if CIFPP_HAVE_ZSTD
+				result.reset(new basic_izstd_streambuf<CharT, Traits>);
+				break;
+#else
+				throw std::runtime_error("Cannot read zstd compressed data, libcifpp was built without support for zstd");
+#endif
+
+			case compression_format::lz4:
+#if CIFPP_HAVE_LZ4
+				result.reset(new basic_ilz4_streambuf<CharT, Traits>);
+				break;
+#else
+				throw std::runtime_error("Cannot read LZ4 compressed data, libcifpp was built without support for LZ4");
+#endif
+
+			default:
+				break;
 		}
 
-		this->setp(this->m_in_buffer.data(), this->m_in_buffer.data() + this->m_in_buffer.size());
+		return result;
+	}
 
-		if (not traits_type::eq_int_type(ch, traits_type::eof()))
+	/// Return the format to write to a file named \a filename using \a options
+	inline compression_format output_format(const std::filesystem::path &filename, const compression_options &options)
+	{
+		auto result = options.format;
+
+		if (result == compression_format::automatic)
 		{
-			*this->pptr() = traits_type::to_char_type(ch);
-			this->pbump(1);
+			auto ext = filename.extension();
+			if (ext == ".gz")
+				result = compression_format::gzip;
+			else if (ext == ".zst")
+				result = compression_format::zstd;
+			else if (ext == ".lz4")
+				result = compression_format::lz4;
+			else
+				result = compression_format::none;
 		}
 
-		return ch;
+		return result;
 	}
 
-  private:
-	/// \brief The zlib internal structures are mainained as pointers to avoid having
-	/// to copy their content in move constructors.
-	std::unique_ptr<z_stream_s> m_zstream;
+	/// Return a new streambuf compressing data in \a format using \a options,
+	/// or null if \a format is none. Throws when support for \a format was
+	/// not compiled in.
+	template <typename CharT, typename Traits>
+	std::unique_ptr<basic_streambuf<CharT, Traits>> make_compressor(compression_format format, const compression_options &options)
+	{
+		std::unique_ptr<basic_streambuf<CharT, Traits>> result;
 
-	/// \brief The zlib internal structures are mainained as pointers to avoid having
-	/// to copy their content in move constructors.
-	std::unique_ptr<gz_header> m_gzheader;
+		size_t threads = options.threads > 0 ? options.threads : std::thread::hardware_concurrency();
 
-	/// \brief Input buffer, this is the input for zlib
-	std::array<char_type, BufferSize> m_in_buffer;
-};
+		switch (format)
+		{
+			case compression_format::gzip:
+				if (threads > 1 or options.bgzf)
+					result.reset(new basic_oparallel_gzip_streambuf<CharT, Traits>(options.level, threads, options.bgzf));
+				else
+					result.reset(new basic_ogzip_streambuf<CharT, Traits>(options.level));
+				break;
+
+			case compression_format::zstd:
+#if CIFPP_HAVE_ZSTD
+				result.reset(new basic_ozstd_streambuf<CharT, Traits>(options.level, threads, options.long_distance_matching));
+				break;
+#else
+				throw std::runtime_error("Cannot write zstd compressed data, libcifpp was built without support for zstd");
+#endif
+
+			case compression_format::lz4:
+#if CIFPP_HAVE_LZ4
+				result.reset(new basic_olz4_streambuf<CharT, Traits>(options.level));
+				break;
+#else
+				throw std::runtime_error("Cannot write LZ4 compressed data, libcifpp was built without support for LZ4");
+#endif
+
+			default:
+				break;
+		}
+
+		return result;
+	}
+} // namespace detail
+/** @endcond */
 
 // --------------------------------------------------------------------
 
@@ -522,6 +2070,7 @@ class basic_istream : public std::basic_istream<CharT, Traits>
 	using upstreambuf_type = std::basic_streambuf<char_type, traits_type>;
 
 	using gzip_streambuf_type = basic_igzip_streambuf<char_type, traits_type>;
+	using bgzf_streambuf_type = basic_ibgzf_streambuf<char_type, traits_type>;
 
 	/** @endcond */
 
@@ -573,19 +2122,12 @@ class basic_istream : public std::basic_istream<CharT, Traits>
 	/// This will sniff the content in \a sb and decide upon what is found
 	/// what implementation is used. If it doesn't look like compressed data
 	/// the \a sb streambuf is used without any decompression being done.
+	/// BGZF data in a seekable streambuf is read using basic_ibgzf_streambuf.
+	/// Recognizing zstd and LZ4 data requires a seekable streambuf.
 
 	void init_z(upstreambuf_type *sb)
 	{
-		int_type ch = sb->sgetc();
-		if (ch == 0x1f)
-		{
-			sb->sbumpc();
-			ch = sb->sgetc();
-			sb->sungetc();
-
-			if (ch == 0x8b) // Read gzip header
-				m_gziobuf.reset(new gzip_streambuf_type);
-		}
+		m_gziobuf = detail::make_decompressor(sniff_format(sb), sb);
 
 		if (m_gziobuf)
 		{
@@ -628,6 +2170,7 @@ class basic_ifstream : public basic_istream<CharT, Traits>
 	using filebuf_type = std::basic_filebuf<char_type, traits_type>;
 
 	using gzip_streambuf_type = typename base_type::gzip_streambuf_type;
+	using bgzf_streambuf_type = basic_ibgzf_streambuf<char_type, traits_type>;
 
 	/// \brief Default constructor, does not open a file since none is specified
 	basic_ifstream() = default;
@@ -702,6 +2245,11 @@ class basic_ifstream : public basic_istream<CharT, Traits>
 	/// \brief Open the file \a filename with mode \a mode
 	/// \param filename std::filesystem::path specifying the file to open
 	/// \param mode The mode in which to open the file
+	///
+	/// Compressed files are recognized by their content and decompressed.
+	/// When the file is blocked gzip (BGZF) the positions returned by tellg
+	/// are virtual offsets that can be used to seek directly to that
+	/// position using seekg.
 
 	void open(const std::filesystem::path &filename, std::ios_base::openmode mode = std::ios_base::in)
 	{
@@ -709,8 +2257,7 @@ class basic_ifstream : public basic_istream<CharT, Traits>
 			this->setstate(std::ios_base::failbit);
 		else
 		{
-			if (filename.extension() == ".gz")
-				this->m_gziobuf.reset(new gzip_streambuf_type);
+			this->m_gziobuf = detail::make_decompressor(sniff_format(&m_filebuf), &m_filebuf);
 
 			if (not this->m_gziobuf)
 			{
@@ -893,6 +2440,7 @@ class basic_ofstream : public basic_ostream<CharT, Traits>
 
 	using filebuf_type = std::basic_filebuf<char_type, traits_type>;
 	using gzip_streambuf_type = basic_ogzip_streambuf<char_type, traits_type>;
+	using parallel_gzip_streambuf_type = basic_oparallel_gzip_streambuf<char_type, traits_type>;
 
 	basic_ofstream() = default;
 
@@ -930,6 +2478,16 @@ class basic_ofstream : public basic_ostream<CharT, Traits>
 		open(filename, mode);
 	}
 
+	/// \brief Construct an ofstream
+	/// \param filename std::filesystem::path specifying the file to open
+	/// \param options The compression level and number of threads to use
+	/// \param mode The mode in which to open the file
+
+	basic_ofstream(const std::filesystem::path &filename, const compression_options &options, std::ios_base::openmode mode = std::ios_base::out)
+	{
+		open(filename, options, mode);
+	}
+
 	/// \brief Move constructor
 	basic_ofstream(basic_ofstream &&rhs)
 		: base_type(std::move(rhs))
@@ -967,19 +2525,31 @@ class basic_ofstream : public basic_ostream<CharT, Traits>
 	/// \param mode The mode in which to open the file
 	///
 	/// A compression algorithm is chosen upon the contents of the
-	/// extension() of \a filename with .gz mapping to gzip compression
-	/// and .xz to xz compression.
+	/// extension() of \a filename with .gz mapping to gzip compression,
+	/// .zst to zstd and .lz4 to LZ4 compression.
 
 	void open(const std::filesystem::path &filename, std::ios_base::openmode mode = std::ios_base::out)
+	{
+		open(filename, compression_options{}, mode);
+	}
+
+	/// \brief Open the file \a filename with mode \a mode
+	/// \param filename std::filesystem::path specifying the file to open
+	/// \param options The compression level and number of threads to use
+	/// \param mode The mode in which to open the file
+	///
+	/// Unless options.format says otherwise, files with extension .gz are
+	/// compressed with gzip, .zst with zstd and .lz4 with LZ4. When more than
+	/// one thread is requested, blocks of data are compressed in parallel.
+	/// With options.bgzf set, a gzip file is written as blocked gzip (BGZF).
+
+	void open(const std::filesystem::path &filename, const compression_options &options, std::ios_base::openmode mode = std::ios_base::out)
 	{
 		if (not m_filebuf.open(filename, mode | std::ios::binary))
 			this->setstate(std::ios_base::failbit);
 		else
 		{
-			if (filename.extension() == ".gz")
-				this->m_gziobuf.reset(new gzip_streambuf_type);
-			else
-				this->m_gziobuf.reset(nullptr);
+			this->m_gziobuf = detail::make_compressor<char_type, traits_type>(detail::output_format(filename, options), options);
 
 			if (this->m_gziobuf)
 			{
@@ -1004,8 +2574,8 @@ class basic_ofstream : public basic_ostream<CharT, Traits>
 	/// \param mode The mode in which to open the file
 	///
 	/// A compression algorithm is chosen upon the contents of the
-	/// extension of \a filename with .gz mapping to gzip compression
-	/// and .xz to xz compression.
+	/// extension of \a filename with .gz mapping to gzip compression,
+	/// .zst to zstd and .lz4 to LZ4 compression.
 
 	void open(const std::string &filename, std::ios_base::openmode mode = std::ios_base::out)
 	{
@@ -1017,8 +2587,8 @@ class basic_ofstream : public basic_ostream<CharT, Traits>
 	/// \param mode The mode in which to open the file
 	///
 	/// A compression algorithm is chosen upon the contents of the
-	/// extension of \a filename with .gz mapping to gzip compression
-	/// and .xz to xz compression.
+	/// extension of \a filename with .gz mapping to gzip compression,
+	/// .zst to zstd and .lz4 to LZ4 compression.
 
 	void open(const char *filename, std::ios_base::openmode mode = std::ios_base::out)
 	{
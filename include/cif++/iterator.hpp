@@ -29,6 +29,10 @@
 #include "cif++/row.hpp"
 
 #include <array>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <vector>
 
 /**
  * @file iterator.hpp
@@ -530,7 +534,8 @@ class conditional_iterator_proxy
 		using pointer = value_type *;
 		using reference = value_type;
 
-		conditional_iterator_impl(CategoryType &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix);
+		conditional_iterator_impl(CategoryType &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix,
+			const std::vector<row *> *candidates = nullptr, size_t candidate_ix = 0);
 		conditional_iterator_impl(const conditional_iterator_impl &i) = default;
 		conditional_iterator_impl &operator=(const conditional_iterator_impl &i) = default;
 
@@ -549,13 +554,35 @@ class conditional_iterator_proxy
 
 		conditional_iterator_impl &operator++()
 		{
-			while (m_begin != m_end)
+			if (m_candidates != nullptr)
 			{
-				if (++m_begin == m_end)
-					break;
-				
-				if (m_condition->operator()(m_begin))
-					break;
+				// Only the rows found in the index need to be tested
+				while (m_begin != m_end)
+				{
+					if (++m_candidate_ix >= m_candidates->size())
+					{
+						m_begin = m_end;
+						break;
+					}
+
+					row *r = (*m_candidates)[m_candidate_ix];
+					if (m_condition->operator()({ *m_cat, *r }))
+					{
+						m_begin = base_iterator(row_iterator(*m_cat, r), m_cix);
+						break;
+					}
+				}
+			}
+			else
+			{
+				while (m_begin != m_end)
+				{
+					if (++m_begin == m_end)
+						break;
+					
+					if (m_condition->operator()(m_begin))
+						break;
+				}
 			}
 
 			return *this;
@@ -585,6 +612,9 @@ class conditional_iterator_proxy
 		base_iterator m_begin, m_end;
 		value_type m_current;
 		const condition *m_condition;
+		std::array<uint16_t, N> m_cix;
+		const std::vector<row *> *m_candidates;
+		size_t m_candidate_ix;
 	};
 
 	using iterator = conditional_iterator_impl;
@@ -593,6 +623,9 @@ class conditional_iterator_proxy
 	template <typename... Ns>
 	conditional_iterator_proxy(CategoryType &cat, row_iterator pos, condition &&cond, Ns... names);
 
+	template <typename... Ns>
+	conditional_iterator_proxy(CategoryType &cat, row_iterator pos, const condition &cond, Ns... names);
+
 	conditional_iterator_proxy(conditional_iterator_proxy &&p);
 	conditional_iterator_proxy &operator=(conditional_iterator_proxy &&p);
 
@@ -617,10 +650,20 @@ class conditional_iterator_proxy
 	void swap(conditional_iterator_proxy &rhs);
 
   private:
+	const condition &get_condition() const { return m_borrowed_condition ? *m_borrowed_condition : m_condition; }
+
+	void find_first(const condition &cond);
+
 	CategoryType *m_cat;
 	condition m_condition;
+	const condition *m_borrowed_condition = nullptr; // a prepared condition owned by the caller
 	row_iterator mCBegin, mCEnd;
 	std::array<uint16_t, N> mCix;
+
+	// When the condition allows it, the rows to test are taken from the index of the category
+	bool m_use_candidates = false;
+	std::vector<row *> m_candidates;
+	size_t m_candidate_ix = 0;
 };
 
 // --------------------------------------------------------------------
@@ -653,11 +696,15 @@ iterator_proxy<Category, Ts...>::iterator_proxy(Category &cat, row_iterator pos,
 
 template <typename Category, typename... Ts>
 conditional_iterator_proxy<Category, Ts...>::conditional_iterator_impl::conditional_iterator_impl(
-	Category &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix)
+	Category &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix,
+	const std::vector<row *> *candidates, size_t candidate_ix)
 	: m_cat(&cat)
 	, m_begin(pos, cix)
 	, m_end(cat.end(), cix)
 	, m_condition(&cond)
+	, m_cix(cix)
+	, m_candidates(candidates)
+	, m_candidate_ix(candidate_ix)
 {
 	if (m_condition == nullptr or m_condition->empty())
 		m_begin = m_end;
@@ -672,7 +719,11 @@ conditional_iterator_proxy<Category, Ts...>::conditional_iterator_proxy(conditio
 {
 	std::swap(m_cat, p.m_cat);
 	std::swap(mCix, p.mCix);
+	std::swap(m_borrowed_condition, p.m_borrowed_condition);
 	m_condition.swap(p.m_condition);
+	std::swap(m_use_candidates, p.m_use_candidates);
+	std::swap(m_candidates, p.m_candidates);
+	std::swap(m_candidate_ix, p.m_candidate_ix);
 }
 
 template <typename Category, typename... Ts>
@@ -686,19 +737,58 @@ conditional_iterator_proxy<Category, Ts...>::conditional_iterator_proxy(Category
 	static_assert(sizeof...(Ts) == sizeof...(Ns), "Number of item names should be equal to number of requested value types");
 
 	if (m_condition)
-	{
 		m_condition.prepare(cat);
 
-		while (mCBegin != mCEnd and not m_condition(*mCBegin))
-			++mCBegin;
-	}
-	else
-		mCBegin = mCEnd;
+	find_first(m_condition);
+
+	uint16_t i = 0;
+	((mCix[i++] = m_cat->get_item_ix(names)), ...);
+}
+
+template <typename Category, typename... Ts>
+template <typename... Ns>
+conditional_iterator_proxy<Category, Ts...>::conditional_iterator_proxy(Category &cat, row_iterator pos, const condition &cond, Ns... names)
+	: m_cat(&cat)
+	, m_borrowed_condition(&cond)
+	, mCBegin(pos)
+	, mCEnd(cat.end())
+{
+	static_assert(sizeof...(Ts) == sizeof...(Ns), "Number of item names should be equal to number of requested value types");
+
+	assert(cond.empty() or cond.is_prepared());
+
+	find_first(cond);
 
 	uint16_t i = 0;
 	((mCix[i++] = m_cat->get_item_ix(names)), ...);
 }
 
+template <typename Category, typename... Ts>
+void conditional_iterator_proxy<Category, Ts...>::find_first(const condition &cond)
+{
+	if (cond.empty())
+		mCBegin = mCEnd;
+	else if (auto range = cond.range();
+			 range.has_value() and mCBegin == m_cat->begin() and m_cat->find_in_index(*range, m_candidates))
+	{
+		// Rows are now returned in the order of the index
+		m_use_candidates = true;
+
+		while (m_candidate_ix < m_candidates.size() and not cond({ *m_cat, *m_candidates[m_candidate_ix] }))
+			++m_candidate_ix;
+
+		if (m_candidate_ix < m_candidates.size())
+			mCBegin = row_iterator(*m_cat, m_candidates[m_candidate_ix]);
+		else
+			mCBegin = mCEnd;
+	}
+	else
+	{
+		while (mCBegin != mCEnd and not cond(*mCBegin))
+			++mCBegin;
+	}
+}
+
 template <typename Category, typename... Ts>
 conditional_iterator_proxy<Category, Ts...> &conditional_iterator_proxy<Category, Ts...>::operator=(conditional_iterator_proxy &&p)
 {
@@ -709,13 +799,13 @@ conditional_iterator_proxy<Category, Ts...> &conditional_iterator_proxy<Category
 template <typename Category, typename... Ts>
 typename conditional_iterator_proxy<Category, Ts...>::iterator conditional_iterator_proxy<Category, Ts...>::begin() const
 {
-	return iterator(*m_cat, mCBegin, m_condition, mCix);
+	return iterator(*m_cat, mCBegin, get_condition(), mCix, m_use_candidates ? &m_candidates : nullptr, m_candidate_ix);
 }
 
 template <typename Category, typename... Ts>
 typename conditional_iterator_proxy<Category, Ts...>::iterator conditional_iterator_proxy<Category, Ts...>::end() const
 {
-	return iterator(*m_cat, mCEnd, m_condition, mCix);
+	return iterator(*m_cat, mCEnd, get_condition(), mCix);
 }
 
 template <typename Category, typename... Ts>
@@ -729,11 +819,287 @@ void conditional_iterator_proxy<Category, Ts...>::swap(conditional_iterator_prox
 {
 	std::swap(m_cat, rhs.m_cat);
 	m_condition.swap(rhs.m_condition);
+	std::swap(m_borrowed_condition, rhs.m_borrowed_condition);
 	std::swap(mCBegin, rhs.mCBegin);
 	std::swap(mCEnd, rhs.mCEnd);
 	std::swap(mCix, rhs.mCix);
+	std::swap(m_use_candidates, rhs.m_use_candidates);
+	std::swap(m_candidates, rhs.m_candidates);
+	std::swap(m_candidate_ix, rhs.m_candidate_ix);
 }
 
 /** @endcond */
 
-} // namespace cif
\ No newline at end of file
+// --------------------------------------------------------------------
+// query proxy
+
+/** @cond */
+namespace detail
+{
+	template <typename... Ts>
+	struct query_value_type
+	{
+		using type = std::tuple<Ts...>;
+	};
+
+	template <typename T>
+	struct query_value_type<T>
+	{
+		using type = T;
+	};
+
+	template <>
+	struct query_value_type<>
+	{
+		using type = row_handle;
+	};
+} // namespace detail
+/** @endcond */
+
+/**
+ * @brief A query_proxy is a lazy range over the rows of a category. It is
+ * built step by step, the rows are only visited when iterating over the result.
+ *
+ * @code {.cpp}
+ * for (const auto &[x, y, z] : atom_site.query()
+ *                                   .where(cif::key("label_asym_id") == "A")
+ *                                   .select<float, float, float>("Cartn_x", "Cartn_y", "Cartn_z")
+ *                                   .limit(10))
+ *     ...
+ * @endcode
+ *
+ * Filtering and projection are done in a single pass and values are only
+ * converted for the rows that match, when the iterator is dereferenced.
+ * Iteration stops as soon as the limit is reached. Without a call to where
+ * all rows are returned.
+ *
+ * When the condition limits the values of the first key item, the rows to
+ * test are taken from the index of the category, like category::find does.
+ * The rows are then returned in the order of the index. The count method
+ * uses the index as well, or evaluates the condition on blocks of rows.
+ *
+ * The steps consume the query_proxy they are called on.
+ *
+ * @tparam CategoryType The category the query acts upon
+ * @tparam Ts The types of the selected values, when empty the iterators
+ * return row_handles
+ */
+template <typename CategoryType, typename... Ts>
+class query_proxy
+{
+  public:
+	/** @cond */
+	static constexpr const size_t N = sizeof...(Ts);
+
+	using category_type = std::remove_cv_t<CategoryType>;
+	using value_type = typename detail::query_value_type<Ts...>::type;
+	using row_iterator = iterator_impl<CategoryType>;
+	using candidate_list = std::vector<row *>;
+
+	class query_iterator
+	{
+	  public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = query_proxy::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = value_type *;
+		using reference = value_type;
+
+		query_iterator(const query_proxy &q, row_iterator pos, size_t emitted,
+			std::shared_ptr<const candidate_list> candidates = {})
+			: m_query(&q)
+			, m_current(pos)
+			, m_emitted(emitted)
+			, m_candidates(std::move(candidates))
+		{
+			skip();
+		}
+
+		query_iterator(const query_iterator &i) = default;
+		query_iterator &operator=(const query_iterator &i) = default;
+
+		reference operator*() const
+		{
+			return m_query->get(m_current, std::make_index_sequence<N>());
+		}
+
+		query_iterator &operator++()
+		{
+			if (m_candidates)
+				++m_candidate_ix;
+			else
+				++m_current;
+			++m_emitted;
+			skip();
+			return *this;
+		}
+
+		query_iterator operator++(int)
+		{
+			query_iterator result(*this);
+			this->operator++();
+			return result;
+		}
+
+		/// Return the row_handle for the current row
+		row_handle row() const { return m_current; }
+
+		bool operator==(const query_iterator &rhs) const { return m_current == rhs.m_current; }
+		bool operator!=(const query_iterator &rhs) const { return m_current != rhs.m_current; }
+
+	  private:
+		// Move to the next matching row, or to the end if the limit is reached
+		void skip()
+		{
+			auto &cat = *m_query->m_cat;
+			auto &cond = m_query->m_condition;
+			auto end = cat.end();
+
+			if (m_emitted >= m_query->m_limit)
+				m_current = end;
+			else if (m_candidates)
+			{
+				// Only the rows found in the index need to be tested
+				while (m_candidate_ix < m_candidates->size() and not cond({ cat, *(*m_candidates)[m_candidate_ix] }))
+					++m_candidate_ix;
+
+				if (m_candidate_ix < m_candidates->size())
+					m_current = row_iterator(cat, (*m_candidates)[m_candidate_ix]);
+				else
+					m_current = end;
+			}
+			else if (not cond.empty())
+			{
+				while (m_current != end and not cond(m_current))
+					++m_current;
+			}
+		}
+
+		const query_proxy *m_query;
+		row_iterator m_current;
+		size_t m_emitted;
+		std::shared_ptr<const candidate_list> m_candidates;
+		size_t m_candidate_ix = 0;
+	};
+
+	using iterator = query_iterator;
+	using reference = typename iterator::reference;
+
+	query_proxy(CategoryType &cat)
+		: m_cat(&cat)
+	{
+	}
+
+	query_proxy(query_proxy &&) = default;
+	query_proxy &operator=(query_proxy &&) = default;
+
+	query_proxy(const query_proxy &) = delete;
+	query_proxy &operator=(const query_proxy &) = delete;
+	/** @endcond */
+
+	/**
+	 * @brief Only return the rows that match @a cond, when called more than
+	 * once the conditions are combined using AND.
+	 */
+	query_proxy where(condition &&cond) &&
+	{
+		m_condition = std::move(m_condition) and std::move(cond);
+		if (not m_condition.empty())
+			m_condition.prepare(*m_cat);
+		return std::move(*this);
+	}
+
+	/**
+	 * @brief Return the values of the items named @a names converted to
+	 * types @a T2s instead of row_handles.
+	 */
+	template <typename... T2s, typename... Ns>
+	query_proxy<CategoryType, T2s...> select(Ns... names) &&
+	{
+		static_assert(sizeof...(T2s) == sizeof...(Ns), "Number of item names should be equal to number of requested value types");
+
+		query_proxy<CategoryType, T2s...> result(*m_cat);
+
+		result.m_condition = std::move(m_condition);
+		result.m_limit = m_limit;
+
+		uint16_t i = 0;
+		((result.m_item_ix[i++] = m_cat->get_item_ix(names)), ...);
+
+		return result;
+	}
+
+	/**
+	 * @brief Stop after at most @a n rows
+	 */
+	query_proxy limit(size_t n) &&
+	{
+		m_limit = std::min(m_limit, n);
+		return std::move(*this);
+	}
+
+	iterator begin() const ///< Return the iterator pointing to the first matching row
+	{
+		std::shared_ptr<candidate_list> candidates;
+
+		if (auto range = m_condition.range(); range.has_value())
+		{
+			candidates = std::make_shared<candidate_list>();
+			if (not m_cat->find_in_index(*range, *candidates))
+				candidates.reset();
+		}
+
+		return iterator(*this, m_cat->begin(), 0, std::move(candidates));
+	}
+
+	iterator end() const ///< Return the iterator pointing past the last row
+	{
+		return iterator(*this, m_cat->end(), m_limit);
+	}
+
+	/// Return true if the query has no result, stops at the first match
+	bool empty() const { return begin() == end(); }
+
+	explicit operator bool() const { return not empty(); } ///< Easy way to detect if the range is empty
+
+	/// Return the number of results, no values are converted
+	size_t count() const
+	{
+		size_t result;
+
+		if (m_limit != std::numeric_limits<size_t>::max())
+			result = std::distance(begin(), end());
+		else if (m_condition.empty())
+			result = m_cat->size();
+		else
+			result = m_cat->count(std::as_const(m_condition));
+
+		return result;
+	}
+
+	value_type front() const { return *begin(); } ///< Return the first result
+
+	CategoryType &category() const { return *m_cat; } ///< Category the query acts upon
+
+  private:
+	template <typename, typename...>
+	friend class query_proxy;
+
+	template <size_t... Is>
+	value_type get(row_handle r, std::index_sequence<Is...>) const
+	{
+		if constexpr (N == 0)
+			return r;
+		else if constexpr (N == 1)
+			return r[m_item_ix[0]].template as<value_type>();
+		else
+			return value_type{ r[m_item_ix[Is]].template as<Ts>()... };
+	}
+
+	CategoryType *m_cat;
+	condition m_condition; // prepared in where
+	std::array<uint16_t, N> m_item_ix;
+	size_t m_limit = std::numeric_limits<size_t>::max();
+};
+
+} // namespace cif
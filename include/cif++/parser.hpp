@@ -254,6 +254,9 @@ class sac_parser
 	virtual void produce_row() = 0;
 	virtual void produce_item(std::string_view category, std::string_view item, std::string_view value) = 0;
 
+	// Called by parse_file when the end of the data was reached
+	virtual void produce_end_of_file() {}
+
   protected:
 
 	enum class State
@@ -281,6 +284,12 @@ class sac_parser
 	bool m_bol;
 	CIFToken m_lookahead;
 
+	// Offsets in the data, counted from the start of parsing. These are
+	// only meaningful when parsing started at the beginning, as in parse_file
+	size_t m_offset = 0;         // number of characters read
+	size_t m_token_start = 0;    // start of the lookahead token
+	size_t m_category_start = 0; // start of the category passed to produce_category
+
 	// token buffer
 	std::vector<char> m_token_buffer;
 	std::string_view m_token_value;
@@ -306,6 +315,26 @@ class parser : public sac_parser
 	{
 	}
 
+	/// \brief Validate each value against its item validator in @a v as soon
+	/// as it is read. Invalid values are reported using validator::report_error,
+	/// when @a fail_fast is true this throws an exception at the first invalid value.
+	void set_validator(const validator *v, bool fail_fast)
+	{
+		m_validator = v;
+		m_fail_fast = fail_fast;
+	}
+
+	/// \brief Return false if values were found that are not valid, see set_validator
+	bool values_are_valid() const { return m_values_are_valid; }
+
+	/// \brief Attach the text of each category to the category, so that it can be
+	/// written verbatim as long as it is not modified. @a text should contain the
+	/// complete data parsed by parse_file.
+	void set_source_text(std::shared_ptr<const std::string> text)
+	{
+		m_source_text = std::move(text);
+	}
+
 	/** @cond */
 	void produce_datablock(std::string_view name) override;
 
@@ -315,12 +344,26 @@ class parser : public sac_parser
 
 	void produce_item(std::string_view category, std::string_view item, std::string_view value) override;
 
+	void produce_end_of_file() override;
+
   protected:
+	/// Attach the source text up to @a end to the category being read, if any
+	void end_source_range(size_t end);
+
 	file &m_file;
 	datablock *m_datablock = nullptr;
 	category *m_category = nullptr;
 	row_handle m_row;
 
+	const validator *m_validator = nullptr;
+	const category_validator *m_cat_validator = nullptr;
+	bool m_fail_fast = false;
+	bool m_values_are_valid = true;
+
+	std::shared_ptr<const std::string> m_source_text;
+	category *m_source_category = nullptr;
+	size_t m_source_start = 0;
+
 	/** @endcond */
 };
 
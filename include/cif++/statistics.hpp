@@ -0,0 +1,116 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file statistics.hpp
+ *
+ * Statistics for the items in a category, see category::get_item_statistics
+ */
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief A HyperLogLog sketch, used to estimate the number of distinct
+ * values in a collection using a small fixed amount of memory.
+ *
+ * With the precision used here the standard error of the estimate
+ * is about 3%, small numbers of distinct values are counted nearly exact.
+ */
+class hyperloglog
+{
+  public:
+	/// @brief The number of bits of the hash used to select a register
+	static constexpr uint32_t kPrecision = 10;
+
+	/// @brief The number of registers
+	static constexpr size_t kRegisterCount = size_t{ 1 } << kPrecision;
+
+	/// @brief Add the value @a value to the sketch
+	void add(std::string_view value);
+
+	/// @brief Add the values seen by sketch @a rhs
+	void merge(const hyperloglog &rhs);
+
+	/// @brief Return the estimated number of distinct values added
+	size_t estimate() const;
+
+	/// @brief Forget all values
+	void clear() { m_registers.clear(); }
+
+  private:
+	std::vector<uint8_t> m_registers;
+};
+
+// --------------------------------------------------------------------
+
+/**
+ * @brief The statistics for an item in a category
+ */
+struct item_statistics
+{
+	std::string m_name;                 ///< The name of the item
+	size_t m_null_count = 0;            ///< Number of rows containing '.', meaning inapplicable
+	size_t m_unknown_count = 0;         ///< Number of rows containing '?' or no value at all
+	size_t m_distinct_count = 0;        ///< Estimated number of distinct values, '.' and '?' excluded
+	size_t m_numeric_count = 0;         ///< Number of values that are numbers
+	std::optional<double> m_min, m_max; ///< The smallest and largest numeric value, if any
+};
+
+/** @cond */
+namespace detail
+{
+	// The counters for an item, maintained by category. Counts are always
+	// exact, the sketch and the range may be out of date after a value was
+	// removed, in which case the counters are marked stale and need
+	// to be collected again.
+	struct item_counters
+	{
+		size_t m_value_count = 0;
+		size_t m_null_count = 0;
+		size_t m_unknown_count = 0;
+		size_t m_numeric_count = 0;
+		double m_min = 0, m_max = 0;
+		hyperloglog m_distinct;
+		bool m_stale = true;
+
+		void add(std::string_view value);
+		void remove(std::string_view value);
+	};
+} // namespace detail
+/** @endcond */
+
+} // namespace cif
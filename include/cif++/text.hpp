@@ -315,6 +315,30 @@ inline char tolower(int ch)
 	return static_cast<char>(kCharToLowerMap[static_cast<uint8_t>(ch)]);
 }
 
+/// \brief a hash function object for strings that ignores character case,
+/// to be used together with iequal_to in unordered containers
+struct ihash
+{
+	/// \brief return the FNV-1a hash of the lower case version of @a s
+	size_t operator()(std::string_view s) const
+	{
+		uint64_t h = 14695981039346656037ULL;
+		for (auto ch : s)
+			h = (h ^ static_cast<uint8_t>(tolower(ch))) * 1099511628211ULL;
+		return static_cast<size_t>(h);
+	}
+};
+
+/// \brief an operator object you can use to test strings for equality ignoring their character case
+struct iequal_to
+{
+	/// \brief return the result of iequals for @a a and @a b
+	bool operator()(std::string_view a, std::string_view b) const
+	{
+		return iequals(a, b);
+	}
+};
+
 // --------------------------------------------------------------------
 
 /** \brief return a tuple consisting of the category and item name for @a item_name
@@ -29,10 +29,13 @@
 #include "cif++/text.hpp"
 
 #include <cassert>
+#include <deque>
 #include <filesystem>
 #include <list>
 #include <mutex>
+#include <optional>
 #include <system_error>
+#include <unordered_map>
 #include <utility>
 
 /**
@@ -345,6 +348,34 @@ struct category_validator
 	cif::iset m_mandatory_items;                ///< The mandatory items for this category
 	std::set<item_validator> m_item_validators; ///< The item validators for the items in this category
 
+	/// @brief An index on item validators by name. The entries point into
+	/// m_item_validators of the owning category_validator, a copy of the index
+	/// would refer to the original and therefore starts out empty. Moving a
+	/// std::set keeps its elements in place, so a moved index stays valid.
+	struct item_validator_index : public std::unordered_map<std::string_view, const item_validator *, ihash, iequal_to>
+	{
+		/** @cond */
+		item_validator_index() = default;
+		item_validator_index(const item_validator_index &)
+			: unordered_map()
+		{
+		}
+		item_validator_index(item_validator_index &&) = default;
+
+		item_validator_index &operator=(const item_validator_index &)
+		{
+			clear();
+			return *this;
+		}
+
+		item_validator_index &operator=(item_validator_index &&) = default;
+		/** @endcond */
+	};
+
+	/// @brief The item validators in m_item_validators by name, filled by add_item_validator.
+	/// Empty in a copy of a category_validator, lookups then use m_item_validators.
+	item_validator_index m_item_validator_index;
+
 	/// @brief return true if this category sorts before @a rhs
 	bool operator<(const category_validator &rhs) const
 	{
@@ -427,6 +458,12 @@ class validator
 	/// @brief Return the category validator for @a category, may return nullptr
 	const category_validator *get_validator_for_category(std::string_view category) const;
 
+	/// @brief Return all category validators, sorted by name
+	const std::set<category_validator> &get_category_validators() const
+	{
+		return m_category_validators;
+	}
+
 	/// @brief Add link_validator @a v to the list of link validators
 	void add_link_validator(link_validator &&v);
 
@@ -436,6 +473,17 @@ class validator
 	/// @brief Return the list of link validators for which the child is @a category
 	std::vector<const link_validator *> get_links_for_child(std::string_view category) const;
 
+	/**
+	 * @brief Return the indices of the category names in @a categories in
+	 * parent first order, the order in which categories are written.
+	 *
+	 * Each category is ranked after the parents it has in @a categories,
+	 * categories with equal rank are ordered by name in descending order.
+	 * The links are kept as a graph of category numbers, so no names are
+	 * compared while ranking.
+	 */
+	std::vector<size_t> order_parents_first(const std::vector<std::string_view> &categories) const;
+
 	/// @brief Bottleneck function to report an error in validation
 	void report_error(validation_error err, bool fatal = true) const
 	{
@@ -462,6 +510,28 @@ class validator
 	const std::string &version() const { return m_version; }              ///< Get the version of this validator
 	void set_version(const std::string &version) { m_version = version; } ///< Set the version of this validator
 
+	/**
+	 * @brief Write a compact binary representation of this validator to @a os.
+	 * The data is tagged with @a checksum, the checksum of the dictionary this
+	 * validator was constructed from. See load_binary.
+	 */
+	void save_binary(std::ostream &os, uint64_t checksum) const;
+
+	/**
+	 * @brief Reconstruct a validator from the binary data in @a data written
+	 * by save_binary. The data is read in place, it can e.g. be a memory mapped
+	 * file.
+	 *
+	 * @param data The binary data
+	 * @param checksum The checksum of the dictionary the validator should have been constructed from
+	 * @return The validator, or nothing if the data was written by an incompatible version or
+	 * for a dictionary with another checksum. Corrupt data results in an exception.
+	 */
+	static std::optional<validator> load_binary(std::string_view data, uint64_t checksum);
+
+	/// @brief Return the checksum for dictionary @a text as used by save_binary and load_binary
+	static uint64_t checksum(std::string_view text);
+
   private:
 	// name is fully qualified here:
 	item_validator *get_validator_for_item(std::string_view name) const;
@@ -469,13 +539,47 @@ class validator
 	std::string m_name;
 	std::string m_version;
 	bool m_strict = false;
+	void add_link(link_validator &&v);
+
+	template <typename T>
+	using name_index = std::unordered_map<std::string_view, T, ihash, iequal_to>;
+
 	std::set<type_validator> m_type_validators;
 	std::set<category_validator> m_category_validators;
-	std::vector<link_validator> m_link_validators;
+	std::deque<link_validator> m_link_validators;
+
+	// Lookup tables, the keys point to the names stored in the validators above
+	name_index<const type_validator *> m_type_index;
+	name_index<const category_validator *> m_category_index;
+	name_index<std::vector<const link_validator *>> m_links_by_parent, m_links_by_child;
+
+	// The links as a graph of category numbers, for order_parents_first. For each
+	// category taking part in a link, the numbers of its parents, one per link.
+	uint32_t get_link_category_nr(std::string_view category);
+
+	name_index<uint32_t> m_link_category_nrs;
+	std::vector<std::vector<uint32_t>> m_link_parents;
 };
 
 // --------------------------------------------------------------------
 
+/**
+ * @brief Set the number of threads used to validate datablocks and categories
+ *
+ * When @a n is larger than one, the categories of a datablock are validated
+ * concurrently and the rows of large categories are validated in partitions.
+ * Errors are reported in the same order as when validating sequentially.
+ *
+ * @param n The number of threads, zero means use the number of hardware threads.
+ * The default is one, validating sequentially.
+ */
+void set_validation_thread_count(size_t n);
+
+/// @brief Return the number of threads used for validation, see set_validation_thread_count
+size_t get_validation_thread_count();
+
+// --------------------------------------------------------------------
+
 /**
  * @brief Validators are globally unique objects, use the validator_factory
  * class to construct them. This class is a singleton.
@@ -491,15 +595,28 @@ class validator_factory
 	const validator &operator[](std::string_view dictionary_name);
 
 	/// @brief Construct a new validator with name @a name from the data in @a is
+	///
+	/// When a cache directory is set, a binary version of the validator is
+	/// stored there. The next time the same dictionary is requested that
+	/// binary version is used instead of parsing the dictionary again.
 	const validator &construct_validator(std::string_view name, std::istream &is);
 
+	/// @brief Set the directory for cached binary versions of validators, an
+	/// empty path disables the cache. The cache is disabled by default, unless
+	/// the environment variable LIBCIFPP_CACHE_DIR is set.
+	void set_cache_directory(const std::filesystem::path &dir);
+
+	/// @brief Return the directory for cached binary versions of validators
+	std::filesystem::path get_cache_directory();
+
   private:
 	// --------------------------------------------------------------------
 
-	validator_factory() = default;
+	validator_factory();
 
 	std::mutex m_mutex;
 	std::list<validator> m_validators;
+	std::filesystem::path m_cache_dir;
 };
 
 } // namespace cif
@@ -0,0 +1,1263 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/bcif.hpp"
+#include "cif++/utilities.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace cif::bcif
+{
+
+// --------------------------------------------------------------------
+// A minimal MessagePack implementation, only what is needed for BinaryCIF
+
+namespace
+{
+
+	/// A node in a parsed MessagePack tree. Strings and binary data
+	/// point into the buffer containing the data. Maps are stored
+	/// as a list of alternating keys and values.
+	struct msgpack_value
+	{
+		enum class value_type
+		{
+			nil,
+			boolean,
+			integer,
+			real,
+			string,
+			binary,
+			array,
+			map
+		} type = value_type::nil;
+
+		int64_t i = 0;
+		double d = 0;
+		std::string_view s;
+		std::vector<msgpack_value> items;
+
+		static const msgpack_value s_nil;
+
+		const msgpack_value &operator[](std::string_view key) const
+		{
+			if (type == value_type::map)
+			{
+				for (size_t ix = 0; ix + 1 < items.size(); ix += 2)
+				{
+					if (items[ix].s == key)
+						return items[ix + 1];
+				}
+			}
+
+			return s_nil;
+		}
+
+		bool is_nil() const { return type == value_type::nil; }
+
+		int64_t as_int() const
+		{
+			if (type == value_type::real)
+				return static_cast<int64_t>(d);
+			if (type != value_type::integer and type != value_type::boolean)
+				throw std::runtime_error("BinaryCIF: expected an integer");
+			return i;
+		}
+
+		double as_double() const
+		{
+			if (type == value_type::integer)
+				return static_cast<double>(i);
+			if (type != value_type::real)
+				throw std::runtime_error("BinaryCIF: expected a number");
+			return d;
+		}
+
+		std::string_view as_string() const
+		{
+			if (type != value_type::string and type != value_type::binary)
+				throw std::runtime_error("BinaryCIF: expected a string");
+			return s;
+		}
+	};
+
+	const msgpack_value msgpack_value::s_nil;
+
+	class msgpack_reader
+	{
+	  public:
+		msgpack_reader(const char *data, size_t length)
+			: m_ptr(reinterpret_cast<const uint8_t *>(data))
+			, m_end(m_ptr + length)
+		{
+		}
+
+		msgpack_value read()
+		{
+			msgpack_value result;
+
+			uint8_t b = next();
+
+			if (b <= 0x7f)
+				set_int(result, b);
+			else if (b <= 0x8f)
+				read_items(result, msgpack_value::value_type::map, 2 * (b & 0x0f));
+			else if (b <= 0x9f)
+				read_items(result, msgpack_value::value_type::array, b & 0x0f);
+			else if (b <= 0xbf)
+				read_bytes(result, msgpack_value::value_type::string, b & 0x1f);
+			else if (b >= 0xe0)
+				set_int(result, static_cast<int8_t>(b));
+			else
+			{
+				switch (b)
+				{
+					case 0xc0: break;
+					case 0xc2: result.type = msgpack_value::value_type::boolean; break;
+					case 0xc3: result.type = msgpack_value::value_type::boolean; result.i = 1; break;
+					case 0xc4: read_bytes(result, msgpack_value::value_type::binary, read_be<uint8_t>()); break;
+					case 0xc5: read_bytes(result, msgpack_value::value_type::binary, read_be<uint16_t>()); break;
+					case 0xc6: read_bytes(result, msgpack_value::value_type::binary, read_be<uint32_t>()); break;
+					case 0xca:
+					{
+						auto v = read_be<uint32_t>();
+						float f;
+						std::memcpy(&f, &v, sizeof(f));
+						result.type = msgpack_value::value_type::real;
+						result.d = f;
+						break;
+					}
+					case 0xcb:
+					{
+						auto v = read_be<uint64_t>();
+						std::memcpy(&result.d, &v, sizeof(result.d));
+						result.type = msgpack_value::value_type::real;
+						break;
+					}
+					case 0xcc: set_int(result, read_be<uint8_t>()); break;
+					case 0xcd: set_int(result, read_be<uint16_t>()); break;
+					case 0xce: set_int(result, read_be<uint32_t>()); break;
+					case 0xcf: set_int(result, static_cast<int64_t>(read_be<uint64_t>())); break;
+					case 0xd0: set_int(result, static_cast<int8_t>(read_be<uint8_t>())); break;
+					case 0xd1: set_int(result, static_cast<int16_t>(read_be<uint16_t>())); break;
+					case 0xd2: set_int(result, static_cast<int32_t>(read_be<uint32_t>())); break;
+					case 0xd3: set_int(result, static_cast<int64_t>(read_be<uint64_t>())); break;
+					case 0xd9: read_bytes(result, msgpack_value::value_type::string, read_be<uint8_t>()); break;
+					case 0xda: read_bytes(result, msgpack_value::value_type::string, read_be<uint16_t>()); break;
+					case 0xdb: read_bytes(result, msgpack_value::value_type::string, read_be<uint32_t>()); break;
+					case 0xdc: read_items(result, msgpack_value::value_type::array, read_be<uint16_t>()); break;
+					case 0xdd: read_items(result, msgpack_value::value_type::array, read_be<uint32_t>()); break;
+					case 0xde: read_items(result, msgpack_value::value_type::map, 2 * size_t(read_be<uint16_t>())); break;
+					case 0xdf: read_items(result, msgpack_value::value_type::map, 2 * size_t(read_be<uint32_t>())); break;
+					default:
+						throw std::runtime_error("BinaryCIF: unsupported MessagePack type");
+				}
+			}
+
+			return result;
+		}
+
+	  private:
+		uint8_t next()
+		{
+			if (m_ptr >= m_end)
+				throw std::runtime_error("BinaryCIF: unexpected end of data");
+			return *m_ptr++;
+		}
+
+		template <typename T>
+		T read_be()
+		{
+			T result = 0;
+			for (size_t i = 0; i < sizeof(T); ++i)
+				result = static_cast<T>((result << 8) | next());
+			return result;
+		}
+
+		void set_int(msgpack_value &v, int64_t i)
+		{
+			v.type = msgpack_value::value_type::integer;
+			v.i = i;
+		}
+
+		void read_bytes(msgpack_value &v, msgpack_value::value_type type, size_t length)
+		{
+			if (size_t(m_end - m_ptr) < length)
+				throw std::runtime_error("BinaryCIF: unexpected end of data");
+
+			v.type = type;
+			v.s = { reinterpret_cast<const char *>(m_ptr), length };
+			m_ptr += length;
+		}
+
+		void read_items(msgpack_value &v, msgpack_value::value_type type, size_t count)
+		{
+			if (size_t(m_end - m_ptr) < count)
+				throw std::runtime_error("BinaryCIF: unexpected end of data");
+
+			// BinaryCIF data is nested only a few levels deep, this
+			// guards the stack against crafted data
+			if (m_depth >= kMaxDepth)
+				throw std::runtime_error("BinaryCIF: data is nested too deeply");
+
+			++m_depth;
+
+			v.type = type;
+			v.items.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+				v.items.emplace_back(read());
+
+			--m_depth;
+		}
+
+		static constexpr size_t kMaxDepth = 64;
+
+		const uint8_t *m_ptr, *m_end;
+		size_t m_depth = 0;
+	};
+
+	class msgpack_writer
+	{
+	  public:
+		msgpack_writer(std::string &buffer)
+			: m_buffer(buffer)
+		{
+		}
+
+		void nil()
+		{
+			m_buffer += '\xc0';
+		}
+
+		void boolean(bool b)
+		{
+			m_buffer += b ? '\xc3' : '\xc2';
+		}
+
+		void integer(int64_t v)
+		{
+			if (v >= 0 and v <= 0x7f)
+				m_buffer += static_cast<char>(v);
+			else if (v < 0 and v >= -32)
+				m_buffer += static_cast<char>(static_cast<int8_t>(v));
+			else if (v >= 0)
+			{
+				if (v <= 0xff)
+					write_be<uint8_t>(0xcc, v);
+				else if (v <= 0xffff)
+					write_be<uint16_t>(0xcd, v);
+				else if (v <= 0xffffffffLL)
+					write_be<uint32_t>(0xce, v);
+				else
+					write_be<uint64_t>(0xcf, v);
+			}
+			else
+			{
+				if (v >= INT8_MIN)
+					write_be<uint8_t>(0xd0, static_cast<uint8_t>(v));
+				else if (v >= INT16_MIN)
+					write_be<uint16_t>(0xd1, static_cast<uint16_t>(v));
+				else if (v >= INT32_MIN)
+					write_be<uint32_t>(0xd2, static_cast<uint32_t>(v));
+				else
+					write_be<uint64_t>(0xd3, static_cast<uint64_t>(v));
+			}
+		}
+
+		void real(double d)
+		{
+			uint64_t v;
+			std::memcpy(&v, &d, sizeof(v));
+			write_be<uint64_t>(0xcb, v);
+		}
+
+		void string(std::string_view s)
+		{
+			if (s.length() <= 31)
+				m_buffer += static_cast<char>(0xa0 | s.length());
+			else if (s.length() <= 0xff)
+				write_be<uint8_t>(0xd9, s.length());
+			else if (s.length() <= 0xffff)
+				write_be<uint16_t>(0xda, s.length());
+			else
+				write_be<uint32_t>(0xdb, s.length());
+			m_buffer += s;
+		}
+
+		void binary(std::string_view s)
+		{
+			if (s.length() <= 0xff)
+				write_be<uint8_t>(0xc4, s.length());
+			else if (s.length() <= 0xffff)
+				write_be<uint16_t>(0xc5, s.length());
+			else
+				write_be<uint32_t>(0xc6, s.length());
+			m_buffer += s;
+		}
+
+		void array(size_t count)
+		{
+			if (count <= 15)
+				m_buffer += static_cast<char>(0x90 | count);
+			else if (count <= 0xffff)
+				write_be<uint16_t>(0xdc, count);
+			else
+				write_be<uint32_t>(0xdd, count);
+		}
+
+		void map(size_t count)
+		{
+			if (count <= 15)
+				m_buffer += static_cast<char>(0x80 | count);
+			else if (count <= 0xffff)
+				write_be<uint16_t>(0xde, count);
+			else
+				write_be<uint32_t>(0xdf, count);
+		}
+
+		/// Append already encoded MessagePack data
+		void raw(std::string_view s)
+		{
+			m_buffer += s;
+		}
+
+	  private:
+		template <typename T>
+		void write_be(uint8_t type, uint64_t v)
+		{
+			m_buffer += static_cast<char>(type);
+			for (size_t i = sizeof(T); i > 0; --i)
+				m_buffer += static_cast<char>((v >> (8 * (i - 1))) & 0xff);
+		}
+
+		std::string &m_buffer;
+	};
+
+} // namespace
+
+// --------------------------------------------------------------------
+// BinaryCIF encodings
+
+namespace
+{
+	enum class data_type : int
+	{
+		int8 = 1,
+		int16 = 2,
+		int32 = 3,
+		uint8 = 4,
+		uint16 = 5,
+		uint32 = 6,
+		float32 = 32,
+		float64 = 33
+	};
+
+	/// The mask values for items that are not present
+	enum mask_type : uint8_t
+	{
+		present = 0,
+		not_specified = 1, // '.'
+		unknown = 2        // '?'
+	};
+
+	/// The result of decoding the data of a column, the data is
+	/// decoded in place, the type changes while decoding
+	struct decoded_data
+	{
+		enum class kind
+		{
+			bytes,
+			integers,
+			reals,
+			strings
+		} type = kind::bytes;
+
+		std::string_view bytes;
+		std::vector<int64_t> ints;
+		std::vector<double> reals;
+		std::vector<std::string_view> strings; // string table, indexed by ints
+
+		int decimals = -1;   // number of decimals for fixed-point reals, -1 for shortest representation
+		bool single = false; // reals have float32 precision
+
+		size_t size() const
+		{
+			return type == kind::reals ? reals.size() : ints.size();
+		}
+	};
+
+	template <typename T>
+	void decode_byte_array(std::string_view bytes, std::vector<int64_t> &ints)
+	{
+		if (bytes.length() % sizeof(T) != 0)
+			throw std::runtime_error("BinaryCIF: invalid length for ByteArray");
+
+		size_t n = bytes.length() / sizeof(T);
+		ints.resize(n);
+
+		auto p = reinterpret_cast<const uint8_t *>(bytes.data());
+		for (size_t i = 0; i < n; ++i, p += sizeof(T))
+		{
+			std::make_unsigned_t<T> v = 0;
+			for (size_t j = sizeof(T); j > 0; --j)
+				v = static_cast<std::make_unsigned_t<T>>((v << 8) | p[j - 1]);
+			ints[i] = static_cast<T>(v);
+		}
+	}
+
+	template <typename F, typename I>
+	void decode_float_array(std::string_view bytes, std::vector<double> &reals)
+	{
+		if (bytes.length() % sizeof(F) != 0)
+			throw std::runtime_error("BinaryCIF: invalid length for ByteArray");
+
+		size_t n = bytes.length() / sizeof(F);
+		reals.resize(n);
+
+		auto p = reinterpret_cast<const uint8_t *>(bytes.data());
+		for (size_t i = 0; i < n; ++i, p += sizeof(F))
+		{
+			I v = 0;
+			for (size_t j = sizeof(F); j > 0; --j)
+				v = (v << 8) | p[j - 1];
+
+			F f;
+			std::memcpy(&f, &v, sizeof(f));
+			reals[i] = f;
+		}
+	}
+
+	void expect(decoded_data &data, decoded_data::kind type, std::string_view encoding)
+	{
+		if (data.type != type)
+			throw std::runtime_error("BinaryCIF: invalid input for " + std::string{ encoding } + " encoding");
+	}
+
+	// Return the srcSize of @a encoding, which may not exceed @a max_count
+	size_t get_src_size(const msgpack_value &encoding, size_t max_count)
+	{
+		auto n = encoding["srcSize"].as_int();
+		if (n < 0 or static_cast<uint64_t>(n) > max_count)
+			throw std::runtime_error("BinaryCIF: invalid srcSize");
+		return static_cast<size_t>(n);
+	}
+
+	// Decode @a bytes using @a encodings, the result may contain
+	// at most @a max_count values, the row count of the category
+	decoded_data decode(std::string_view bytes, const msgpack_value &encodings, size_t max_count)
+	{
+		decoded_data result;
+		result.bytes = bytes;
+
+		for (auto e = encodings.items.rbegin(); e != encodings.items.rend(); ++e)
+		{
+			auto &encoding = *e;
+			auto kind = encoding["kind"].as_string();
+
+			if (kind == "ByteArray")
+			{
+				expect(result, decoded_data::kind::bytes, kind);
+
+				switch (static_cast<data_type>(encoding["type"].as_int()))
+				{
+					case data_type::int8: decode_byte_array<int8_t>(result.bytes, result.ints); break;
+					case data_type::int16: decode_byte_array<int16_t>(result.bytes, result.ints); break;
+					case data_type::int32: decode_byte_array<int32_t>(result.bytes, result.ints); break;
+					case data_type::uint8: decode_byte_array<uint8_t>(result.bytes, result.ints); break;
+					case data_type::uint16: decode_byte_array<uint16_t>(result.bytes, result.ints); break;
+					case data_type::uint32: decode_byte_array<uint32_t>(result.bytes, result.ints); break;
+					case data_type::float32:
+						decode_float_array<float, uint32_t>(result.bytes, result.reals);
+						result.single = true;
+						break;
+					case data_type::float64:
+						decode_float_array<double, uint64_t>(result.bytes, result.reals);
+						break;
+					default:
+						throw std::runtime_error("BinaryCIF: unsupported ByteArray type");
+				}
+
+				result.type = static_cast<data_type>(encoding["type"].as_int()) >= data_type::float32
+				                  ? decoded_data::kind::reals
+				                  : decoded_data::kind::integers;
+			}
+			else if (kind == "FixedPoint")
+			{
+				expect(result, decoded_data::kind::integers, kind);
+
+				double factor = encoding["factor"].as_double();
+				result.reals.resize(result.ints.size());
+				for (size_t i = 0; i < result.ints.size(); ++i)
+					result.reals[i] = result.ints[i] / factor;
+
+				double decimals = std::log10(factor);
+				result.decimals = std::abs(decimals - std::round(decimals)) < 1e-9 and decimals >= 0 ? static_cast<int>(std::round(decimals)) : -1;
+				result.single = encoding["srcType"].as_int() == static_cast<int>(data_type::float32);
+				result.type = decoded_data::kind::reals;
+				result.ints.clear();
+			}
+			else if (kind == "IntervalQuantization")
+			{
+				expect(result, decoded_data::kind::integers, kind);
+
+				double min = encoding["min"].as_double();
+				double max = encoding["max"].as_double();
+				auto steps = encoding["numSteps"].as_int();
+				double delta = steps > 1 ? (max - min) / (steps - 1) : 0;
+
+				result.reals.resize(result.ints.size());
+				for (size_t i = 0; i < result.ints.size(); ++i)
+					result.reals[i] = min + delta * result.ints[i];
+
+				result.single = encoding["srcType"].as_int() == static_cast<int>(data_type::float32);
+				result.type = decoded_data::kind::reals;
+				result.ints.clear();
+			}
+			else if (kind == "RunLength")
+			{
+				expect(result, decoded_data::kind::integers, kind);
+
+				std::vector<int64_t> ints;
+				ints.reserve(get_src_size(encoding, max_count));
+
+				for (size_t i = 0; i + 1 < result.ints.size(); i += 2)
+				{
+					auto count = result.ints[i + 1];
+					if (count < 0 or static_cast<uint64_t>(count) > max_count - ints.size())
+						throw std::runtime_error("BinaryCIF: invalid run length");
+					ints.insert(ints.end(), count, result.ints[i]);
+				}
+
+				std::swap(ints, result.ints);
+			}
+			else if (kind == "Delta")
+			{
+				expect(result, decoded_data::kind::integers, kind);
+
+				if (not result.ints.empty())
+				{
+					result.ints[0] += encoding["origin"].as_int();
+					for (size_t i = 1; i < result.ints.size(); ++i)
+						result.ints[i] += result.ints[i - 1];
+				}
+			}
+			else if (kind == "IntegerPacking")
+			{
+				expect(result, decoded_data::kind::integers, kind);
+
+				auto byte_count = encoding["byteCount"].as_int();
+				bool is_unsigned = encoding["isUnsigned"].as_int() != 0;
+
+				int64_t upper, lower;
+				if (is_unsigned)
+				{
+					upper = byte_count == 1 ? 0xff : 0xffff;
+					lower = -1;
+				}
+				else
+				{
+					upper = byte_count == 1 ? 0x7f : 0x7fff;
+					lower = -upper - 1;
+				}
+
+				std::vector<int64_t> ints;
+				ints.reserve(std::min(get_src_size(encoding, max_count), result.ints.size()));
+
+				for (size_t i = 0; i < result.ints.size(); ++i)
+				{
+					int64_t v = 0, t = result.ints[i];
+					while ((t == upper or t == lower) and i + 1 < result.ints.size())
+					{
+						v += t;
+						t = result.ints[++i];
+					}
+					ints.push_back(v + t);
+				}
+
+				std::swap(ints, result.ints);
+			}
+			else if (kind == "StringArray")
+			{
+				expect(result, decoded_data::kind::bytes, kind);
+
+				auto string_data = encoding["stringData"].as_string();
+				auto offsets = decode(encoding["offsets"].as_string(), encoding["offsetEncoding"], max_count + 1);
+				auto indices = decode(result.bytes, encoding["dataEncoding"], max_count);
+
+				expect(offsets, decoded_data::kind::integers, kind);
+				expect(indices, decoded_data::kind::integers, kind);
+
+				for (size_t i = 0; i + 1 < offsets.ints.size(); ++i)
+				{
+					auto b = offsets.ints[i], e = offsets.ints[i + 1];
+					if (b < 0 or b > e or size_t(e) > string_data.length())
+						throw std::runtime_error("BinaryCIF: invalid offset in StringArray");
+					result.strings.emplace_back(string_data.substr(b, e - b));
+				}
+
+				for (auto ix : indices.ints)
+				{
+					if (ix >= static_cast<int64_t>(result.strings.size()))
+						throw std::runtime_error("BinaryCIF: invalid index in StringArray");
+				}
+
+				result.ints = std::move(indices.ints);
+				result.type = decoded_data::kind::strings;
+			}
+			else
+				throw std::runtime_error("BinaryCIF: unsupported encoding " + std::string{ kind });
+		}
+
+		return result;
+	}
+
+	/// Return the text for value @a i in @a data, numbers are formatted in @a buffer
+	std::string_view text_for(const decoded_data &data, size_t i, char (&buffer)[64])
+	{
+		using namespace std;
+		using namespace cif;
+
+		switch (data.type)
+		{
+			case decoded_data::kind::integers:
+			{
+				auto r = std::to_chars(buffer, buffer + sizeof(buffer), data.ints[i]);
+				return { buffer, static_cast<size_t>(r.ptr - buffer) };
+			}
+
+			case decoded_data::kind::reals:
+			{
+				to_chars_result r;
+				if (data.decimals >= 0)
+				{
+					const double &v = data.reals[i];
+					r = to_chars(buffer, buffer + sizeof(buffer), v, chars_format::fixed, data.decimals);
+				}
+				else if (data.single)
+				{
+					const float v = static_cast<float>(data.reals[i]);
+					r = to_chars(buffer, buffer + sizeof(buffer), v, chars_format::general);
+				}
+				else
+				{
+					const double &v = data.reals[i];
+					r = to_chars(buffer, buffer + sizeof(buffer), v, chars_format::general);
+				}
+
+				if ((bool)r.ec)
+					throw std::runtime_error("Could not format number");
+
+				return { buffer, static_cast<size_t>(r.ptr - buffer) };
+			}
+
+			case decoded_data::kind::strings:
+				return data.ints[i] < 0 ? std::string_view{} : data.strings[data.ints[i]];
+
+			default:
+				throw std::runtime_error("BinaryCIF: column data was not decoded");
+		}
+	}
+
+	// --------------------------------------------------------------------
+
+	/// Encoded data, the binary data and a list of already
+	/// serialised encodings, in the order in which they were applied
+	struct encoded_data
+	{
+		std::string data;
+		std::vector<std::string> encodings;
+	};
+
+	template <typename T>
+	void append_le(std::string &s, T v)
+	{
+		auto u = static_cast<std::make_unsigned_t<T>>(v);
+		for (size_t i = 0; i < sizeof(T); ++i)
+			s += static_cast<char>((u >> (8 * i)) & 0xff);
+	}
+
+	std::string byte_array_encoding(data_type type)
+	{
+		std::string result;
+		msgpack_writer w(result);
+		w.map(2);
+		w.string("kind");
+		w.string("ByteArray");
+		w.string("type");
+		w.integer(static_cast<int>(type));
+		return result;
+	}
+
+	std::vector<int64_t> delta_encode(const std::vector<int64_t> &ints)
+	{
+		std::vector<int64_t> result(ints.size());
+		for (size_t i = 1; i < ints.size(); ++i)
+			result[i] = ints[i] - ints[i - 1];
+		return result;
+	}
+
+	std::vector<int64_t> run_length_encode(const std::vector<int64_t> &ints)
+	{
+		std::vector<int64_t> result;
+
+		for (size_t i = 0; i < ints.size();)
+		{
+			size_t j = i + 1;
+			while (j < ints.size() and ints[j] == ints[i])
+				++j;
+
+			result.push_back(ints[i]);
+			result.push_back(j - i);
+
+			i = j;
+		}
+
+		return result;
+	}
+
+	/// The number of values after packing @a ints into @a byte_count bytes
+	size_t packed_size(const std::vector<int64_t> &ints, int byte_count, bool is_unsigned)
+	{
+		int64_t upper = is_unsigned ? (byte_count == 1 ? 0xff : 0xffff) : (byte_count == 1 ? 0x7f : 0x7fff);
+		int64_t lower = -upper - 1;
+
+		size_t result = 0;
+		for (auto v : ints)
+		{
+			if (v < upper and v > lower)
+				++result;
+			else
+				result += v >= 0 ? v / upper + 1 : v / lower + 1;
+		}
+		return result;
+	}
+
+	/// The number of bytes pack_integers needs to store @a ints
+	size_t packed_bytes(const std::vector<int64_t> &ints)
+	{
+		bool is_unsigned = std::all_of(ints.begin(), ints.end(), [](int64_t v) { return v >= 0; });
+		return std::min({ packed_size(ints, 1, is_unsigned), packed_size(ints, 2, is_unsigned) * 2, ints.size() * 4 });
+	}
+
+	/// Encode @a ints using IntegerPacking in one or two bytes, followed by
+	/// a ByteArray, or as a plain ByteArray of int32 if that is smaller
+	void pack_integers(const std::vector<int64_t> &ints, encoded_data &result)
+	{
+		bool is_unsigned = std::all_of(ints.begin(), ints.end(), [](int64_t v) { return v >= 0; });
+
+		size_t size_1 = packed_size(ints, 1, is_unsigned);
+		size_t size_2 = packed_size(ints, 2, is_unsigned) * 2;
+
+		result.data.reserve(std::min({ size_1, size_2, ints.size() * 4 }));
+
+		if (size_1 >= ints.size() * 4 and size_2 >= ints.size() * 4)
+		{
+			for (auto v : ints)
+				append_le<int32_t>(result.data, v);
+			result.encodings.emplace_back(byte_array_encoding(data_type::int32));
+			return;
+		}
+
+		int byte_count = size_1 <= size_2 ? 1 : 2;
+
+		int64_t upper = is_unsigned ? (byte_count == 1 ? 0xff : 0xffff) : (byte_count == 1 ? 0x7f : 0x7fff);
+		int64_t lower = -upper - 1;
+
+		for (auto v : ints)
+		{
+			if (v >= 0)
+			{
+				for (; v >= upper; v -= upper)
+					byte_count == 1 ? append_le<int8_t>(result.data, upper) : append_le<int16_t>(result.data, upper);
+			}
+			else
+			{
+				for (; v <= lower; v -= lower)
+					byte_count == 1 ? append_le<int8_t>(result.data, lower) : append_le<int16_t>(result.data, lower);
+			}
+
+			byte_count == 1 ? append_le<int8_t>(result.data, v) : append_le<int16_t>(result.data, v);
+		}
+
+		std::string e;
+		msgpack_writer w(e);
+		w.map(4);
+		w.string("kind");
+		w.string("IntegerPacking");
+		w.string("byteCount");
+		w.integer(byte_count);
+		w.string("isUnsigned");
+		w.boolean(is_unsigned);
+		w.string("srcSize");
+		w.integer(ints.size());
+		result.encodings.emplace_back(std::move(e));
+
+		if (byte_count == 1)
+			result.encodings.emplace_back(byte_array_encoding(is_unsigned ? data_type::uint8 : data_type::int8));
+		else
+			result.encodings.emplace_back(byte_array_encoding(is_unsigned ? data_type::uint16 : data_type::int16));
+	}
+
+	/// Encode the int32 values in @a ints, select the smallest of using
+	/// Delta and/or RunLength encoding before packing the integers.
+	encoded_data encode_integers(const std::vector<int64_t> &ints)
+	{
+		bool delta_fits = true;
+		for (size_t i = 1; delta_fits and i < ints.size(); ++i)
+		{
+			auto d = ints[i] - ints[i - 1];
+			delta_fits = d >= INT32_MIN and d <= INT32_MAX;
+		}
+
+		// Compare the packed sizes of the candidates first, only the best one is packed
+		std::vector<int64_t> best = ints;
+		std::vector<std::string> best_encodings;
+		size_t best_size = packed_bytes(ints);
+
+		auto try_encoding = [&](std::vector<int64_t> &&encoded, std::vector<std::string> encodings)
+		{
+			auto size = packed_bytes(encoded);
+			if (size < best_size)
+			{
+				best = std::move(encoded);
+				best_encodings = std::move(encodings);
+				best_size = size;
+			}
+		};
+
+		auto run_length = [](size_t size)
+		{
+			std::string e;
+			msgpack_writer w(e);
+			w.map(3);
+			w.string("kind");
+			w.string("RunLength");
+			w.string("srcType");
+			w.integer(static_cast<int>(data_type::int32));
+			w.string("srcSize");
+			w.integer(size);
+			return e;
+		};
+
+		try_encoding(run_length_encode(ints), { run_length(ints.size()) });
+
+		if (delta_fits and not ints.empty())
+		{
+			std::string delta;
+			msgpack_writer w(delta);
+			w.map(3);
+			w.string("kind");
+			w.string("Delta");
+			w.string("origin");
+			w.integer(ints.front());
+			w.string("srcType");
+			w.integer(static_cast<int>(data_type::int32));
+
+			auto deltas = delta_encode(ints);
+			auto delta_runs = run_length_encode(deltas);
+
+			try_encoding(std::move(deltas), { delta });
+			try_encoding(std::move(delta_runs), { delta, run_length(ints.size()) });
+		}
+
+		encoded_data result{ {}, std::move(best_encodings) };
+		pack_integers(best, result);
+
+		return result;
+	}
+
+	/// Encode the strings in @a texts using StringArray encoding,
+	/// values that are masked are stored as index -1
+	encoded_data encode_strings(const std::vector<std::string_view> &texts, const std::vector<uint8_t> &mask)
+	{
+		std::unordered_map<std::string_view, int64_t> index;
+		std::string string_data;
+		std::vector<int64_t> offsets{ 0 };
+		std::vector<int64_t> indices(texts.size(), -1);
+
+		for (size_t i = 0; i < texts.size(); ++i)
+		{
+			if (mask[i] != mask_type::present)
+				continue;
+
+			// runs of the same value are common
+			if (i > 0 and indices[i - 1] >= 0 and texts[i] == texts[i - 1])
+			{
+				indices[i] = indices[i - 1];
+				continue;
+			}
+
+			auto [ix, inserted] = index.emplace(texts[i], static_cast<int64_t>(offsets.size() - 1));
+			if (inserted)
+			{
+				string_data += texts[i];
+				offsets.push_back(string_data.length());
+			}
+
+			indices[i] = ix->second;
+		}
+
+		auto encoded_offsets = encode_integers(offsets);
+		auto result = encode_integers(indices);
+
+		std::string e;
+		msgpack_writer w(e);
+		w.map(5);
+		w.string("kind");
+		w.string("StringArray");
+		w.string("dataEncoding");
+		w.array(result.encodings.size());
+		for (auto &de : result.encodings)
+			w.raw(de);
+		w.string("stringData");
+		w.string(string_data);
+		w.string("offsetEncoding");
+		w.array(encoded_offsets.encodings.size());
+		for (auto &oe : encoded_offsets.encodings)
+			w.raw(oe);
+		w.string("offsets");
+		w.binary(encoded_offsets.data);
+
+		result.encodings = { e };
+
+		return result;
+	}
+
+	// --------------------------------------------------------------------
+
+	/// Return true if @a digits is a sequence of digits without superfluous
+	/// leading zeros, as std::to_chars would write it
+	bool is_canonical_digits(std::string_view digits)
+	{
+		if (digits.empty() or (digits.length() > 1 and digits.front() == '0'))
+			return false;
+
+		return std::all_of(digits.begin(), digits.end(), [](char ch) { return ch >= '0' and ch <= '9'; });
+	}
+
+	/// Return true if @a text is an int32 written exactly as std::to_chars
+	/// would write it, the value is stored in @a v
+	bool parse_integer(std::string_view text, int64_t &v)
+	{
+		if (text.empty() or text.length() > 11)
+			return false;
+
+		auto digits = text.front() == '-' ? text.substr(1) : text;
+		if (not is_canonical_digits(digits) or (digits == "0" and digits.length() != text.length()))
+			return false;
+
+		int32_t i;
+		auto r = std::from_chars(text.data(), text.data() + text.length(), i);
+		if ((bool)r.ec)
+			return false;
+
+		v = i;
+		return true;
+	}
+
+	/// Return true if @a text is a number with @a decimals decimals written
+	/// exactly as formatting v / 10^decimals in fixed notation would write it.
+	/// If @a decimals is -1 it is set to the number of decimals in @a text.
+	/// The value multiplied by 10^decimals is stored in @a v
+	bool parse_fixed_point(std::string_view text, int &decimals, int64_t &v)
+	{
+		auto dot = text.find('.');
+		if (dot == std::string_view::npos or text.length() > 12)
+			return false;
+
+		int d = static_cast<int>(text.length() - dot - 1);
+		if (d == 0 or (decimals != -1 and decimals != d))
+			return false;
+
+		bool negative = text.front() == '-';
+		auto whole = text.substr(negative ? 1 : 0, dot - (negative ? 1 : 0));
+		auto fraction = text.substr(dot + 1);
+
+		if (not is_canonical_digits(whole) or not std::all_of(fraction.begin(), fraction.end(), [](char ch) { return ch >= '0' and ch <= '9'; }))
+			return false;
+
+		char digits[16];
+		size_t n = 0;
+		if (negative)
+			digits[n++] = '-';
+		for (auto part : { whole, fraction })
+		{
+			for (auto ch : part)
+				digits[n++] = ch;
+		}
+
+		int32_t i;
+		auto r = std::from_chars(digits, digits + n, i);
+		if ((bool)r.ec or (negative and i == 0)) // -0.0 would be written as 0.0
+			return false;
+
+		decimals = d;
+		v = i;
+		return true;
+	}
+
+	void write_data(msgpack_writer &w, const encoded_data &data)
+	{
+		w.map(2);
+		w.string("data");
+		w.binary(data.data);
+		w.string("encoding");
+		w.array(data.encodings.size());
+		for (auto &e : data.encodings)
+			w.raw(e);
+	}
+
+	void write_column(msgpack_writer &w, std::string_view name, const std::vector<std::string_view> &texts)
+	{
+		const size_t n = texts.size();
+
+		std::vector<uint8_t> mask(n, mask_type::present);
+		bool has_mask = false;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (texts[i].empty() or texts[i] == "?")
+				mask[i] = mask_type::unknown;
+			else if (texts[i] == ".")
+				mask[i] = mask_type::not_specified;
+			else
+				continue;
+
+			has_mask = true;
+		}
+
+		// See if the values are all integers or all fixed-point numbers
+
+		std::vector<int64_t> ints(n, 0);
+		bool is_int = true, is_fixed = true;
+		int decimals = -1;
+
+		for (size_t i = 0; i < n and is_int; ++i)
+		{
+			if (mask[i] == mask_type::present)
+				is_int = parse_integer(texts[i], ints[i]);
+		}
+
+		if (not is_int)
+		{
+			for (size_t i = 0; i < n and is_fixed; ++i)
+			{
+				if (mask[i] == mask_type::present)
+					is_fixed = parse_fixed_point(texts[i], decimals, ints[i]);
+				else
+					ints[i] = 0;
+			}
+		}
+
+		encoded_data data;
+		if (is_int)
+			data = encode_integers(ints);
+		else if (is_fixed and decimals > 0)
+		{
+			data = encode_integers(ints);
+
+			std::string e;
+			msgpack_writer fw(e);
+			fw.map(3);
+			fw.string("kind");
+			fw.string("FixedPoint");
+			fw.string("factor");
+			fw.real(std::pow(10.0, decimals));
+			fw.string("srcType");
+			fw.integer(static_cast<int>(data_type::float64));
+
+			data.encodings.insert(data.encodings.begin(), e);
+		}
+		else
+			data = encode_strings(texts, mask);
+
+		w.map(3);
+		w.string("name");
+		w.string(name);
+		w.string("data");
+		write_data(w, data);
+		w.string("mask");
+		if (has_mask)
+			write_data(w, encode_integers({ mask.begin(), mask.end() }));
+		else
+			w.nil();
+	}
+
+	void write_category(msgpack_writer &w, const category &cat)
+	{
+		const size_t n = cat.get_items().size();
+		const size_t row_count = cat.size();
+
+		w.map(3);
+		w.string("name");
+		std::string name = "_";
+		name += cat.name();
+		w.string(name);
+		w.string("columns");
+		w.array(n);
+
+		std::vector<std::string_view> texts(row_count);
+
+		for (uint16_t ix = 0; ix < n; ++ix)
+		{
+			size_t i = 0;
+			for (auto r : cat)
+				texts[i++] = r[ix].text();
+
+			write_column(w, cat.get_item_name(ix), texts);
+		}
+
+		w.string("rowCount");
+		w.integer(row_count);
+	}
+
+} // namespace
+
+// --------------------------------------------------------------------
+
+bool is_bcif(std::istream &is)
+{
+	auto ch = is.peek();
+	return (ch >= 0x80 and ch <= 0x8f) or ch == 0xde or ch == 0xdf;
+}
+
+void read(std::istream &is, file &f)
+{
+	std::string buffer;
+
+	char chunk[65536];
+	while (is.read(chunk, sizeof(chunk)) or is.gcount() > 0)
+		buffer.append(chunk, is.gcount());
+
+	msgpack_reader reader(buffer.data(), buffer.length());
+	auto root = reader.read();
+
+	char number[64];
+
+	for (auto &block : root["dataBlocks"].items)
+	{
+		auto &&[dbi, ignore] = f.emplace(block["header"].as_string());
+		auto &db = *dbi;
+
+		for (auto &c : block["categories"].items)
+		{
+			auto name = c["name"].as_string();
+			if (not name.empty() and name.front() == '_')
+				name.remove_prefix(1);
+
+			auto &&[ci, ignore] = db.emplace(name);
+			auto &cat = *ci;
+
+			auto rc = c["rowCount"].as_int();
+			if (rc < 0)
+				throw std::runtime_error("BinaryCIF: invalid row count for " + cat.name());
+			size_t row_count = static_cast<size_t>(rc);
+
+			std::vector<uint16_t> ix;
+			std::vector<decoded_data> data;
+			std::vector<std::vector<int64_t>> masks;
+
+			for (auto &col : c["columns"].items)
+			{
+				ix.push_back(cat.add_item(col["name"].as_string()));
+
+				auto &d = col["data"];
+				data.emplace_back(decode(d["data"].as_string(), d["encoding"], row_count));
+				if (data.back().size() != row_count)
+					throw std::runtime_error("BinaryCIF: the number of values for " + cat.name() + '.' + std::string{ col["name"].as_string() } + " does not match the row count");
+
+				auto &m = col["mask"];
+				if (m.is_nil())
+					masks.emplace_back();
+				else
+				{
+					auto mask = decode(m["data"].as_string(), m["encoding"], row_count);
+					if (mask.type != decoded_data::kind::integers or mask.ints.size() != row_count)
+						throw std::runtime_error("BinaryCIF: invalid mask for " + cat.name() + '.' + std::string{ col["name"].as_string() });
+					masks.emplace_back(std::move(mask.ints));
+				}
+			}
+
+			for (size_t i = 0; i < row_count; ++i)
+			{
+				cat.emplace({});
+				auto r = cat.back();
+
+				// assign the last item first, the row is then allocated only once
+				for (size_t k = ix.size(); k-- > 0;)
+				{
+					std::string_view value;
+
+					if (not masks[k].empty() and masks[k][i] != mask_type::present)
+						value = masks[k][i] == mask_type::not_specified ? "." : "?";
+					else
+						value = text_for(data[k], i, number);
+
+					r.assign(ix[k], value, false, false);
+				}
+			}
+		}
+	}
+}
+
+void write(std::ostream &os, const file &f)
+{
+	std::string buffer;
+	msgpack_writer w(buffer);
+
+	w.map(3);
+	w.string("version");
+	w.string("0.3.0");
+	w.string("encoder");
+	w.string("libcifpp " + get_version_nr());
+	w.string("dataBlocks");
+	w.array(f.size());
+
+	for (auto &db : f)
+	{
+		w.map(2);
+		w.string("header");
+		w.string(db.name());
+		w.string("categories");
+
+		size_t n = std::count_if(db.begin(), db.end(), [](const category &cat) { return not cat.empty(); });
+		w.array(n);
+
+		for (auto &cat : db)
+		{
+			if (not cat.empty())
+				write_category(w, cat);
+		}
+	}
+
+	os.write(buffer.data(), buffer.length());
+}
+
+} // namespace cif::bcif
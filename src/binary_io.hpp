@@ -0,0 +1,173 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/// \file binary_io.hpp
+/// Internal support for the binary formats written by libcifpp, the
+/// validator cache and file snapshots. Integers are stored in native byte
+/// order, the headers of these formats contain a marker to detect files
+/// written on a machine with another byte order. Strings are stored as a
+/// length followed by the characters. The data can be read in place,
+/// without copying.
+
+namespace cif::detail
+{
+
+/// The marker used to detect data written with another byte order
+const uint32_t kBinaryByteOrder = 0x01020304;
+
+/// FNV-1a checksum over @a data, fast and good enough to detect changed data
+inline uint64_t checksum(std::string_view data)
+{
+	uint64_t result = 0xcbf29ce484222325ULL;
+
+	for (unsigned char ch : data)
+	{
+		result ^= ch;
+		result *= 0x100000001b3ULL;
+	}
+
+	return result;
+}
+
+class binary_writer
+{
+  public:
+	binary_writer(std::ostream &os)
+		: m_os(os)
+	{
+	}
+
+	template <typename T>
+		requires std::is_integral_v<T>
+	void write(T v)
+	{
+		m_os.write(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+
+	void write(std::string_view s)
+	{
+		write(static_cast<uint32_t>(s.length()));
+		m_os.write(s.data(), s.length());
+	}
+
+	template <typename C>
+	void write_strings(const C &c)
+	{
+		write(static_cast<uint32_t>(c.size()));
+		for (auto &s : c)
+			write(std::string_view{ s });
+	}
+
+  private:
+	std::ostream &m_os;
+};
+
+class binary_reader
+{
+  public:
+	binary_reader(std::string_view data)
+		: m_data(data)
+	{
+	}
+
+	template <typename T>
+		requires std::is_integral_v<T>
+	T read()
+	{
+		T result;
+		std::memcpy(&result, get(sizeof(T)), sizeof(T));
+		return result;
+	}
+
+	std::string_view read_string()
+	{
+		auto n = read<uint32_t>();
+		return { get(n), n };
+	}
+
+	/// Return the next @a n bytes, without copying
+	std::string_view read_bytes(size_t n)
+	{
+		return { get(n), n };
+	}
+
+	template <typename C>
+	C read_strings()
+	{
+		C result;
+		for (auto n = read<uint32_t>(); n > 0; --n)
+			result.insert(result.end(), std::string{ read_string() });
+		return result;
+	}
+
+	bool at_end() const { return m_offset == m_data.length(); }
+
+  private:
+	const char *get(size_t n)
+	{
+		if (m_offset + n > m_data.length())
+			throw std::runtime_error("Binary data is truncated");
+
+		auto result = m_data.data() + m_offset;
+		m_offset += n;
+		return result;
+	}
+
+	std::string_view m_data;
+	size_t m_offset = 0;
+};
+
+/// A read-only view on the contents of a file. The file is memory mapped
+/// when the platform supports it, otherwise it is read into memory.
+class mapped_file
+{
+  public:
+	mapped_file(const std::filesystem::path &p);
+	~mapped_file();
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	std::string_view data() const { return { m_data, m_size }; }
+
+  private:
+	const char *m_data = nullptr;
+	size_t m_size = 0;
+	std::string m_buffer;
+};
+
+} // namespace cif::detail
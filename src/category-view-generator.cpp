@@ -0,0 +1,98 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Generate a header file containing typed views for all categories
+// defined in a dictionary, see cif++/category_view.hpp
+
+#include "cif++/category_view.hpp"
+#include "cif++/dictionary_parser.hpp"
+#include "cif++/gzio.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+int main(int argc, char *const argv[])
+{
+	fs::path tmpFile;
+
+	try
+	{
+		if (argc != 3 and argc != 4)
+		{
+			std::cerr << "Usage: category-view-generator <dictionary-file> <output-file> [namespace]\n";
+			exit(1);
+		}
+
+		fs::path dictionary(argv[1]);
+		fs::path output(argv[2]);
+		std::string ns = argc == 4 ? argv[3] : "pdbx";
+
+		cif::gzio::ifstream in(dictionary);
+		if (not in.is_open())
+			throw std::runtime_error("Could not open dictionary file " + dictionary.string());
+
+		auto validator = cif::parse_dictionary(dictionary.stem().string(), in);
+
+		tmpFile = output.parent_path() / (output.filename().string() + ".tmp");
+
+		std::ofstream out(tmpFile);
+		if (not out.is_open())
+			throw std::runtime_error("Failed to open output file");
+
+		out << "// This file was generated from " << dictionary.filename().string();
+		if (not validator.version().empty())
+			out << " version " << validator.version();
+		out << "\n// using category-view-generator, part of libcifpp. Do not edit.\n\n"
+			<< "#pragma once\n\n"
+			<< "#include \"cif++/category_view.hpp\"\n\n"
+			<< "#include <string>\n\n"
+			<< "namespace " << ns << "\n{\n\n";
+
+		for (auto &cv : validator.get_category_validators())
+			cif::write_category_view(out, cv);
+
+		out << "} // namespace " << ns << '\n';
+
+		out.close();
+		fs::rename(tmpFile, output);
+	}
+	catch (const std::exception &ex)
+	{
+		std::cerr << '\n'
+				  << "Program terminated due to error:\n"
+				  << ex.what() << '\n';
+
+		if (not tmpFile.empty() and fs::exists(tmpFile))
+			fs::remove(tmpFile);
+
+		return 1;
+	}
+
+	return 0;
+}
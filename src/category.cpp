@@ -26,11 +26,20 @@
 
 #include "cif++/category.hpp"
 #include "cif++/datablock.hpp"
+#include "cif++/format.hpp"
 #include "cif++/parser.hpp"
 #include "cif++/utilities.hpp"
 
+#include "validation_tasks.hpp"
+#include "write_buffer.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <map>
 #include <numeric>
 #include <stack>
+#include <thread>
+#include <unordered_map>
 
 // TODO: Find out what the rules are exactly for linked items, the current implementation
 // is inconsistent. It all depends whether a link is satified if a item taking part in the
@@ -39,7 +48,7 @@
 namespace cif
 {
 
-const uint32_t kMaxLineLength = 132;
+using detail::kMaxLineLength;
 
 // --------------------------------------------------------------------
 
@@ -118,6 +127,36 @@ class row_comparator
 		return d;
 	}
 
+	// Compare the value for the first key item in row @a r with @a value
+	int compare_first_key(const row *r, std::string_view value) const
+	{
+		const auto &[k, f] = m_comparator.front();
+
+		auto v = r->get(k);
+		return f(v != nullptr ? v->text() : std::string_view{}, value);
+	}
+
+	// Return true if the value for the first key item in row @a r starts with
+	// a number and is sorted as such, but it is not an integer. Integer conditions
+	// consider these values larger than any number.
+	bool is_non_integer_first_key(const row *r) const
+	{
+		auto v = r->get(std::get<0>(m_comparator.front()));
+		if (v == nullptr or v->text().empty())
+			return false;
+
+		auto txt = v->text();
+		auto b = txt.data(), e = txt.data() + txt.length();
+
+		double d;
+		if ((bool)selected_charconv<double>::from_chars(b, e, d).ec)
+			return false;
+
+		int32_t i;
+		auto r2 = std::from_chars(b, e, i);
+		return (bool)r2.ec or r2.ptr != e;
+	}
+
   private:
 	using compareFunc = std::function<int(std::string_view, std::string_view)>;
 	using key_comparator = std::tuple<uint16_t, compareFunc>;
@@ -143,6 +182,29 @@ class category_index
 	row *find(const category &cat, row *k) const;
 	row *find_by_value(const category &cat, row_initializer k) const;
 
+	// Collect the rows in the order of the index for which both @a before and
+	// @a after return false. The predicates should follow the order of the index,
+	// @a before returns true for rows in front of the range and @a after for
+	// rows following it. This allows skipping complete subtrees.
+	template <typename Before, typename After>
+	void find_range(Before &&before, After &&after, std::vector<row *> &rows) const
+	{
+		find_range(m_root, before, after, rows);
+	}
+
+	// Compare the value for the first key item in row @a r with @a value
+	int compare_first_key(const row *r, std::string_view value) const
+	{
+		return m_row_comparator.compare_first_key(r, value);
+	}
+
+	// Return true if the first key item has values that are sorted
+	// as numbers but are not integers, see find_in_index
+	bool has_non_integer_first_keys() const
+	{
+		return m_non_integer_first_keys > 0;
+	}
+
 	void insert(category &cat, row *r);
 	void erase(category &cat, row *r);
 
@@ -193,6 +255,24 @@ class category_index
 	entry *insert(category &cat, entry *h, row *v);
 	entry *erase(category &cat, entry *h, row *k);
 
+	template <typename Before, typename After>
+	void find_range(const entry *h, Before &before, After &after, std::vector<row *> &rows) const
+	{
+		while (h != nullptr)
+		{
+			bool is_before = before(h->m_row);
+			bool is_after = not is_before and after(h->m_row);
+
+			if (not is_before)
+				find_range(h->m_left, before, after, rows);
+
+			if (not(is_before or is_after))
+				rows.push_back(h->m_row);
+
+			h = is_after ? nullptr : h->m_right;
+		}
+	}
+
 	//	void validate(entry* h, bool isParentRed, uint32_t blackDepth, uint32_t& minBlack, uint32_t& maxBlack) const;
 
 	entry *rotateLeft(entry *h)
@@ -324,6 +404,7 @@ class category_index
 
 	row_comparator m_row_comparator;
 	entry *m_root;
+	size_t m_non_integer_first_keys = 0;
 };
 
 category_index::category_index(category &cat)
@@ -387,6 +468,9 @@ void category_index::insert(category &cat, row *k)
 {
 	m_root = insert(cat, m_root, k);
 	m_root->m_red = false;
+
+	if (m_row_comparator.is_non_integer_first_key(k))
+		++m_non_integer_first_keys;
 }
 
 category_index::entry *category_index::insert(category &cat, entry *h, row *v)
@@ -432,6 +516,9 @@ void category_index::erase(category &cat, row *k)
 	m_root = erase(cat, m_root, k);
 	if (m_root != nullptr)
 		m_root->m_red = false;
+
+	if (m_non_integer_first_keys > 0 and m_row_comparator.is_non_integer_first_key(k))
+		--m_non_integer_first_keys;
 }
 
 category_index::entry *category_index::erase(category &cat, entry *h, row *k)
@@ -519,6 +606,9 @@ category::category(const category &rhs)
 
 	if (m_cat_validator != nullptr and m_index == nullptr)
 		m_index = new category_index(*this);
+
+	m_source = rhs.m_source;
+	m_source_text = rhs.m_source_text;
 }
 
 void swap(category &a, category &b) noexcept
@@ -533,6 +623,16 @@ void swap(category &a, category &b) noexcept
 	std::swap(a.m_index, b.m_index);
 	std::swap(a.m_head, b.m_head);
 	std::swap(a.m_tail, b.m_tail);
+	std::swap(a.m_row_count, b.m_row_count);
+	std::swap(a.m_statistics, b.m_statistics);
+	std::swap(a.m_modified_rows, b.m_modified_rows);
+	std::swap(a.m_modified_link_rows, b.m_modified_link_rows);
+	std::swap(a.m_validate_all_rows, b.m_validate_all_rows);
+	std::swap(a.m_validate_all_links, b.m_validate_all_links);
+	std::swap(a.m_parent_revision, b.m_parent_revision);
+	std::swap(a.m_validated_parent_revisions, b.m_validated_parent_revisions);
+	std::swap(a.m_source, b.m_source);
+	std::swap(a.m_source_text, b.m_source_text);
 }
 
 category::~category()
@@ -557,6 +657,13 @@ void category::remove_item(std::string_view item_name)
 
 		m_items.erase(m_items.begin() + ix);
 
+		if (m_statistics and m_statistics->size() > ix)
+			m_statistics->erase(m_statistics->begin() + ix);
+
+		m_validate_all_rows = m_validate_all_links = true;
+		mark_parent_changed();
+		drop_source_text();
+
 		break;
 	}
 }
@@ -571,6 +678,10 @@ void category::rename_item(std::string_view from_name, std::string_view to_name)
 		m_items[ix].m_name = to_name;
 		m_items[ix].m_validator = m_cat_validator ? m_cat_validator->get_validator_for_item(to_name) : nullptr;
 
+		m_validate_all_rows = m_validate_all_links = true;
+		mark_parent_changed();
+		drop_source_text();
+
 		break;
 	}
 }
@@ -621,6 +732,9 @@ void category::set_validator(const validator *v, datablock &db)
 {
 	m_validator = v;
 
+	m_validate_all_rows = m_validate_all_links = true;
+	mark_parent_changed();
+
 	if (m_index != nullptr)
 	{
 		delete m_index;
@@ -691,25 +805,203 @@ void category::update_links(const datablock &db)
 	}
 }
 
+// --------------------------------------------------------------------
+// Items like group_PDB or label_comp_id contain only a few distinct
+// values that are repeated many times. The outcome of validating those
+// values is remembered so they are validated only once per category.
+
+class validated_value_memo
+{
+  public:
+	static constexpr size_t kMaxSize = 256;
+
+	validated_value_memo(const item_validator *iv)
+		: m_validator(iv)
+	{
+	}
+
+	void validate(std::string_view value, std::error_code &ec)
+	{
+		if (m_enabled)
+		{
+			auto i = m_values.find(value);
+			if (i != m_values.end())
+			{
+				++m_hits;
+				ec = i->second;
+				return;
+			}
+		}
+
+		m_validator->validate_value(value, ec);
+
+		if (not m_enabled)
+			return;
+
+		if (m_values.size() < kMaxSize)
+			m_values.emplace(value, ec);
+		else if (m_hits < m_values.size())
+		{
+			// Mostly unique values, like ID's or coordinates, no use looking these up
+			m_enabled = false;
+			m_values.clear();
+		}
+	}
+
+  private:
+	const item_validator *m_validator;
+	std::unordered_map<std::string_view, std::error_code> m_values;
+	size_t m_hits = 0;
+	bool m_enabled = true;
+};
+
 bool category::is_valid() const
 {
-	bool result = true;
+	std::vector<detail::validation_task> tasks;
+	add_validation_tasks(tasks, false);
+	return detail::run_validation_tasks(tasks);
+}
+
+bool category::is_valid_incremental() const
+{
+	std::vector<detail::validation_task> tasks;
+	add_validation_tasks(tasks, true);
+	return detail::run_validation_tasks(tasks);
+}
 
+void category::add_validation_tasks(std::vector<detail::validation_task> &tasks, bool incremental) const
+{
 	if (m_validator == nullptr)
-		throw std::runtime_error("no Validator specified");
+	{
+		tasks.emplace_back([]() -> bool
+			{ throw std::runtime_error("no Validator specified"); });
+		return;
+	}
 
 	if (empty())
 	{
-		if (VERBOSE > 2)
-			std::cerr << "Skipping validation of empty category " << m_name << '\n';
-		return true;
+		tasks.emplace_back([this]()
+			{
+				if (VERBOSE > 2)
+					detail::validation_output() << "Skipping validation of empty category " << m_name << '\n';
+
+				std::lock_guard lock(m_mutex);
+				m_validate_all_rows = false;
+				m_modified_rows.clear();
+
+				return true;
+			});
+		return;
 	}
 
 	if (m_cat_validator == nullptr)
 	{
-		m_validator->report_error(validation_error::undefined_category, m_name, {}, false);
-		return false;
+		tasks.emplace_back([this]()
+			{
+				m_validator->report_error(validation_error::undefined_category, m_name, {}, false);
+				return false;
+			});
+		return;
+	}
+
+	// The modified rows are forgotten when the last task of this
+	// category is done, but only if no errors were reported
+
+	struct validation_state
+	{
+		std::atomic<size_t> m_remaining = 0;
+		std::atomic<bool> m_clean = true;
+	};
+
+	auto state = std::make_shared<validation_state>();
+
+	auto rows_task = [this, state](const row *first, const row *last)
+	{
+		bool clean = true;
+		bool result = validate_rows(first, last, clean);
+		if (not clean)
+			state->m_clean = false;
+		return result;
+	};
+
+	std::vector<detail::validation_task> cat_tasks;
+
+	cat_tasks.emplace_back([this]()
+		{ return validate_items(); });
+
+	std::unique_lock lock(m_mutex);
+
+	if (incremental and not m_validate_all_rows)
+	{
+		auto rows = in_row_order(m_modified_rows);
+
+		lock.unlock();
+
+		// mandatory items are checked in the first row
+		if (rows.empty() or rows.front() != m_head)
+			rows.insert(rows.begin(), m_head);
+
+		cat_tasks.emplace_back([rows_task, rows = std::move(rows)]()
+			{
+				bool result = true;
+				for (auto r : rows)
+					result = rows_task(r, r->m_next) and result;
+				return result;
+			});
 	}
+	else
+	{
+		lock.unlock();
+
+		// Split large categories in partitions of rows that can be validated concurrently
+		const size_t kPartitionSize = 10000;
+
+		const row *first = m_head;
+
+		if (get_validation_thread_count() > 1)
+		{
+			size_t n = 0;
+			for (auto ri = m_head; ri->m_next != nullptr; ri = ri->m_next)
+			{
+				if (++n % kPartitionSize != 0)
+					continue;
+
+				cat_tasks.emplace_back([rows_task, first, last = ri->m_next]()
+					{ return rows_task(first, last); });
+				first = ri->m_next;
+			}
+		}
+
+		cat_tasks.emplace_back([rows_task, first]()
+			{ return rows_task(first, nullptr); });
+	}
+
+	state->m_remaining = cat_tasks.size();
+
+	for (auto &task : cat_tasks)
+	{
+		tasks.emplace_back([this, state, task = std::move(task)]()
+			{
+				bool result = task();
+
+				if (not result)
+					state->m_clean = false;
+
+				if (--state->m_remaining == 0 and state->m_clean)
+				{
+					std::lock_guard lock(m_mutex);
+					m_validate_all_rows = false;
+					m_modified_rows.clear();
+				}
+
+				return result;
+			});
+	}
+}
+
+bool category::validate_items() const
+{
+	bool result = true;
 
 	auto mandatory = m_cat_validator->m_mandatory_items;
 
@@ -731,7 +1023,7 @@ bool category::is_valid() const
 
 	if (not mandatory.empty())
 	{
-		m_validator->report_error(validation_error::missing_mandatory_items, m_name, join(mandatory, ", "), false);
+		m_validator->report_error(validation_error::missing_mandatory_items, m_name, cif::join(mandatory, ", "), false);
 		result = false;
 	}
 
@@ -745,7 +1037,7 @@ bool category::is_valid() const
 				missing.insert(k);
 		}
 
-		m_validator->report_error(validation_error::missing_key_items, m_name, join(missing, ", "), false);
+		m_validator->report_error(validation_error::missing_key_items, m_name, cif::join(missing, ", "), false);
 		result = false;
 	}
 
@@ -766,10 +1058,20 @@ bool category::is_valid() const
 	// 	}
 	// #endif
 
-	// validate all values
-	mandatory = m_cat_validator->m_mandatory_items;
+	return result;
+}
+
+bool category::validate_rows(const row *first, const row *last, bool &clean) const
+{
+	bool result = true;
 
-	for (auto ri = m_head; ri != nullptr; ri = ri->m_next)
+	// The values are owned by the rows, they remain valid during validation
+	std::vector<validated_value_memo> memo;
+	memo.reserve(m_items.size());
+	for (auto &col : m_items)
+		memo.emplace_back(col.m_validator);
+
+	for (auto ri = first; ri != last; ri = ri->m_next)
 	{
 		for (uint16_t cix = 0; cix < m_items.size(); ++cix)
 		{
@@ -789,11 +1091,12 @@ bool category::is_valid() const
 				seen = true;
 				std::error_code ec;
 
-				iv->validate_value(vi->text(), ec);
+				memo[cix].validate(vi->text(), ec);
 
 				if ((bool)ec)
 				{
 					m_validator->report_error(ec, m_name, m_items[cix].m_name, false);
+					clean = false;
 					continue;
 				}
 			}
@@ -812,13 +1115,192 @@ bool category::is_valid() const
 	return result;
 }
 
+// --------------------------------------------------------------------
+// Hash join of a child and a parent category. Child key values that are
+// empty act as wildcard, just like in get_parents_condition. For each
+// distinct combination of non-empty child keys a hash table is built
+// over the parent rows, in practice there are only a few of these.
+
+namespace
+{
+	bool is_null_value(const item_value *v)
+	{
+		return v == nullptr or v->text().empty() or v->text() == "." or v->text() == "?";
+	}
+
+	class link_hash_join
+	{
+	  public:
+		link_hash_join(const category &child, const category &parent, std::vector<const row *> parent_rows, const link_validator &link)
+			: m_parent_rows(std::move(parent_rows))
+		{
+			if (link.m_child_keys.size() != link.m_parent_keys.size() or link.m_child_keys.size() > 32)
+				throw std::runtime_error("Unsupported link " + link.m_link_group_label + " for join");
+
+			auto cv = parent.get_cat_validator();
+
+			for (size_t ix = 0; ix < link.m_child_keys.size(); ++ix)
+			{
+				m_child_ix.push_back(child.get_item_ix(link.m_child_keys[ix]));
+				m_parent_ix.push_back(parent.get_item_ix(link.m_parent_keys[ix]));
+
+				auto iv = cv ? cv->get_validator_for_item(link.m_parent_keys[ix]) : nullptr;
+				m_types.push_back(iv ? iv->m_type : nullptr);
+			}
+		}
+
+		// Return the parent rows that match the child row @a r
+		const std::vector<const row *> &match(const row *r)
+		{
+			uint32_t mask = get_mask(r);
+			if (mask == 0)
+				return m_no_match;
+
+			auto &table = get_table(mask);
+
+			std::string key;
+			if (not make_key(r, m_child_ix, mask, key))
+				return m_no_match;
+
+			auto i = table.find(key);
+			return i == table.end() ? m_no_match : i->second;
+		}
+
+		// Return true if child row @a r has a value for any of the items in the link
+		bool has_key(const row *r) const
+		{
+			return get_mask(r) != 0;
+		}
+
+	  private:
+		using table_type = std::unordered_map<std::string, std::vector<const row *>>;
+
+		uint32_t get_mask(const row *r) const
+		{
+			uint32_t mask = 0;
+			for (size_t ix = 0; ix < m_child_ix.size(); ++ix)
+			{
+				if (not is_null_value(r->get(m_child_ix[ix])))
+					mask |= 1U << ix;
+			}
+			return mask;
+		}
+
+		table_type &get_table(uint32_t mask)
+		{
+			auto i = m_tables.find(mask);
+			if (i == m_tables.end())
+			{
+				i = m_tables.emplace(mask, table_type{}).first;
+				auto &table = i->second;
+
+				std::string key;
+
+				for (auto r : m_parent_rows)
+				{
+					bool complete = true;
+					for (size_t ix = 0; complete and ix < m_parent_ix.size(); ++ix)
+						complete = (mask & (1U << ix)) == 0 or not is_null_value(r->get(m_parent_ix[ix]));
+
+					if (complete and make_key(r, m_parent_ix, mask, key))
+						table[key].push_back(r);
+				}
+			}
+
+			return i->second;
+		}
+
+		// Create in @a key the value for the items in @a mask of row @a r. Values
+		// that are equal according to type_validator::compare result in the same
+		// key: numbers are compared by value and in text the spaces are collapsed.
+		// Returns false if a value cannot match anything, like a number that
+		// cannot be parsed.
+		bool make_key(const row *r, const std::vector<uint16_t> &ix, uint32_t mask, std::string &key) const
+		{
+			key.clear();
+
+			for (size_t i = 0; i < ix.size(); ++i)
+			{
+				if ((mask & (1U << i)) == 0)
+					continue;
+
+				auto v = r->get(ix[i])->text();
+				auto type = m_types[i];
+
+				if (type == nullptr)
+					key += v;
+				else if (type->m_primitive_type == DDL_PrimitiveType::Numb)
+				{
+					double d;
+					auto rv = selected_charconv<double>::from_chars(v.data(), v.data() + v.length(), d);
+					if ((bool)rv.ec)
+						return false;
+
+					if (d == 0)
+						d = 0; // -0 equals 0
+
+					// fixed length, may contain NUL characters
+					key.append(reinterpret_cast<const char *>(&d), sizeof(d));
+				}
+				else
+				{
+					bool icase = type->m_primitive_type == DDL_PrimitiveType::UChar;
+
+					for (auto ch = v.begin(); ch != v.end(); ++ch)
+					{
+						key += icase ? static_cast<char>(std::tolower(static_cast<unsigned char>(*ch))) : *ch;
+
+						if (*ch == ' ')
+						{
+							while (ch + 1 != v.end() and ch[1] == ' ')
+								++ch;
+						}
+					}
+				}
+
+				// CIF text cannot contain a NUL character
+				key += '\0';
+			}
+
+			return true;
+		}
+
+		std::vector<const row *> m_parent_rows;
+		std::vector<uint16_t> m_child_ix, m_parent_ix;
+		std::vector<const type_validator *> m_types;
+		std::map<uint32_t, table_type> m_tables;
+		const std::vector<const row *> m_no_match;
+	};
+
+} // namespace
+
 bool category::validate_links() const
+{
+	return validate_links(false);
+}
+
+bool category::validate_links_incremental() const
+{
+	return validate_links(true);
+}
+
+bool category::validate_links(bool incremental) const
 {
 	if (not m_validator)
 		return false;
 
 	bool result = true;
 
+	// Take a copy of the incremental validation state, this method may be
+	// called concurrently with the validation of the rows
+	std::unique_lock lock(m_mutex);
+
+	auto modified_rows = in_row_order(m_modified_link_rows);
+	bool validate_all_links = m_validate_all_links;
+	auto validated_parent_revisions = m_validated_parent_revisions;
+
+	lock.unlock();
+
 	for (auto &link : m_parent_links)
 	{
 		auto parent = link.linked;
@@ -832,44 +1314,381 @@ bool category::validate_links() const
 		if (name() == "atom_site" and (parent->name() == "pdbx_poly_seq_scheme" or parent->name() == "entity_poly_seq"))
 			continue;
 
+		// All rows need to be checked if rows were removed from the parent or
+		// key values in the parent have changed since the last validation
+		bool all_rows = not incremental or validate_all_links;
+		if (not all_rows)
+		{
+			auto i = validated_parent_revisions.find(parent);
+			all_rows = i == validated_parent_revisions.end() or i->second != parent->m_parent_revision;
+		}
+
+		if (not all_rows and modified_rows.empty())
+			continue;
+
 		size_t missing = 0;
 		category first_missing_rows(name());
 
-		for (auto r : *this)
+		// Instead of searching the parent for each child row, build a hash table
+		// of the parent rows once for each link, see link_hash_join.
+
+		std::vector<const row *> parent_rows;
+		for (auto p = parent->m_head; p != nullptr; p = p->m_next)
+			parent_rows.push_back(p);
+
+		std::vector<link_hash_join> joins;
+		for (auto l : m_validator->get_links_for_child(m_name))
 		{
-			auto cond = get_parents_condition(r, *parent);
-			if (not cond)
-				continue;
-			if (not parent->contains(std::move(cond)))
+			if (l->m_parent_category == parent->m_name)
+				joins.emplace_back(*this, *parent, parent_rows, *l);
+		}
+
+		auto check = [&](const row *r)
+		{
+			bool any = false, found = false;
+
+			for (auto &hj : joins)
+			{
+				if (not hj.has_key(r))
+					continue;
+
+				any = true;
+				found = not hj.match(r).empty();
+
+				if (found)
+					break;
+			}
+
+			if (any and not found)
 			{
 				++missing;
 				if (VERBOSE and first_missing_rows.size() < 5)
-					first_missing_rows.emplace(r);
+					first_missing_rows.emplace(row_handle{ *this, *r });
 			}
+		};
+
+		if (all_rows)
+		{
+			for (auto r = m_head; r != nullptr; r = r->m_next)
+				check(r);
+		}
+		else
+		{
+			for (auto r : modified_rows)
+				check(r);
 		}
 
 		if (missing)
 		{
 			result = false;
 
-			std::cerr << "Links for " << link.v->m_link_group_label << " are incomplete\n"
-					  << "  There are " << missing << " items in " << m_name << " that don't have matching parent items in " << parent->m_name << '\n';
+			auto &os = detail::validation_output();
+
+			os << "Links for " << link.v->m_link_group_label << " are incomplete\n"
+			   << "  There are " << missing << " items in " << m_name << " that don't have matching parent items in " << parent->m_name << '\n';
 
 			if (VERBOSE)
 			{
-				std::cerr << "showing first " << first_missing_rows.size() << " rows\n"
-						  << '\n';
+				os << "showing first " << first_missing_rows.size() << " rows\n"
+				   << '\n';
 
-				first_missing_rows.write(std::cerr, link.v->m_child_keys, false);
+				first_missing_rows.write(os, link.v->m_child_keys, false);
 
-				std::cerr << '\n';
+				os << '\n';
 			}
 		}
 	}
 
+	if (result)
+	{
+		lock.lock();
+
+		m_validate_all_links = false;
+		m_modified_link_rows.clear();
+
+		m_validated_parent_revisions.clear();
+		for (auto &link : m_parent_links)
+		{
+			if (link.linked != nullptr)
+				m_validated_parent_revisions[link.linked] = link.linked->m_parent_revision;
+		}
+	}
+
+	return result;
+}
+
+std::vector<const row *> category::in_row_order(const std::unordered_set<const row *> &rows) const
+{
+	std::vector<const row *> result;
+	result.reserve(rows.size());
+
+	for (auto r = m_head; r != nullptr and result.size() < rows.size(); r = r->m_next)
+	{
+		if (rows.contains(r))
+			result.push_back(r);
+	}
+
+	return result;
+}
+
+void category::mark_modified(const row *r)
+{
+	// Beyond this number of rows, checking all rows is just as fast
+	const size_t kMaxModifiedRows = 100000;
+
+	drop_source_text();
+
+	if (not m_validate_all_rows)
+	{
+		m_modified_rows.insert(r);
+		if (m_modified_rows.size() > kMaxModifiedRows)
+		{
+			m_validate_all_rows = true;
+			m_modified_rows.clear();
+		}
+	}
+
+	if (not m_validate_all_links)
+	{
+		m_modified_link_rows.insert(r);
+		if (m_modified_link_rows.size() > kMaxModifiedRows)
+		{
+			m_validate_all_links = true;
+			m_modified_link_rows.clear();
+		}
+	}
+}
+
+void category::mark_parent_changed()
+{
+	m_parent_revision = next_parent_revision();
+}
+
+uint64_t category::next_parent_revision()
+{
+	static std::atomic<uint64_t> s_revision{ 0 };
+	return ++s_revision;
+}
+
+// --------------------------------------------------------------------
+
+detail::item_counters *category::get_item_counters(uint16_t ix) const
+{
+	return m_statistics and ix < m_statistics->size() ? &(*m_statistics)[ix] : nullptr;
+}
+
+void category::add_to_statistics(const row *r)
+{
+	if (not m_statistics)
+		return;
+
+	for (uint16_t ix = 0; ix < m_statistics->size() and ix < r->size(); ++ix)
+	{
+		auto v = r->get(ix);
+		if (v != nullptr)
+			(*m_statistics)[ix].add(v->text());
+	}
+}
+
+void category::remove_from_statistics(const row *r)
+{
+	if (not m_statistics)
+		return;
+
+	for (uint16_t ix = 0; ix < m_statistics->size() and ix < r->size(); ++ix)
+	{
+		auto v = r->get(ix);
+		if (v != nullptr)
+			(*m_statistics)[ix].remove(v->text());
+	}
+}
+
+void category::collect_statistics() const
+{
+	if (not m_statistics)
+		m_statistics = std::make_unique<std::vector<detail::item_counters>>();
+
+	// items added after the statistics were collected are stale as well
+	m_statistics->resize(m_items.size());
+
+	std::vector<uint16_t> stale;
+	for (uint16_t ix = 0; ix < m_statistics->size(); ++ix)
+	{
+		auto &c = (*m_statistics)[ix];
+		if (not c.m_stale)
+			continue;
+
+		c = {};
+		c.m_stale = false;
+		stale.push_back(ix);
+	}
+
+	if (stale.empty())
+		return;
+
+	for (auto r = m_head; r != nullptr; r = r->m_next)
+	{
+		for (auto ix : stale)
+		{
+			auto v = r->get(ix);
+			if (v != nullptr)
+				(*m_statistics)[ix].add(v->text());
+		}
+	}
+}
+
+item_statistics category::get_item_statistics(std::string_view item_name) const
+{
+	item_statistics result{ std::string{ item_name } };
+
+	auto ix = get_item_ix(item_name);
+	if (ix >= m_items.size())
+		result.m_unknown_count = m_row_count;
+	else
+	{
+		std::lock_guard lock(m_mutex);
+
+		collect_statistics();
+
+		auto &c = (*m_statistics)[ix];
+
+		result.m_name = m_items[ix].m_name;
+		result.m_null_count = c.m_null_count;
+		result.m_unknown_count = c.m_unknown_count + (m_row_count - c.m_value_count);
+		result.m_distinct_count = c.m_distinct.estimate();
+		result.m_numeric_count = c.m_numeric_count;
+
+		if (c.m_numeric_count > 0)
+		{
+			result.m_min = c.m_min;
+			result.m_max = c.m_max;
+		}
+	}
+
+	return result;
+}
+
+std::vector<item_statistics> category::get_item_statistics() const
+{
+	std::vector<item_statistics> result;
+
+	for (auto &item : m_items)
+		result.emplace_back(get_item_statistics(item.m_name));
+
+	return result;
+}
+
+// --------------------------------------------------------------------
+
+size_t category::count_matches(const condition &cond) const
+{
+	size_t result = 0;
+
+	// Evaluate the condition on blocks of rows
+	std::array<const row *, kConditionBlockSize> rows;
+	block_selection selection;
+
+	auto count_block = [&](size_t n)
+	{
+		selection.reset();
+		for (size_t i = 0; i < n; ++i)
+			selection[i] = true;
+
+		cond.filter(*this, { rows.data(), n }, selection);
+
+		result += selection.count();
+	};
+
+	// Only test the rows found in the index, if possible
+	std::vector<row *> candidates;
+	if (auto range = cond.range(); range.has_value() and find_in_index(*range, candidates))
+	{
+		for (size_t i = 0; i < candidates.size();)
+		{
+			size_t n = 0;
+			for (; i < candidates.size() and n < rows.size(); ++i)
+				rows[n++] = candidates[i];
+
+			count_block(n);
+		}
+	}
+	else
+	{
+		for (auto r = m_head; r != nullptr;)
+		{
+			size_t n = 0;
+			for (; r != nullptr and n < rows.size(); r = r->m_next)
+				rows[n++] = r;
+
+			count_block(n);
+		}
+	}
+
 	return result;
 }
 
+bool category::find_in_index(const key_range &range, std::vector<row *> &rows) const
+{
+	if (m_index == nullptr or m_cat_validator == nullptr or m_cat_validator->m_keys.empty())
+		return false;
+
+	const auto &key = m_cat_validator->m_keys.front();
+	if (not is_first_key_numeric(*this, key, false))
+		return false;
+
+	// A lower bound comes from an integer condition, which considers a value
+	// like 12abc or 1.5 larger than any number. The index sorts these among
+	// the numbers, so all rows need to be tested in that case.
+	if (range.m_lower.has_value() and m_index->has_non_integer_first_keys())
+		return false;
+
+	// The index sorts empty values first, then the numbers and finally
+	// the values that are not a number. Walk each of these parts as requested.
+
+	uint16_t ix = get_item_ix(key);
+
+	auto is_empty = [ix](const row *r)
+	{
+		auto v = r->get(ix);
+		return v == nullptr or v->text().empty();
+	};
+
+	auto is_invalid = [ix](const row *r)
+	{
+		auto v = r->get(ix);
+		if (v == nullptr or v->text().empty())
+			return false;
+
+		auto txt = v->text();
+
+		double d;
+		auto rs = selected_charconv<double>::from_chars(txt.data(), txt.data() + txt.length(), d);
+		return (bool)rs.ec;
+	};
+
+	auto never = [](const row *) { return false; };
+
+	rows.clear();
+
+	if (range.m_with_empty)
+		m_index->find_range(never, [&](const row *r) { return not is_empty(r); }, rows);
+
+	std::string lower = range.m_lower.has_value() ? cif::format("%.17g", *range.m_lower).str() : "";
+	std::string upper = range.m_upper.has_value() ? cif::format("%.17g", *range.m_upper).str() : "";
+
+	m_index->find_range(
+		[&](const row *r)
+		{ return range.m_lower.has_value() ? m_index->compare_first_key(r, lower) < 0 : is_empty(r); },
+		[&](const row *r)
+		{ return range.m_upper.has_value() ? m_index->compare_first_key(r, upper) > 0 : is_invalid(r); },
+		rows);
+
+	if (range.m_with_invalid)
+		m_index->find_range([&](const row *r) { return not is_invalid(r); }, never, rows);
+
+	return true;
+}
+
 // --------------------------------------------------------------------
 
 row_handle category::operator[](const key_type &key)
@@ -1030,20 +1849,120 @@ std::vector<row_handle> category::get_parents(row_handle r, const category &pare
 
 	std::vector<row_handle> result;
 
-	for (auto parent : parentCat.find(get_parents_condition(r, parentCat)))
+	for (auto parent : parentCat.find(get_parents_condition(r, parentCat)))
+	{
+		if (std::find(result.begin(), result.end(), parent) == result.end())
+			result.push_back(parent);
+	}
+
+	return result;
+}
+
+std::vector<row_handle> category::get_linked(row_handle r, const category &cat) const
+{
+	std::vector<row_handle> result = get_children(r, cat);
+	if (result.empty())
+		result = get_parents(r, cat);
+	return result;
+}
+
+category::join_result_type category::join(const category &other, const link_validator &link) const
+{
+	bool is_child = iequals(link.m_child_category, m_name) and iequals(link.m_parent_category, other.m_name);
+	bool is_parent = iequals(link.m_parent_category, m_name) and iequals(link.m_child_category, other.m_name);
+
+	if (not(is_child or is_parent))
+		throw std::runtime_error("Link " + link.m_link_group_label + " does not link categories " + m_name + " and " + other.m_name);
+
+	join_result_type result;
+	std::vector<const row *> rows, other_rows;
+
+	for (auto r = m_head; r != nullptr; r = r->m_next)
+	{
+		result.emplace_back(row_handle{ *this, *r }, std::vector<row_handle>{});
+		rows.push_back(r);
+	}
+
+	for (auto r = other.m_head; r != nullptr; r = r->m_next)
+		other_rows.push_back(r);
+
+	// In case of a link from a category to itself, this is the child
+	if (is_child)
+	{
+		link_hash_join hj(*this, other, std::move(other_rows), link);
+
+		for (size_t ix = 0; ix < rows.size(); ++ix)
+		{
+			for (auto p : hj.match(rows[ix]))
+				result[ix].second.emplace_back(other, *p);
+		}
+	}
+	else
+	{
+		std::unordered_map<const row *, size_t> index;
+		for (size_t ix = 0; ix < rows.size(); ++ix)
+			index[rows[ix]] = ix;
+
+		link_hash_join hj(other, *this, std::move(rows), link);
+
+		for (auto c = other.m_head; c != nullptr; c = c->m_next)
+		{
+			for (auto p : hj.match(c))
+				result[index[p]].second.emplace_back(other, *c);
+		}
+	}
+
+	return result;
+}
+
+category::join_result_type category::join(const category &other) const
+{
+	if (m_validator == nullptr)
+		throw std::runtime_error("No validator known for category " + m_name);
+
+	std::vector<const link_validator *> links;
+
+	for (auto link : m_validator->get_links_for_child(m_name))
+	{
+		if (iequals(link->m_parent_category, other.m_name))
+			links.push_back(link);
+	}
+
+	for (auto link : m_validator->get_links_for_parent(m_name))
+	{
+		if (iequals(link->m_child_category, other.m_name) and std::find(links.begin(), links.end(), link) == links.end())
+			links.push_back(link);
+	}
+
+	join_result_type result;
+
+	for (auto link : links)
 	{
-		if (std::find(result.begin(), result.end(), parent) == result.end())
-			result.push_back(parent);
-	}
+		auto j = join(other, *link);
 
-	return result;
-}
+		if (result.empty())
+		{
+			result = std::move(j);
+			continue;
+		}
+
+		for (size_t ix = 0; ix < result.size(); ++ix)
+		{
+			auto &linked = result[ix].second;
+			for (auto &r : j[ix].second)
+			{
+				if (std::find(linked.begin(), linked.end(), r) == linked.end())
+					linked.push_back(r);
+			}
+		}
+	}
 
-std::vector<row_handle> category::get_linked(row_handle r, const category &cat) const
-{
-	std::vector<row_handle> result = get_children(r, cat);
 	if (result.empty())
-		result = get_parents(r, cat);
+	{
+		for (auto r : *this)
+			result.emplace_back(r, std::vector<row_handle>{});
+	}
+
 	return result;
 }
 
@@ -1061,6 +1980,9 @@ category::iterator category::erase(iterator pos)
 	if (m_index != nullptr)
 		m_index->erase(*this, r);
 
+	mark_parent_changed();
+	drop_source_text();
+
 	if (r == m_head)
 	{
 		m_head = m_head->m_next;
@@ -1093,6 +2015,9 @@ category::iterator category::erase(iterator pos)
 			childCat->erase_orphans(get_children_condition(rh, *childCat), *this);
 	}
 
+	--m_row_count;
+	remove_from_statistics(r);
+
 	delete_row(r);
 
 	// reset mTail, if needed
@@ -1133,10 +2058,23 @@ size_t category::erase(condition &&cond)
 }
 
 size_t category::erase(condition &&cond, std::function<void(row_handle)> &&visit)
+{
+	cond.prepare(*this);
+	return erase_impl(cond, visit);
+}
+
+size_t category::erase(const condition &cond)
+{
+	assert(cond.empty() or cond.is_prepared());
+	return erase_impl(cond, {});
+}
+
+size_t category::erase_impl(const condition &cond, const std::function<void(row_handle)> &visit)
 {
 	size_t result = 0;
 
-	cond.prepare(*this);
+	if (cond.empty())
+		return result;
 
 	std::map<category *, condition> potential_orphans;
 
@@ -1182,9 +2120,14 @@ void category::clear()
 	}
 
 	m_head = m_tail = nullptr;
+	m_row_count = 0;
+	m_statistics.reset();
 
 	delete m_index;
 	m_index = nullptr;
+
+	mark_parent_changed();
+	drop_source_text();
 }
 
 void category::erase_orphans(condition &&cond, category &parent)
@@ -1315,6 +2258,48 @@ void category::update_value(const std::vector<row_handle> &rows, std::string_vie
 		}
 	}
 
+	// The conditions used to find the children for each link and to check
+	// the parents. These are prepared once and reused for each row.
+	struct link_conditions
+	{
+		category *childCat;
+		const link_validator *linked;
+		std::string childItemName;
+		condition children, parents, check;
+	};
+
+	std::vector<link_conditions> conditions;
+
+	for (auto &&[childCat, linked] : m_child_links)
+	{
+		if (std::find(linked->m_parent_keys.begin(), linked->m_parent_keys.end(), item_name) == linked->m_parent_keys.end())
+			continue;
+
+		link_conditions lc{ childCat, linked };
+
+		for (size_t ix = 0; ix < linked->m_parent_keys.size(); ++ix)
+		{
+			std::string pk = linked->m_parent_keys[ix];
+			std::string ck = linked->m_child_keys[ix];
+
+			if (pk == item_name)
+				lc.childItemName = ck;
+
+			lc.children = std::move(lc.children) && key(ck) == parameter(ix);
+			lc.parents = std::move(lc.parents) && key(pk) == parameter(ix);
+			lc.check = std::move(lc.check) && key(ck) == parameter(ix);
+		}
+
+		lc.children.prepare(*childCat);
+		lc.parents.prepare(*this);
+		lc.check.prepare(*childCat);
+
+		conditions.emplace_back(std::move(lc));
+	}
+
+	std::vector<std::string> keyValues;
+	std::vector<std::string_view> keyValueViews, childValues;
+
 	// update and see if we need to update any child categories that depend on this value
 	for (auto parent : rows)
 	{
@@ -1323,29 +2308,24 @@ void category::update_value(const std::vector<row_handle> &rows, std::string_vie
 
 		parent.assign(colIx, value, false);
 
-		for (auto &&[childCat, linked] : m_child_links)
+		for (auto &[childCat, linked, childItemName, children_cond, parents_cond, check_cond] : conditions)
 		{
-			if (std::find(linked->m_parent_keys.begin(), linked->m_parent_keys.end(), item_name) == linked->m_parent_keys.end())
-				continue;
-
-			condition cond;
-			std::string childItemName;
+			keyValues.resize(linked->m_parent_keys.size());
+			keyValueViews.resize(linked->m_parent_keys.size());
 
 			for (size_t ix = 0; ix < linked->m_parent_keys.size(); ++ix)
 			{
 				std::string pk = linked->m_parent_keys[ix];
-				std::string ck = linked->m_child_keys[ix];
 
 				if (pk == item_name)
-				{
-					childItemName = ck;
-					cond = std::move(cond) && key(ck) == oldValue;
-				}
+					keyValues[ix] = oldValue;
 				else
-					cond = std::move(cond) && key(ck) == parent[pk].text();
+					keyValues[ix] = parent[pk].text();
+
+				keyValueViews[ix] = keyValues[ix];
 			}
 
-			auto children = childCat->find(std::move(cond));
+			auto children = childCat->find(children_cond.bind(keyValueViews));
 			if (children.empty())
 				continue;
 
@@ -1360,38 +2340,24 @@ void category::update_value(const std::vector<row_handle> &rows, std::string_vie
 
 			for (auto child : child_rows)
 			{
-				condition cond_c;
-
-				for (size_t ix = 0; ix < linked->m_parent_keys.size(); ++ix)
-				{
-					std::string pk = linked->m_parent_keys[ix];
-					std::string ck = linked->m_child_keys[ix];
-
-					cond_c = std::move(cond_c) && key(pk) == child[ck].text();
-				}
+				childValues.clear();
+				for (auto &ck : linked->m_child_keys)
+					childValues.push_back(child[ck].text());
 
-				auto parents = find(std::move(cond_c));
-				if (parents.empty())
+				if (not contains(parents_cond.bind(childValues)))
 				{
 					process.push_back(child);
 					continue;
 				}
 
 				// oops, we need to split this child, unless a row already exists for the new value
-				condition check;
-
 				for (size_t ix = 0; ix < linked->m_parent_keys.size(); ++ix)
 				{
-					std::string pk = linked->m_parent_keys[ix];
-					std::string ck = linked->m_child_keys[ix];
-
-					if (pk == item_name)
-						check = std::move(check) && key(ck) == value;
-					else
-						check = std::move(check) && key(ck) == parent[pk].text();
+					if (linked->m_parent_keys[ix] == item_name)
+						keyValueViews[ix] = value;
 				}
 
-				if (childCat->contains(std::move(check))) // phew..., narrow escape
+				if (childCat->contains(check_cond.bind(keyValueViews))) // phew..., narrow escape
 					continue;
 
 				// create the actual copy, if we can...
@@ -1452,16 +2418,38 @@ void category::update_value(row *row, uint16_t item, std::string_view value, boo
 			m_index->erase(*this, row);
 	}
 
+	auto counters = get_item_counters(item);
+
 	// first remove old value with cix
 	if (ival != nullptr)
+	{
+		if (counters != nullptr)
+			counters->remove(oldValue);
 		row->remove(item);
+	}
 
 	if (not value.empty())
+	{
 		row->append(item, { value });
+		if (counters != nullptr)
+			counters->add(value);
+	}
 
 	if (reinsert and m_index != nullptr)
 		m_index->insert(*this, row);
 
+	mark_modified(row);
+
+	for (auto &&[childCat, linked] : m_child_links)
+	{
+		if (std::find_if(linked->m_parent_keys.begin(), linked->m_parent_keys.end(), [&col](const std::string &pk)
+				{ return iequals(pk, col.m_name); }) != linked->m_parent_keys.end())
+		{
+			mark_parent_changed();
+			break;
+		}
+	}
+
 	// see if we need to update any child categories that depend on this value
 	auto iv = col.m_validator;
 	if (updateLinked and iv != nullptr /*and m_cascade*/)
@@ -1573,6 +2561,9 @@ void category::delete_row(row *r)
 {
 	if (r != nullptr)
 	{
+		m_modified_rows.erase(r);
+		m_modified_link_rows.erase(r);
+
 		row_allocator_type ra(get_allocator());
 		row_allocator_traits::destroy(ra, r);
 		row_allocator_traits::deallocate(ra, r, 1);
@@ -1658,6 +2649,8 @@ category::iterator category::insert_impl(const_iterator pos, row *n)
 		if (m_index != nullptr)
 			m_index->insert(*this, n);
 
+		mark_modified(n);
+
 		// insert at end, most often this is the case
 		if (pos.m_current.m_row == nullptr)
 		{
@@ -1671,11 +2664,24 @@ category::iterator category::insert_impl(const_iterator pos, row *n)
 			assert(m_head != nullptr);
 
 			if (pos.m_current.m_row == m_head)
-				m_head = n->m_next = m_head;
+			{
+				n->m_next = m_head;
+				m_head = n;
+			}
 			else
-				n = n->m_next = m_head->m_next;
+			{
+				auto p = m_head;
+				while (p->m_next != pos.m_current.m_row)
+					p = p->m_next;
+
+				n->m_next = p->m_next;
+				p->m_next = n;
+			}
 		}
 
+		++m_row_count;
+		add_to_statistics(n);
+
 		return iterator(*this, n);
 	}
 	catch (const std::exception &e)
@@ -1699,6 +2705,10 @@ void category::swap_item(uint16_t item_ix, row_handle &a, row_handle &b)
 	auto &rb = *b.m_row;
 
 	std::swap(ra.at(item_ix), rb.at(item_ix));
+
+	mark_modified(&ra);
+	mark_modified(&rb);
+	mark_parent_changed();
 }
 
 void category::sort(std::function<int(row_handle, row_handle)> f)
@@ -1726,106 +2736,148 @@ void category::sort(std::function<int(row_handle, row_handle)> f)
 
 	assert(r == m_tail);
 	assert(size() == rows.size());
+
+	drop_source_text();
 }
 
 void category::reorder_by_index()
 {
 	if (m_index)
+	{
 		std::tie(m_head, m_tail) = m_index->reorder();
+		drop_source_text();
+	}
 }
 
 namespace detail
 {
-	size_t write_value(std::ostream &os, std::string_view value, size_t offset, size_t width, bool right_aligned)
+	value_quoting get_quoting(std::string_view value)
 	{
-		if (value.find('\n') != std::string::npos or width == 0 or value.length() > 132) // write as text item
-		{
-			if (offset > 0)
-				os << '\n';
-			os << ';';
+		if (value.find('\n') != std::string::npos or value.length() > kMaxLineLength)
+			return value_quoting::text_field;
 
-			char pc = 0;
-			for (auto ch : value)
+		if (sac_parser::is_unquoted_string(value))
+			return value_quoting::none;
+
+		// see if we can use the quote character, that is not possible if it
+		// is followed by a non blank character other than itself
+		auto can_quote = [value](char q)
+		{
+			for (auto p = value.find(q); p != std::string::npos; p = value.find(q, p + 1))
 			{
-				if (pc == '\n' and ch == ';')
-					os << '\\';
-				os << ch;
-				pc = ch;
+				char next = p + 1 < value.length() ? value[p + 1] : 0;
+				if (not sac_parser::is_non_blank(next) or next == q)
+					return false;
 			}
 
-			if (value.back() != '\n')
-				os << '\n';
-			os << ';' << '\n';
-			offset = 0;
-		}
-		else if (sac_parser::is_unquoted_string(value))
+			return true;
+		};
+
+		if (can_quote('\''))
+			return value_quoting::single_quote;
+
+		if (can_quote('"'))
+			return value_quoting::double_quote;
+
+		return value_quoting::plain_text_field;
+	}
+
+	size_t get_value_length(std::string_view value, value_quoting quoting)
+	{
+		return value.length() + (quoting == value_quoting::none ? 0 : 2);
+	}
+
+	size_t write_value(write_buffer &buffer, std::string_view value, value_quoting quoting, size_t offset, size_t width, bool right_aligned)
+	{
+		if (width == 0)
+			quoting = value_quoting::text_field;
+
+		switch (quoting)
 		{
-			if (right_aligned)
+			case value_quoting::text_field:
 			{
-				if (value.length() < width)
+				if (offset > 0)
+					buffer.append('\n');
+				buffer.append(';');
+
+				// escape semicolons at the start of a line
+				for (auto p = value.find("\n;"); p != std::string::npos; p = value.find("\n;"))
 				{
-					os << std::string(width - value.length() - 1, ' ');
-					offset += width;
+					buffer.append(value.substr(0, p + 1));
+					buffer.append('\\');
+					value.remove_prefix(p + 1);
 				}
-				else
-					offset += value.length() + 1;
-			}
 
-			os << value;
+				buffer.append(value);
 
-			if (right_aligned)
-				os << ' ';
-			else
-			{
-				if (value.length() < width)
+				if (value.empty() or value.back() != '\n')
+					buffer.append('\n');
+				buffer.append(";\n");
+				offset = 0;
+				break;
+			}
+
+			case value_quoting::none:
+				if (right_aligned)
 				{
-					os << std::string(width - value.length(), ' ');
-					offset += width;
+					if (value.length() < width)
+					{
+						buffer.pad(width - value.length() - 1);
+						offset += width;
+					}
+					else
+						offset += value.length() + 1;
+
+					buffer.append(value);
+					buffer.append(' ');
 				}
 				else
 				{
-					os << ' ';
-					offset += value.length() + 1;
+					buffer.append(value);
+
+					if (value.length() < width)
+					{
+						buffer.pad(width - value.length());
+						offset += width;
+					}
+					else
+					{
+						buffer.append(' ');
+						offset += value.length() + 1;
+					}
 				}
-			}
-		}
-		else
-		{
-			bool done = false;
-			for (char q : { '\'', '"' })
-			{
-				auto p = value.find(q); // see if we can use the quote character
-				while (p != std::string::npos and sac_parser::is_non_blank(value[p + 1]) and value[p + 1] != q)
-					p = value.find(q, p + 1);
+				break;
 
-				if (p != std::string::npos)
-					continue;
+			case value_quoting::single_quote:
+			case value_quoting::double_quote:
+			{
+				char q = quoting == value_quoting::single_quote ? '\'' : '"';
 
-				os << q << value << q;
+				buffer.append(q);
+				buffer.append(value);
+				buffer.append(q);
 
 				if (value.length() + 2 < width)
 				{
-					os << std::string(width - value.length() - 2, ' ');
+					buffer.pad(width - value.length() - 2);
 					offset += width;
 				}
 				else
 				{
-					os << ' ';
+					buffer.append(' ');
 					offset += value.length() + 1;
 				}
-
-				done = true;
 				break;
 			}
 
-			if (not done)
-			{
+			case value_quoting::plain_text_field:
 				if (offset > 0)
-					os << '\n';
-				os << ';' << value << '\n'
-				   << ';' << '\n';
+					buffer.append('\n');
+				buffer.append(';');
+				buffer.append(value);
+				buffer.append("\n;\n");
 				offset = 0;
-			}
+				break;
 		}
 
 		return offset;
@@ -1833,6 +2885,85 @@ namespace detail
 
 } // namespace detail
 
+// --------------------------------------------------------------------
+
+namespace
+{
+	std::atomic<size_t> s_write_thread_count{ 1 };
+
+	// Set while running a write task, nested tasks run sequentially
+	thread_local bool t_in_write_task = false;
+} // namespace
+
+void set_write_thread_count(size_t n)
+{
+	if (n == 0)
+		n = std::max(std::thread::hardware_concurrency(), 1U);
+	s_write_thread_count = n;
+}
+
+size_t get_write_thread_count()
+{
+	return s_write_thread_count;
+}
+
+namespace detail
+{
+	bool in_write_task()
+	{
+		return t_in_write_task;
+	}
+
+	void run_write_tasks(const std::vector<write_task> &tasks)
+	{
+		size_t nr_of_threads = std::min(get_write_thread_count(), tasks.size());
+
+		if (nr_of_threads <= 1 or t_in_write_task)
+		{
+			for (auto &task : tasks)
+				task();
+			return;
+		}
+
+		std::vector<std::exception_ptr> exceptions(tasks.size());
+		std::atomic<size_t> next{ 0 };
+
+		auto worker = [&tasks, &exceptions, &next]()
+		{
+			t_in_write_task = true;
+
+			for (size_t ix = next++; ix < tasks.size(); ix = next++)
+			{
+				try
+				{
+					tasks[ix]();
+				}
+				catch (...)
+				{
+					exceptions[ix] = std::current_exception();
+				}
+			}
+
+			t_in_write_task = false;
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < nr_of_threads; ++i)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto &t : threads)
+			t.join();
+
+		for (auto &ex : exceptions)
+		{
+			if (ex)
+				std::rethrow_exception(ex);
+		}
+	}
+} // namespace detail
+
 std::vector<std::string> category::get_item_order() const
 {
 	std::vector<std::string> result;
@@ -1843,6 +2974,14 @@ std::vector<std::string> category::get_item_order() const
 
 void category::write(std::ostream &os) const
 {
+	if (not m_source_text.empty())
+	{
+		detail::write_buffer buffer(os);
+		write_source_text(buffer);
+		buffer.flush();
+		return;
+	}
+
 	std::vector<uint16_t> order(m_items.size());
 	iota(order.begin(), order.end(), static_cast<uint16_t>(0));
 	write(os, order, false);
@@ -1873,6 +3012,25 @@ void category::write(std::ostream &os, const std::vector<std::string> &items, bo
 }
 
 void category::write(std::ostream &os, const std::vector<uint16_t> &order, bool includeEmptyItems) const
+{
+	detail::write_buffer buffer(os);
+	write(buffer, order);
+	buffer.flush();
+}
+
+bool category::write_source_text(detail::write_buffer &buffer) const
+{
+	if (m_source_text.empty())
+		return false;
+
+	buffer.append(m_source_text);
+	if (m_source_text.back() != '\n')
+		buffer.append('\n');
+
+	return true;
+}
+
+void category::write(detail::write_buffer &buffer, const std::vector<uint16_t> &order) const
 {
 	if (empty())
 		return;
@@ -1893,85 +3051,172 @@ void category::write(std::ostream &os, const std::vector<uint16_t> &order, bool
 		}
 	}
 
+	// Missing and empty values are written as a question mark
+	auto get_text = [](const row *r, uint16_t cix)
+	{
+		std::string_view s;
+		auto iv = r->get(cix);
+		if (iv != nullptr)
+			s = iv->text();
+
+		if (s.empty())
+			s = "?";
+
+		return s;
+	};
+
 	if (needLoop)
 	{
-		os << "loop_\n";
+		buffer.append("loop_\n");
 
 		std::vector<size_t> itemWidths(m_items.size());
 
 		for (auto cix : order)
 		{
 			auto &col = m_items[cix];
-			os << '_';
+			buffer.append('_');
 			if (not m_name.empty())
-				os << m_name << '.';
-			os << col.m_name << ' ' << '\n';
+			{
+				buffer.append(m_name);
+				buffer.append('.');
+			}
+			buffer.append(col.m_name);
+			buffer.append(" \n");
 			itemWidths[cix] = 2;
 		}
 
-		for (auto r = m_head; r != nullptr; r = r->m_next)
+		// Large categories are formatted in partitions of rows, concurrently
+		// when more than one write thread was requested. The end of a row
+		// resets the line, so the output does not depend on the partitioning.
+		const size_t kPartitionSize = detail::kWritePartitionSize;
+
+		std::vector<const row *> partitions{ m_head };
+
+		if (get_write_thread_count() > 1 and not detail::in_write_task())
 		{
-			for (uint16_t ix = 0; ix < r->size(); ++ix)
+			size_t n = 0;
+			for (auto r = m_head; r->m_next != nullptr; r = r->m_next)
 			{
-				auto v = r->get(ix);
-				if (v == nullptr)
-					continue;
+				if (++n % kPartitionSize == 0)
+					partitions.push_back(r->m_next);
+			}
+		}
+
+		partitions.push_back(nullptr);
+
+		const size_t partition_count = partitions.size() - 1;
+
+		// The first pass decides how to quote each value and calculates
+		// the widths of the items, the quoting is kept for the second pass.
+		std::vector<detail::value_quoting> quoting(size() * order.size());
+		std::vector<std::vector<size_t>> partitionWidths(partition_count, itemWidths);
+
+		auto measure = [&](size_t p)
+		{
+			auto &widths = partitionWidths[p];
+			auto qi = quoting.begin() + p * kPartitionSize * order.size();
 
-				if (v->text().find('\n') == std::string_view::npos)
+			for (auto r = partitions[p]; r != partitions[p + 1]; r = r->m_next)
+			{
+				for (auto cix : order)
 				{
-					size_t l = v->text().length();
+					auto s = get_text(r, cix);
+					auto q = *qi++ = detail::get_quoting(s);
 
-					if (not sac_parser::is_unquoted_string(v->text()))
-						l += 2;
+					if (q == detail::value_quoting::text_field)
+						continue;
 
-					if (l > 132)
+					size_t l = detail::get_value_length(s, q);
+					if (l > kMaxLineLength)
 						continue;
 
-					if (itemWidths[ix] < l + 1)
-						itemWidths[ix] = l + 1;
+					if (widths[cix] < l + 1)
+						widths[cix] = l + 1;
 				}
 			}
-		}
+		};
 
-		for (auto r = m_head; r != nullptr; r = r->m_next) // loop over rows
+		auto format = [&](detail::write_buffer &b, size_t p)
 		{
-			size_t offset = 0;
+			auto qi = quoting.begin() + p * kPartitionSize * order.size();
 
-			for (uint16_t cix : order)
+			for (auto r = partitions[p]; r != partitions[p + 1]; r = r->m_next) // loop over rows
 			{
-				size_t w = itemWidths[cix];
+				size_t offset = 0;
 
-				std::string_view s;
-				auto iv = r->get(cix);
-				if (iv != nullptr)
-					s = iv->text();
+				for (uint16_t cix : order)
+				{
+					size_t w = itemWidths[cix];
 
-				if (s.empty())
-					s = "?";
+					auto s = get_text(r, cix);
+					auto q = *qi++;
 
-				size_t l = s.length();
-				if (not sac_parser::is_unquoted_string(s))
-					l += 2;
-				if (l < w)
-					l = w;
+					size_t l = std::max(detail::get_value_length(s, q), w);
 
-				if (offset + l > 132 and offset > 0)
-				{
-					os << '\n';
-					offset = 0;
+					if (offset + l > kMaxLineLength and offset > 0)
+					{
+						b.append('\n');
+						offset = 0;
+					}
+
+					offset = detail::write_value(b, s, q, offset, w, right_aligned[cix]);
+
+					if (offset > kMaxLineLength)
+					{
+						b.append('\n');
+						offset = 0;
+					}
 				}
 
-				offset = detail::write_value(os, s, offset, w, right_aligned[cix]);
+				if (offset > 0)
+					b.append('\n');
+
+				b.flush_if_full();
+			}
+		};
+
+		if (partition_count == 1)
+		{
+			measure(0);
+			itemWidths = partitionWidths.front();
+			format(buffer, 0);
+		}
+		else
+		{
+			std::vector<detail::write_task> tasks;
+			for (size_t p = 0; p < partition_count; ++p)
+				tasks.emplace_back([&measure, p]()
+					{ measure(p); });
+			detail::run_write_tasks(tasks);
+
+			for (auto &widths : partitionWidths)
+			{
+				for (auto cix : order)
+					itemWidths[cix] = std::max(itemWidths[cix], widths[cix]);
+			}
+
+			// Format as many partitions at a time as there are threads,
+			// the result is written before starting on the next ones
+			const size_t batch_size = get_write_thread_count();
 
-				if (offset > 132)
+			for (size_t first = 0; first < partition_count; first += batch_size)
+			{
+				size_t last = std::min(first + batch_size, partition_count);
+
+				std::vector<detail::write_buffer> buffers(last - first);
+
+				tasks.clear();
+				for (size_t p = first; p < last; ++p)
+					tasks.emplace_back([&format, &buffers, first, p]()
+						{ format(buffers[p - first], p); });
+				detail::run_write_tasks(tasks);
+
+				for (auto &b : buffers)
 				{
-					os << '\n';
-					offset = 0;
+					buffer.append(b);
+					buffer.flush_if_full();
 				}
 			}
-
-			if (offset > 0)
-				os << '\n';
 		}
 	}
 	else
@@ -1981,33 +3226,27 @@ void category::write(std::ostream &os, const std::vector<uint16_t> &order, bool
 
 		for (auto &col : m_items)
 		{
-			std::string item_name = '_' + m_name + '.' + col.m_name;
+			size_t item_name_length = m_name.length() + col.m_name.length() + 2;
 
-			if (l < item_name.length())
-				l = item_name.length();
+			if (l < item_name_length)
+				l = item_name_length;
 		}
 
 		l += 3;
 
+		std::vector<detail::value_quoting> quoting(m_items.size());
+
 		size_t width = 1;
 
 		for (auto cix : order)
 		{
+			auto s = get_text(m_head, cix);
+			quoting[cix] = detail::get_quoting(s);
+
 			if (not right_aligned[cix])
 				continue;
 
-			std::string_view s;
-			auto iv = m_head->get(cix);
-			if (iv != nullptr)
-				s = iv->text();
-
-			if (s.empty())
-				s = "?";
-
-			size_t l2 = s.length();
-
-			if (not sac_parser::is_unquoted_string(s))
-				l2 += 2;
+			size_t l2 = detail::get_value_length(s, quoting[cix]);
 
 			if (width < l2)
 				width = l2;
@@ -2017,32 +3256,30 @@ void category::write(std::ostream &os, const std::vector<uint16_t> &order, bool
 		{
 			auto &col = m_items[cix];
 
-			os << '_';
+			buffer.append('_');
 			if (not m_name.empty())
-				os << m_name << '.';
-			os << col.m_name << std::string(l - col.m_name.length() - m_name.length() - 2, ' ');
-
-			std::string_view s;
-			auto iv = m_head->get(cix);
-			if (iv != nullptr)
-				s = iv->text();
+			{
+				buffer.append(m_name);
+				buffer.append('.');
+			}
+			buffer.append(col.m_name);
+			buffer.pad(l - col.m_name.length() - m_name.length() - 2);
 
-			if (s.empty())
-				s = "?";
+			auto s = get_text(m_head, cix);
 
 			size_t offset = l;
 			if (s.length() + l >= kMaxLineLength)
 			{
-				os << '\n';
+				buffer.append('\n');
 				offset = 0;
 			}
 
-			if (detail::write_value(os, s, offset, width, s.empty() or right_aligned[cix]) != 0)
-				os << '\n';
+			if (detail::write_value(buffer, s, quoting[cix], offset, width, right_aligned[cix]) != 0)
+				buffer.append('\n');
 		}
 	}
 
-	os << "# \n";
+	buffer.append("# \n");
 }
 
 bool category::operator==(const category &rhs) const
@@ -0,0 +1,138 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/category_view.hpp"
+
+#include <set>
+
+namespace cif
+{
+
+namespace
+{
+
+// Names that cannot be used as identifier for an accessor
+const std::set<std::string, std::less<>> kReservedNames{
+	"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+	"case", "catch", "char", "char8_t", "char16_t", "char32_t", "class", "compl", "concept",
+	"const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await",
+	"co_return", "co_yield", "decltype", "default", "delete", "do", "double", "dynamic_cast",
+	"else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+	"if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+	"nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+	"reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static",
+	"static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+	"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+	"virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+
+	// members of cif::category_row_view
+	"handle", "empty", "item", "get"
+};
+
+// Turn a name from the dictionary into a valid C++ identifier
+std::string make_identifier(std::string_view name)
+{
+	std::string result;
+
+	for (char ch : name)
+	{
+		if (std::isalnum(static_cast<unsigned char>(ch)))
+			result += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+		else
+			result += '_';
+	}
+
+	if (result.empty() or std::isdigit(static_cast<unsigned char>(result.front())))
+		result.insert(result.begin(), '_');
+
+	if (kReservedNames.contains(result))
+		result += '_';
+
+	return result;
+}
+
+// The C++ type used for an item of type @a type
+std::string_view map_type(const type_validator *type)
+{
+	// Only the types known to hold a single number are mapped, other numb
+	// types like ranges and lists are returned as text.
+	if (type != nullptr and type->m_primitive_type == DDL_PrimitiveType::Numb)
+	{
+		if (iequals(type->m_name, "int") or iequals(type->m_name, "positive_int"))
+			return "int";
+
+		if (iequals(type->m_name, "float"))
+			return "float";
+	}
+
+	return "std::string";
+}
+
+} // namespace
+
+void write_category_view(std::ostream &os, const category_validator &cv)
+{
+	auto name = make_identifier(cv.m_name);
+	auto n = cv.m_item_validators.size();
+
+	os << "// --------------------------------------------------------------------\n"
+	   << "// " << cv.m_name << "\n\n"
+	   << "class " << name << "_row : public cif::category_row_view<" << n << ">\n"
+	   << "{\n"
+	   << "  public:\n"
+	   << "\tusing cif::category_row_view<" << n << ">::category_row_view;\n\n";
+
+	std::set<std::string> used;
+	size_t ix = 0;
+
+	for (auto &iv : cv.m_item_validators)
+	{
+		auto id = make_identifier(iv.m_item_name);
+		while (not used.insert(id).second)
+			id += '_';
+
+		os << "\t" << map_type(iv.m_type) << ' ' << id << "() const { return get<" << map_type(iv.m_type) << ">(" << ix++ << "); }\n";
+	}
+
+	os << "};\n\n"
+	   << "class " << name << "_view : public cif::category_view<" << name << "_row, " << n << ">\n"
+	   << "{\n"
+	   << "  public:\n"
+	   << "\tstatic constexpr std::string_view category_name = \"" << cv.m_name << "\";\n\n"
+	   << "\tstatic constexpr std::array<std::string_view, " << n << "> item_names{\n";
+
+	for (auto &iv : cv.m_item_validators)
+		os << "\t\t\"" << iv.m_item_name << "\",\n";
+
+	os << "\t};\n\n"
+	   << "\t" << name << "_view(const cif::category &cat)\n"
+	   << "\t\t: cif::category_view<" << name << "_row, " << n << ">(cat, item_names)\n"
+	   << "\t{\n"
+	   << "\t}\n"
+	   << "};\n\n";
+}
+
+} // namespace cif
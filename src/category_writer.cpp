@@ -0,0 +1,296 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/category_writer.hpp"
+
+#include "write_buffer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace cif
+{
+
+category_writer::category_writer(std::ostream &os, std::string_view name, std::vector<std::string> items,
+	size_t sample_size)
+	: m_os(os)
+	, m_buffer(std::make_unique<detail::write_buffer>(os))
+	, m_name(name)
+	, m_items(std::move(items))
+	, m_precision(m_items.size(), -1)
+	, m_sample_size(std::max<size_t>(sample_size, 1))
+{
+}
+
+category_writer::category_writer(std::ostream &os, std::string_view name, std::vector<std::string> items,
+	std::vector<size_t> widths)
+	: m_os(os)
+	, m_buffer(std::make_unique<detail::write_buffer>(os))
+	, m_name(name)
+	, m_items(std::move(items))
+	, m_widths(std::move(widths))
+	, m_precision(m_items.size(), -1)
+{
+	if (m_widths.size() != m_items.size())
+		throw std::runtime_error("The number of widths does not match the number of items for category " + m_name);
+
+	// The width of a column includes the space separating it from the next
+	for (auto &w : m_widths)
+		w = std::max<size_t>(w + 1, 2);
+}
+
+category_writer::~category_writer()
+{
+	// Errors cannot be reported from a destructor, call close to see them
+	try
+	{
+		close();
+	}
+	catch (const std::exception &ex)
+	{
+		if (VERBOSE > 0)
+			std::cerr << "Error writing category " << m_name << ": " << ex.what() << '\n';
+	}
+}
+
+void category_writer::set_precision(std::string_view item, int precision)
+{
+	auto i = std::find_if(m_items.begin(), m_items.end(), [item](const std::string &name)
+		{ return iequals(name, item); });
+
+	if (i == m_items.end())
+		throw std::runtime_error("Unknown item " + std::string{ item } + " in category " + m_name);
+
+	m_precision[i - m_items.begin()] = precision;
+}
+
+void category_writer::end_row()
+{
+	if (m_closed)
+		throw std::runtime_error("Category " + m_name + " was already closed");
+
+	++m_row_count;
+
+	// The first row is always kept, a category with a single row
+	// is written without a loop_, see write_single_row
+	if (m_header_written)
+		write_row(m_row, m_row_ends.data());
+	else
+	{
+		m_sample += m_row;
+		m_sample_ends.insert(m_sample_ends.end(), m_row_ends.begin(), m_row_ends.end());
+
+		if (m_row_count > 1 and m_row_count >= m_sample_size)
+			write_sample();
+	}
+}
+
+void category_writer::write_header()
+{
+	m_header_written = true;
+
+	m_buffer->append("loop_\n");
+
+	for (auto &item : m_items)
+	{
+		m_buffer->append('_');
+		if (not m_name.empty())
+		{
+			m_buffer->append(m_name);
+			m_buffer->append('.');
+		}
+		m_buffer->append(item);
+		m_buffer->append(" \n");
+	}
+}
+
+void category_writer::write_sample()
+{
+	const size_t n = m_items.size();
+	const size_t rows = n > 0 ? m_sample_ends.size() / n : 0;
+
+	size_t start = 0;
+
+	// Calculate the widths the same way category::write does,
+	// unless they were specified in the constructor
+	const bool calculate_widths = m_widths.empty();
+	if (calculate_widths)
+		m_widths.assign(n, 2);
+
+	for (size_t r = 0; calculate_widths and r < rows; ++r)
+	{
+		auto ends = m_sample_ends.data() + r * n;
+
+		size_t b = 0;
+		for (size_t ix = 0; ix < n; ++ix)
+		{
+			std::string_view s(m_sample.data() + start + b, ends[ix] - b);
+			b = ends[ix];
+
+			if (s.empty())
+				s = "?";
+
+			auto q = detail::get_quoting(s);
+			if (q == detail::value_quoting::text_field)
+				continue;
+
+			size_t l = detail::get_value_length(s, q);
+			if (l <= detail::kMaxLineLength and m_widths[ix] < l + 1)
+				m_widths[ix] = l + 1;
+		}
+
+		start += b;
+	}
+
+	write_header();
+
+	start = 0;
+	for (size_t r = 0; r < rows; ++r)
+	{
+		auto ends = m_sample_ends.data() + r * n;
+		size_t length = n > 0 ? ends[n - 1] : 0;
+
+		write_row({ m_sample.data() + start, length }, ends);
+
+		start += length;
+	}
+
+	m_sample = {};
+	m_sample_ends = {};
+}
+
+void category_writer::write_row(std::string_view text, const size_t *ends)
+{
+	auto &buffer = *m_buffer;
+
+	size_t offset = 0, b = 0;
+
+	for (size_t ix = 0; ix < m_items.size(); ++ix)
+	{
+		auto s = text.substr(b, ends[ix] - b);
+		b = ends[ix];
+
+		// Missing and empty values are written as a question mark
+		if (s.empty())
+			s = "?";
+
+		auto q = detail::get_quoting(s);
+		size_t w = m_widths[ix];
+		size_t l = std::max(detail::get_value_length(s, q), w);
+
+		if (offset + l > detail::kMaxLineLength and offset > 0)
+		{
+			buffer.append('\n');
+			offset = 0;
+		}
+
+		offset = detail::write_value(buffer, s, q, offset, w, false);
+
+		if (offset > detail::kMaxLineLength)
+		{
+			buffer.append('\n');
+			offset = 0;
+		}
+	}
+
+	if (offset > 0)
+		buffer.append('\n');
+
+	buffer.flush_if_full();
+}
+
+void category_writer::write_single_row()
+{
+	auto &buffer = *m_buffer;
+
+	// The same layout as category::write uses for a single row
+	size_t l = 0;
+	for (auto &item : m_items)
+	{
+		size_t item_name_length = m_name.length() + item.length() + 2;
+		if (l < item_name_length)
+			l = item_name_length;
+	}
+
+	l += 3;
+
+	size_t b = 0;
+	for (size_t ix = 0; ix < m_items.size(); ++ix)
+	{
+		auto &item = m_items[ix];
+
+		auto s = std::string_view{ m_sample }.substr(b, m_sample_ends[ix] - b);
+		b = m_sample_ends[ix];
+
+		if (s.empty())
+			s = "?";
+
+		buffer.append('_');
+		if (not m_name.empty())
+		{
+			buffer.append(m_name);
+			buffer.append('.');
+		}
+		buffer.append(item);
+		buffer.pad(l - item.length() - m_name.length() - 2);
+
+		size_t offset = l;
+		if (s.length() + l >= detail::kMaxLineLength)
+		{
+			buffer.append('\n');
+			offset = 0;
+		}
+
+		if (detail::write_value(buffer, s, detail::get_quoting(s), offset, 1, false) != 0)
+			buffer.append('\n');
+	}
+
+	m_sample = {};
+	m_sample_ends = {};
+}
+
+void category_writer::close()
+{
+	if (m_closed)
+		return;
+
+	m_closed = true;
+
+	if (m_row_count == 1)
+		write_single_row();
+	else if (not m_header_written and m_row_count > 0)
+		write_sample();
+
+	if (m_row_count > 0)
+		m_buffer->append("# \n");
+
+	m_buffer->flush();
+
+	if (not m_os)
+		throw std::runtime_error("Error writing category " + m_name);
+}
+
+} // namespace cif
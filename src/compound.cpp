@@ -479,7 +479,7 @@ compound *compound_factory_impl::create(const std::string &id)
 		}
 	}
 	else
-		ccd.reset(new std::ifstream(m_file));
+		ccd.reset(new cif::gzio::ifstream(m_file));
 
 	cif::file file;
 
@@ -506,7 +506,7 @@ compound *compound_factory_impl::create(const std::string &id)
 				throw std::runtime_error("Could not locate the CCD components.cif file, please make sure the software is installed properly and/or use the update-libcifpp-data to fetch the data.");
 		}
 		else
-			ccd.reset(new std::ifstream(m_file));
+			ccd.reset(new cif::gzio::ifstream(m_file));
 	}
 
 	if (cif::VERBOSE > 1)
@@ -58,9 +58,102 @@ bool is_item_type_uchar(const category &cat, std::string_view col)
 	return result;
 }
 
+bool is_first_key_numeric(const category &cat, std::string_view col, bool integral)
+{
+	bool result = false;
+
+	auto cv = cat.get_cat_validator();
+	if (cv != nullptr and not cv->m_keys.empty() and iequals(cv->m_keys.front(), col))
+	{
+		auto iv = cv->get_validator_for_item(col);
+		if (iv != nullptr and iv->m_type != nullptr)
+		{
+			auto type = iv->m_type;
+			// int-range values like 1-3 are numb too, but do not hold integers
+			result = type->m_primitive_type == DDL_PrimitiveType::Numb and
+			         (not integral or (icontains(type->m_name, "int") and not icontains(type->m_name, "range")));
+		}
+	}
+
+	return result;
+}
+
 namespace detail
 {
 
+	void condition_impl::filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const
+	{
+		for (size_t i = 0; i < rows.size(); ++i)
+		{
+			if (selection[i] and not test({ cat, *rows[i] }))
+				selection[i] = false;
+		}
+	}
+
+	// The tight loop for equality tests, empty items match as well
+	// when @a or_empty is true.
+
+	void filter_equals(const category &cat, std::span<const row *const> rows, block_selection &selection,
+		uint16_t item_ix, std::string_view value, bool icase, bool or_empty, const std::optional<row_handle> &single_hit)
+	{
+		if (single_hit.has_value())
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (selection[i] and *single_hit != row_handle{ cat, *rows[i] })
+					selection[i] = false;
+			}
+		}
+		else if (icase)
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (not selection[i])
+					continue;
+
+				auto v = rows[i]->get(item_ix);
+				if (not(iequals(value_text(v), value) or (or_empty and is_empty_value(v))))
+					selection[i] = false;
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (not selection[i])
+					continue;
+
+				auto v = rows[i]->get(item_ix);
+				if (not(value_text(v) == value or (or_empty and is_empty_value(v))))
+					selection[i] = false;
+			}
+		}
+	}
+
+	void key_equals_condition_impl::filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const
+	{
+		filter_equals(cat, rows, selection, m_item_ix, m_value, m_icase, false, m_single_hit);
+	}
+
+	void key_equals_or_empty_condition_impl::filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const
+	{
+		filter_equals(cat, rows, selection, m_item_ix, m_value, m_icase, true, m_single_hit);
+	}
+
+	void key_equals_parameter_condition_impl::filter(const category &cat, std::span<const row *const> rows, block_selection &selection) const
+	{
+		if (m_value.empty() and not m_single_hit.has_value())
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+			{
+				if (selection[i] and not is_empty_value(rows[i]->get(m_item_ix)))
+					selection[i] = false;
+			}
+		}
+		else
+			filter_equals(cat, rows, selection, m_item_ix, m_value, m_icase, false, m_single_hit);
+	}
+
 	condition_impl *key_equals_condition_impl::prepare(const category &c)
 	{
 		m_item_ix = c.get_item_ix(m_item_name);
@@ -76,6 +169,37 @@ namespace detail
 		return this;
 	}
 
+	condition_impl *key_equals_parameter_condition_impl::prepare(const category &c)
+	{
+		// An item that does not exist (yet) should not match the
+		// index of an item added later on
+		m_item_ix = c.has_item(m_item_name) ? c.get_item_ix(m_item_name) : kUnknownItem;
+		m_icase = is_item_type_uchar(c, m_item_name);
+		m_category = &c;
+
+		m_indexed = c.get_cat_validator() != nullptr and
+		            c.key_item_indices().contains(m_item_ix) and
+		            c.key_item_indices().size() == 1;
+
+		return this;
+	}
+
+	void key_equals_parameter_condition_impl::bind(std::span<const std::string_view> values)
+	{
+		if (m_param_ix >= values.size())
+			throw std::runtime_error("No value bound for parameter " + std::to_string(m_param_ix) + " in condition on " + m_item_name);
+
+		m_value.assign(values[m_param_ix]);
+
+		if (m_item_ix == kUnknownItem and m_category->has_item(m_item_name))
+			m_item_ix = m_category->get_item_ix(m_item_name);
+
+		if (m_indexed and not m_value.empty())
+			m_single_hit = (*m_category)[{ { m_item_name, m_value } }];
+		else
+			m_single_hit.reset();
+	}
+
 	bool found_in_range(condition_impl *c, std::vector<and_condition_impl *>::iterator b, std::vector<and_condition_impl *>::iterator e)
 	{
 		bool result = true;
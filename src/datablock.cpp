@@ -26,6 +26,13 @@
 
 #include "cif++/datablock.hpp"
 
+#include "validation_tasks.hpp"
+#include "write_buffer.hpp"
+
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
 namespace cif
 {
 
@@ -63,22 +70,32 @@ bool datablock::is_valid() const
 	if (m_validator == nullptr)
 		throw std::runtime_error("Validator not specified");
 
-	bool result = true;
+	std::vector<detail::validation_task> tasks;
 	for (auto &cat : *this)
-		result = cat.is_valid() and result;
+		cat.add_validation_tasks(tasks, false);
 
-	return result;
+	return detail::run_validation_tasks(tasks);
 }
 
-bool datablock::is_valid()
+bool datablock::is_valid_incremental() const
 {
 	if (m_validator == nullptr)
 		throw std::runtime_error("Validator not specified");
 
-	bool result = true;
+	std::vector<detail::validation_task> tasks;
 	for (auto &cat : *this)
-		result = cat.is_valid() and result;
-	
+		cat.add_validation_tasks(tasks, true);
+
+	return detail::run_validation_tasks(tasks);
+}
+
+bool datablock::is_valid()
+{
+	if (m_validator == nullptr)
+		throw std::runtime_error("Validator not specified");
+
+	bool result = std::as_const(*this).is_valid();
+
 	// Add or remove the audit_conform block here.
 	if (result)
 	{
@@ -106,13 +123,36 @@ bool datablock::is_valid()
 
 bool datablock::validate_links() const
 {
-	bool result = true;
+	for (auto &cat : *this)
+		const_cast<category &>(cat).update_links(*this);
 
+	std::vector<detail::validation_task> tasks;
+	for (auto &cat : *this)
+		tasks.emplace_back([&cat]()
+			{ return cat.validate_links(); });
+
+	return detail::run_validation_tasks(tasks);
+}
+
+bool datablock::validate_links_incremental() const
+{
 	for (auto &cat : *this)
 		const_cast<category &>(cat).update_links(*this);
 
+	std::vector<detail::validation_task> tasks;
+	for (auto &cat : *this)
+		tasks.emplace_back([&cat]()
+			{ return cat.validate_links(true); });
+
+	return detail::run_validation_tasks(tasks);
+}
+
+size_t datablock::row_count() const
+{
+	size_t result = 0;
+
 	for (auto &cat : *this)
-		result = cat.validate_links() and result;
+		result += cat.size();
 
 	return result;
 }
@@ -218,112 +258,114 @@ std::vector<std::string> datablock::get_item_order() const
 	return result;
 }
 
-namespace
+void datablock::write(std::ostream &os) const
 {
-	using elem_t = std::tuple<std::string, int, bool>;
-	using cat_order_t = std::vector<elem_t>;
-	using iter_t = cat_order_t::iterator;
-
-	inline int get_count(iter_t i)
-	{
-		return std::get<1>(*i);
-	}
-
-	inline bool is_on_stack(iter_t i)
-	{
-		return std::get<2>(*i);
-	}
-
-	void calculate_cat_order(cat_order_t &cat_order, iter_t i, const validator &validator)
-	{
-		if (i == cat_order.end() or get_count(i) >= 0)
-			return;
-
-		auto &&[cat, count, on_stack] = *i;
-
-		on_stack = true;
-
-		int parent_count = 0;
-
-		for (auto link : validator.get_links_for_child(cat))
-		{
-			auto ei = std::find_if(cat_order.begin(), cat_order.end(), [parent = link->m_parent_category](elem_t &a)
-				{ return std::get<0>(a) == parent; });
-
-			if (ei == cat_order.end())
-				continue;
+	os << "data_" << m_name << '\n'
+	   << "# \n";
 
-			if (not is_on_stack(ei))
-				calculate_cat_order(cat_order, ei, validator);
+	std::vector<const category *> cats;
 
-			parent_count += get_count(ei);
-		}
+	// mmcif support, sort of. First write the 'entry' Category
+	// and if it exists, _AND_ we have a Validator, write out the
+	// audit_conform record.
 
-		count = parent_count + 1;
-	}
-} // namespace
+	if (auto entry = get("entry"); entry != nullptr)
+		cats.push_back(entry);
 
-void datablock::write(std::ostream &os) const
-{
-	os << "data_" << m_name << '\n'
-	   << "# \n";
+	// If the dictionary declares an audit_conform category, put it in,
+	// but only if it does not exist already!
+	if (auto audit_conform = get("audit_conform"); audit_conform != nullptr)
+		cats.push_back(audit_conform);
 
 	if (m_validator and size() > 0)
 	{
 		// base order on parent child relationships, parents first
 
-		cat_order_t cat_order;
+		std::vector<const category *> others;
+		std::vector<std::string_view> names;
 
 		for (auto &cat : *this)
 		{
 			if (cat.name() == "entry" or cat.name() == "audit_conform")
 				continue;
-			cat_order.emplace_back(cat.name(), -1, false);
+			others.push_back(&cat);
+			names.push_back(cat.name());
 		}
 
-		for (auto i = cat_order.begin(); i != cat_order.end(); ++i)
-			calculate_cat_order(cat_order, i, *m_validator);
+		for (auto ix : m_validator->order_parents_first(names))
+			cats.push_back(others[ix]);
+	}
+	else
+	{
+		for (auto &cat : *this)
+		{
+			if (cat.name() != "entry" and cat.name() != "audit_conform")
+				cats.push_back(&cat);
+		}
+	}
 
-		std::sort(cat_order.begin(), cat_order.end(), [](const elem_t &a, const elem_t &b)
-			{
-			const auto &[cat_a, count_a, on_stack_a] = a;
-			const auto &[cat_b, count_b, on_stack_b] = b;
+	write(os, cats);
+}
 
-			int d = std::get<1>(a) - std::get<1>(b);
-			if (d == 0)
-				d = cat_b.compare(cat_a);
+void datablock::write(std::ostream &os, const std::vector<const category *> &cats) const
+{
+	detail::write_buffer buffer(os);
 
-			return d < 0; });
+	auto write_category = [](detail::write_buffer &b, const category &cat)
+	{
+		if (cat.write_source_text(b))
+			return;
 
-		if (auto entry = get("entry"); entry != nullptr)
-			entry->write(os);
+		std::vector<uint16_t> order(cat.m_items.size());
+		iota(order.begin(), order.end(), static_cast<uint16_t>(0));
+		cat.write(b, order);
+	};
 
-		if (auto audit_conform = get("audit_conform"); audit_conform != nullptr)
-			audit_conform->write(os);
+	if (get_write_thread_count() <= 1)
+	{
+		for (auto cat : cats)
+		{
+			write_category(buffer, *cat);
+			buffer.flush_if_full();
+		}
 
-		for (auto &&[cat, count, on_stack] : cat_order)
-			get(cat)->write(os);
+		buffer.flush();
+		return;
 	}
-	else
+
+	// Runs of small categories are formatted concurrently, each in its own
+	// buffer. Large categories are split in partitions by category::write.
+	for (auto ci = cats.begin(); ci != cats.end();)
 	{
-		// mmcif support, sort of. First write the 'entry' Category
-		// and if it exists, _AND_ we have a Validator, write out the
-		// audit_conform record.
+		auto next = std::find_if(ci, cats.end(), [](const category *cat)
+			{ return cat->size() > detail::kWritePartitionSize; });
+
+		if (next == ci)
+		{
+			write_category(buffer, **ci++);
+			buffer.flush_if_full();
+			continue;
+		}
 
-		if (auto entry = get("entry"); entry != nullptr)
-			entry->write(os);
+		std::vector<detail::write_buffer> buffers(next - ci);
 
-		// If the dictionary declares an audit_conform category, put it in,
-		// but only if it does not exist already!
-		if (auto audit_conform = get("audit_conform"); audit_conform != nullptr)
-			audit_conform->write(os);
+		std::vector<detail::write_task> tasks;
+		for (size_t i = 0; i < buffers.size(); ++i)
+			tasks.emplace_back([&write_category, &buffers, cat = ci[i], i]()
+				{ write_category(buffers[i], *cat); });
 
-		for (auto &cat : *this)
+		detail::run_write_tasks(tasks);
+
+		for (auto &b : buffers)
 		{
-			if (cat.name() != "entry" and cat.name() != "audit_conform")
-				cat.write(os);
+			buffer.append(b);
+			buffer.flush_if_full();
 		}
+
+		ci = next;
 	}
+
+	buffer.flush();
 }
 
 void datablock::write(std::ostream &os, const std::vector<std::string> &item_name_order)
@@ -331,43 +373,38 @@ void datablock::write(std::ostream &os, const std::vector<std::string> &item_nam
 	os << "data_" << m_name << '\n'
 	   << "# \n";
 
+	// Split each item name once and collect the items per category,
+	// in the order in which the categories appear first
 	std::vector<std::string> cat_order{ "entry", "audit_conform" };
-	for (auto &o : item_name_order)
-	{
-		std::string cat_name, item_name;
-		std::tie(cat_name, item_name) = split_item_name(o);
-		if (find_if(cat_order.rbegin(), cat_order.rend(), [cat_name](const std::string &s) -> bool
-				{ return iequals(cat_name, s); }) == cat_order.rend())
-			cat_order.push_back(cat_name);
-	}
+	std::vector<std::vector<std::string>> cat_items(cat_order.size());
+	std::unordered_map<std::string, size_t, ihash, iequal_to> cat_ix{ { "entry", 0 }, { "audit_conform", 1 } };
 
-	for (auto &c : cat_order)
+	for (auto &o : item_name_order)
 	{
-		auto cat = get(c);
-		if (cat == nullptr)
-			continue;
+		auto [cat_name, item_name] = split_item_name(o);
 
-		std::vector<std::string> items;
-		for (auto &o : item_name_order)
+		auto [i, inserted] = cat_ix.emplace(cat_name, cat_order.size());
+		if (inserted)
 		{
-			std::string cat_name, item_name;
-			std::tie(cat_name, item_name) = split_item_name(o);
-
-			if (cat_name == c)
-				items.push_back(item_name);
+			cat_order.push_back(cat_name);
+			cat_items.emplace_back();
 		}
 
-		cat->write(os, items);
+		cat_items[i->second].push_back(std::move(item_name));
+	}
+
+	for (size_t ix = 0; ix < cat_order.size(); ++ix)
+	{
+		auto cat = get(cat_order[ix]);
+		if (cat != nullptr)
+			cat->write(os, cat_items[ix]);
 	}
 
 	// for any Category we missed in the catOrder
 	for (auto &cat : *this)
 	{
-		if (find_if(cat_order.begin(), cat_order.end(), [&](const std::string &s) -> bool
-				{ return iequals(cat.name(), s); }) != cat_order.end())
-			continue;
-
-		cat.write(os);
+		if (not cat_ix.contains(cat.name()))
+			cat.write(os);
 	}
 }
 
@@ -24,12 +24,75 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "cif++/bcif.hpp"
 #include "cif++/file.hpp"
 #include "cif++/gzio.hpp"
 
+#include "binary_io.hpp"
+
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CIFPP_HAVE_MMAP 1
+#endif
+
 namespace cif
 {
 
+// --------------------------------------------------------------------
+
+namespace detail
+{
+	mapped_file::mapped_file(const std::filesystem::path &p)
+	{
+#if CIFPP_HAVE_MMAP
+		int fd = ::open(p.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error("Could not open file '" + p.string() + '\'');
+
+		struct stat st;
+		if (::fstat(fd, &st) == 0 and st.st_size > 0)
+		{
+			void *ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (ptr != MAP_FAILED)
+			{
+				m_data = static_cast<const char *>(ptr);
+				m_size = st.st_size;
+			}
+		}
+
+		::close(fd);
+
+		if (m_data != nullptr)
+			return;
+#endif
+
+		// No memory mapping, read the file instead
+		std::ifstream in(p, std::ios::binary);
+		if (not in.is_open())
+			throw std::runtime_error("Could not open file '" + p.string() + '\'');
+
+		m_buffer.assign(std::istreambuf_iterator<char>(in), {});
+		m_data = m_buffer.data();
+		m_size = m_buffer.length();
+	}
+
+	mapped_file::~mapped_file()
+	{
+#if CIFPP_HAVE_MMAP
+		if (m_data != nullptr and m_data != m_buffer.data())
+			::munmap(const_cast<char *>(m_data), m_size);
+#endif
+	}
+} // namespace detail
+
 // --------------------------------------------------------------------
 void file::set_validator(const validator *v)
 {
@@ -38,6 +101,20 @@ void file::set_validator(const validator *v)
 		db.set_validator(v);
 }
 
+void file::restore_validator(const validator *v) noexcept
+{
+	try
+	{
+		set_validator(v);
+	}
+	catch (...)
+	{
+		// The data read so far does not fit the validator, e.g. because
+		// of missing key items. Keep it for the file nonetheless.
+		m_validator = v;
+	}
+}
+
 bool file::is_valid() const
 {
 	if (m_validator == nullptr)
@@ -190,13 +267,66 @@ void file::load(const std::filesystem::path &p)
 	}
 }
 
+namespace
+{
+	// A streambuf over text that is kept in memory
+	struct source_text_buf : public std::streambuf
+	{
+		source_text_buf(const std::string &text)
+		{
+			auto data = const_cast<char *>(text.data());
+			this->setg(data, data, data + text.length());
+		}
+	};
+
+	// Parse the text in @a is into @a f. When @a keep_source_text is true the
+	// data is read in memory first and each category refers to its part of it.
+	// Values are validated using @a v if it is not null. Returns false if
+	// invalid values were found.
+	bool parse_text(std::istream &is, file &f, bool keep_source_text, const validator *v, bool fail_fast)
+	{
+		if (not keep_source_text)
+		{
+			parser p(is, f);
+			p.set_validator(v, fail_fast);
+			p.parse_file();
+			return p.values_are_valid();
+		}
+
+		auto text = std::make_shared<std::string>();
+
+		char block[65536];
+		while (is.read(block, sizeof(block)) or is.gcount() > 0)
+			text->append(block, is.gcount());
+
+		source_text_buf buffer(*text);
+		std::istream in(&buffer);
+
+		parser p(in, f);
+		p.set_validator(v, fail_fast);
+		p.set_source_text(text);
+		p.parse_file();
+		return p.values_are_valid();
+	}
+} // namespace
+
 void file::load(std::istream &is)
 {
 	auto saved = m_validator;
 	set_validator(nullptr);
 
-	parser p(is, *this);
-	p.parse_file();
+	try
+	{
+		if (bcif::is_bcif(is))
+			bcif::read(is, *this);
+		else
+			parse_text(is, *this, m_keep_source_text, nullptr, false);
+	}
+	catch (...)
+	{
+		restore_validator(saved);
+		throw;
+	}
 
 	if (saved != nullptr)
 		set_validator(saved);
@@ -204,10 +334,123 @@ void file::load(std::istream &is)
 		load_dictionary();
 }
 
+bool file::load(const std::filesystem::path &p, load_validation validation)
+{
+	gzio::ifstream in(p);
+	if (not in.is_open())
+		throw std::runtime_error("Could not open file '" + p.string() + '\'');
+
+	try
+	{
+		return load(in, validation);
+	}
+	catch (const validation_exception &)
+	{
+		throw;
+	}
+	catch (const std::exception &)
+	{
+		throw_with_nested(std::runtime_error("Error reading file '" + p.string() + '\''));
+	}
+}
+
+namespace
+{
+	/// Validate each value in @a f against its item validator in @a v,
+	/// reporting invalid values the same way the parser does.
+	bool validate_values(const file &f, const validator &v, bool fail_fast)
+	{
+		bool result = true;
+
+		for (auto &db : f)
+		{
+			for (auto &cat : db)
+			{
+				auto cv = v.get_validator_for_category(cat.name());
+				if (cv == nullptr)
+					continue;
+
+				const size_t n = cat.get_items().size();
+				for (uint16_t ix = 0; ix < n; ++ix)
+				{
+					auto item = cat.get_item_name(ix);
+					auto iv = cv->get_validator_for_item(item);
+					if (iv == nullptr)
+						continue;
+
+					for (auto r : cat)
+					{
+						std::error_code ec;
+						if (not iv->validate_value(r[ix].text(), ec))
+						{
+							result = false;
+							v.report_error(ec, cat.name(), item, fail_fast);
+						}
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+} // namespace
+
+bool file::load(std::istream &is, load_validation validation)
+{
+	if (validation == load_validation::none)
+	{
+		load(is);
+		return true;
+	}
+
+	if (m_validator == nullptr)
+		throw std::runtime_error("No validator specified");
+
+	auto saved = m_validator;
+	set_validator(nullptr);
+
+	bool result;
+
+	try
+	{
+		if (bcif::is_bcif(is))
+		{
+			// BinaryCIF is not parsed, validate the values after reading
+			bcif::read(is, *this);
+			result = validate_values(*this, *saved, validation == load_validation::fail_fast);
+		}
+		else
+			result = parse_text(is, *this, m_keep_source_text, saved, validation == load_validation::fail_fast);
+	}
+	catch (...)
+	{
+		restore_validator(saved);
+		throw;
+	}
+
+	set_validator(saved);
+
+	return result;
+}
+
 void file::save(const std::filesystem::path &p) const
 {
-	gzio::ofstream outFile(p);
-	save(outFile);
+	save(p, gzio::compression_options{});
+}
+
+void file::save(const std::filesystem::path &p, const gzio::compression_options &options) const
+{
+	gzio::ofstream outFile(p, options);
+
+	// Write BinaryCIF for files named .bcif, possibly followed by a compression extension
+	auto ext = p.extension();
+	if (ext == ".gz" or ext == ".zst" or ext == ".lz4")
+		ext = p.stem().extension();
+
+	if (ext == ".bcif")
+		bcif::write(outFile, *this);
+	else
+		save(outFile);
 }
 
 void file::save(std::ostream &os) const
@@ -219,4 +462,194 @@ void file::save(std::ostream &os) const
 		db.write(os);
 }
 
-} // namespace cif
\ No newline at end of file
+// --------------------------------------------------------------------
+// Snapshots, see binary_io.hpp for the encoding of integers and strings.
+// The header contains the format version and a checksum over the payload.
+// The values of each item are stored as a column, an array of offsets
+// followed by the concatenated text of the values. The columns are used
+// in place, from the memory mapped file.
+
+namespace
+{
+	const char kSnapshotMagic[8] = { 'C', 'I', 'F', 'P', 'P', 'S', 'N', 'P' };
+	const uint32_t kSnapshotVersion = 1;
+	const size_t kSnapshotHeaderSize = sizeof(kSnapshotMagic) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+} // namespace
+
+void file::save_snapshot(const std::filesystem::path &p) const
+{
+	std::ostringstream payload;
+	detail::binary_writer w(payload);
+
+	w.write(static_cast<uint32_t>(size()));
+	for (auto &db : *this)
+	{
+		w.write(db.name());
+		w.write(static_cast<uint32_t>(db.size()));
+
+		for (auto &cat : db)
+		{
+			const size_t n = cat.get_items().size();
+
+			w.write(cat.name());
+			w.write(static_cast<uint32_t>(n));
+			for (uint16_t ix = 0; ix < n; ++ix)
+				w.write(cat.get_item_name(ix));
+			w.write(static_cast<uint32_t>(cat.size()));
+
+			std::vector<uint32_t> offsets;
+			std::string text;
+
+			for (uint16_t ix = 0; ix < n; ++ix)
+			{
+				offsets.assign(1, 0);
+				text.clear();
+
+				for (auto r : cat)
+				{
+					text += r[ix].text();
+					if (text.length() > std::numeric_limits<uint32_t>::max())
+						throw std::runtime_error("Too much data in " + cat.name() + " to write a snapshot");
+					offsets.push_back(static_cast<uint32_t>(text.length()));
+				}
+
+				payload.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+				payload.write(text.data(), text.length());
+			}
+		}
+	}
+
+	auto data = std::move(payload).str();
+
+	// Write to a temporary file first, readers should never see a partial snapshot
+	auto tmp_file = p;
+	tmp_file += "." + std::to_string(std::random_device{}()) + ".tmp";
+
+	{
+		std::ofstream out(tmp_file, std::ios::binary);
+		if (not out.is_open())
+			throw std::runtime_error("Could not create file '" + tmp_file.string() + '\'');
+
+		detail::binary_writer hw(out);
+
+		out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+		hw.write(detail::kBinaryByteOrder);
+		hw.write(kSnapshotVersion);
+		hw.write(detail::checksum(data));
+		hw.write(static_cast<uint64_t>(data.length()));
+		out.write(data.data(), data.length());
+
+		if (not out.good())
+		{
+			out.close();
+			std::filesystem::remove(tmp_file);
+			throw std::runtime_error("Error writing snapshot '" + p.string() + '\'');
+		}
+	}
+
+	std::filesystem::rename(tmp_file, p);
+}
+
+bool file::open_snapshot(const std::filesystem::path &p)
+{
+	// A missing or unreadable snapshot is reported like an invalid one,
+	// the caller should load the original data instead
+	std::unique_ptr<detail::mapped_file> mf;
+	try
+	{
+		mf = std::make_unique<detail::mapped_file>(p);
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
+
+	auto data = mf->data();
+
+	if (data.length() < kSnapshotHeaderSize or
+		data.compare(0, sizeof(kSnapshotMagic), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0)
+		return false;
+
+	detail::binary_reader hr(data.substr(sizeof(kSnapshotMagic), kSnapshotHeaderSize - sizeof(kSnapshotMagic)));
+
+	if (hr.read<uint32_t>() != detail::kBinaryByteOrder or
+		hr.read<uint32_t>() != kSnapshotVersion)
+		return false;
+
+	auto checksum = hr.read<uint64_t>();
+	auto length = hr.read<uint64_t>();
+
+	auto payload = data.substr(kSnapshotHeaderSize);
+	if (payload.length() != length or detail::checksum(payload) != checksum)
+		return false;
+
+	file result;
+	detail::binary_reader r(payload);
+
+	for (auto ndb = r.read<uint32_t>(); ndb > 0; --ndb)
+	{
+		auto &&[dbi, ignore] = result.emplace(r.read_string());
+
+		for (auto ncat = r.read<uint32_t>(); ncat > 0; --ncat)
+		{
+			auto &&[ci, ignore] = dbi->emplace(r.read_string());
+			auto &cat = *ci;
+
+			std::vector<uint16_t> ix;
+			for (auto nitem = r.read<uint32_t>(); nitem > 0; --nitem)
+				ix.push_back(cat.add_item(r.read_string()));
+
+			size_t row_count = r.read<uint32_t>();
+
+			std::vector<std::tuple<const char *, std::string_view>> columns;
+			for (size_t k = 0; k < ix.size(); ++k)
+			{
+				auto offsets = r.read_bytes((row_count + 1) * sizeof(uint32_t)).data();
+
+				uint32_t text_length;
+				std::memcpy(&text_length, offsets + row_count * sizeof(uint32_t), sizeof(uint32_t));
+
+				columns.emplace_back(offsets, r.read_bytes(text_length));
+			}
+
+			for (size_t i = 0; i < row_count; ++i)
+			{
+				cat.emplace({});
+				auto row = cat.back();
+
+				// assign the last item first, the row is then allocated only once
+				for (size_t k = ix.size(); k-- > 0;)
+				{
+					auto &&[offsets, text] = columns[k];
+
+					uint32_t b, e;
+					std::memcpy(&b, offsets + i * sizeof(uint32_t), sizeof(uint32_t));
+					std::memcpy(&e, offsets + (i + 1) * sizeof(uint32_t), sizeof(uint32_t));
+
+					if (b > e or e > text.length())
+						throw std::runtime_error("Invalid offset in snapshot '" + p.string() + '\'');
+
+					if (b < e)
+						row.assign(ix[k], text.substr(b, e - b), false, false);
+				}
+			}
+		}
+	}
+
+	if (not r.at_end())
+		throw std::runtime_error("Snapshot '" + p.string() + "' contains trailing data");
+
+	// Attach the validator to the new data first, the swap is then the last
+	// step and this file is left untouched when that fails
+	if (m_validator != nullptr)
+		result.set_validator(m_validator);
+	else
+		result.load_dictionary();
+
+	this->swap(result);
+	std::swap(m_validator, result.m_validator);
+
+	return true;
+}
+
+} // namespace cif
@@ -1828,24 +1828,24 @@ void structure::remove_atom(atom &a, bool removeFromResidue)
 
 		for (std::string prefix : { "ptnr1_", "ptnr2_", "pdbx_ptnr3_" })
 		{
-			if (a.get_label_seq_id() == 0)
-				cond = std::move(cond) or (
-					cif::key(prefix + "label_asym_id") == a.get_label_asym_id() and
-					cif::key(prefix + "label_seq_id") == null and
-					cif::key(prefix + "auth_seq_id") == a.get_auth_seq_id() and
-					cif::key(prefix + "label_atom_id") == a.get_label_atom_id()
-				);
-			else
-				cond = std::move(cond) or (
-					cif::key(prefix + "label_asym_id") == a.get_label_asym_id() and
-					cif::key(prefix + "label_seq_id") == a.get_label_seq_id() and
-					cif::key(prefix + "auth_seq_id") == a.get_auth_seq_id() and
-					cif::key(prefix + "label_atom_id") == a.get_label_atom_id()
-				);
+			cond = std::move(cond) or (
+				cif::key(prefix + "label_asym_id") == parameter(0) and
+				cif::key(prefix + "label_seq_id") == parameter(1) and
+				cif::key(prefix + "auth_seq_id") == parameter(2) and
+				cif::key(prefix + "label_atom_id") == parameter(3)
+			);
 		}
 
-		if (cond)
-			structConn.erase(std::move(cond));
+		// Prepared for each atom, preparing is cheap and the items
+		// in struct_conn may have changed since the previous call
+		cond.prepare(structConn);
+
+		// A label_seq_id of zero means it is null
+		int seq_id = a.get_label_seq_id();
+
+		structConn.erase(cond.bind(a.get_label_asym_id(),
+			seq_id == 0 ? std::string{} : std::to_string(seq_id),
+			a.get_auth_seq_id(), a.get_label_atom_id()));
 
 		atomSite.erase(ri);
 		break;
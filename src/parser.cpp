@@ -228,10 +228,15 @@ int sac_parser::get_next_char()
 		m_token_buffer.push_back(0);
 	else
 	{
+		++m_offset;
+
 		if (result == '\r')
 		{
 			if (m_source.sgetc() == '\n')
+			{
 				m_source.sbumpc();
+				++m_offset;
+			}
 
 			++m_line_nr;
 			result = '\n';
@@ -260,6 +265,8 @@ void sac_parser::retract()
 
 		if (m_source.sputbackc(ch) == std::char_traits<char>::eof())
 			throw std::runtime_error("putback failure");
+
+		--m_offset;
 	}
 
 	m_token_buffer.pop_back();
@@ -281,6 +288,9 @@ sac_parser::CIFToken sac_parser::get_next_token()
 
 	while (result == CIFToken::UNKNOWN)
 	{
+		if (state == State::Start)
+			m_token_start = m_offset;
+
 		auto ch = get_next_char();
 
 		switch (state)
@@ -730,6 +740,8 @@ void sac_parser::parse_file()
 				break;
 		}
 	}
+
+	produce_end_of_file();
 }
 
 void sac_parser::parse_global()
@@ -755,6 +767,7 @@ void sac_parser::parse_datablock()
 			{
 				cat = kUnitializedCategory; // should start a new category
 
+				auto loop_start = m_token_start;
 				match(CIFToken::LOOP);
 
 				std::vector<std::string> item_names;
@@ -766,6 +779,7 @@ void sac_parser::parse_datablock()
 
 					if (cat == kUnitializedCategory)
 					{
+						m_category_start = loop_start;
 						produce_category(catName);
 						cat = catName;
 					}
@@ -799,6 +813,7 @@ void sac_parser::parse_datablock()
 
 				if (not iequals(cat, catName))
 				{
+					m_category_start = m_token_start;
 					produce_category(catName);
 					cat = catName;
 					produce_row();
@@ -835,6 +850,8 @@ void parser::produce_datablock(std::string_view name)
 	if (VERBOSE >= 4)
 		std::cerr << "producing data_" << name << '\n';
 
+	end_source_range(m_token_start);
+
 	const auto &[iter, ignore] = m_file.emplace(name);
 	m_datablock = &(*iter);
 }
@@ -844,8 +861,22 @@ void parser::produce_category(std::string_view name)
 	if (VERBOSE >= 4)
 		std::cerr << "producing category " << name << '\n';
 
-	const auto &[cat, ignore] = m_datablock->emplace(name);
+	end_source_range(m_category_start);
+
+	const auto &[cat, is_new] = m_datablock->emplace(name);
 	m_category = &*cat;
+
+	// A category that is spread over the data cannot be written verbatim
+	if (not is_new)
+		m_category->drop_source_text();
+	else if (m_source_text)
+	{
+		m_source_category = m_category;
+		m_source_start = m_category_start;
+	}
+
+	if (m_validator != nullptr)
+		m_cat_validator = m_validator->get_validator_for_category(name);
 }
 
 void parser::produce_row()
@@ -870,6 +901,34 @@ void parser::produce_item(std::string_view category, std::string_view item, std:
 		error("inconsistent categories in loop_");
 
 	m_row[item] = m_token_value;
+
+	if (m_cat_validator != nullptr)
+	{
+		auto iv = m_cat_validator->get_validator_for_item(item);
+
+		std::error_code ec;
+		if (iv != nullptr and not iv->validate_value(value, ec))
+		{
+			m_values_are_valid = false;
+			m_validator->report_error(ec, category, item, m_fail_fast);
+		}
+	}
+}
+
+void parser::produce_end_of_file()
+{
+	end_source_range(m_offset);
+}
+
+void parser::end_source_range(size_t end)
+{
+	if (m_source_category != nullptr and m_source_start <= end and end <= m_source_text->length())
+	{
+		m_source_category->set_source_text(m_source_text,
+			std::string_view(*m_source_text).substr(m_source_start, end - m_source_start));
+	}
+
+	m_source_category = nullptr;
 }
 
 } // namespace cif
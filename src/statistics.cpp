@@ -0,0 +1,181 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/statistics.hpp"
+#include "cif++/text.hpp"
+
+#include <bit>
+#include <cmath>
+
+namespace cif
+{
+
+namespace
+{
+	// FNV-1a followed by the splitmix64 finalizer, HyperLogLog
+	// needs all bits of the hash to be well distributed
+	uint64_t hash_value(std::string_view value)
+	{
+		uint64_t h = 14695981039346656037ULL;
+		for (unsigned char ch : value)
+		{
+			h ^= ch;
+			h *= 1099511628211ULL;
+		}
+
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+
+		return h;
+	}
+
+	// Parse @a value as a number, accepting a standard uncertainty suffix like 1.23(4)
+	bool parse_number(std::string_view value, double &v)
+	{
+		auto b = value.data();
+		auto e = value.data() + value.length();
+
+		if (b + 1 < e and *b == '+' and std::isdigit(static_cast<unsigned char>(b[1])))
+			++b;
+
+		auto r = selected_charconv<double>::from_chars(b, e, v);
+		if (r.ec != std::errc())
+			return false;
+
+		return r.ptr == e or (*r.ptr == '(' and e[-1] == ')');
+	}
+} // namespace
+
+// --------------------------------------------------------------------
+
+void hyperloglog::add(std::string_view value)
+{
+	if (m_registers.empty())
+		m_registers.resize(kRegisterCount);
+
+	auto h = hash_value(value);
+	auto ix = h >> (64 - kPrecision);
+	auto rank = static_cast<uint8_t>(std::countl_zero((h << kPrecision) | (uint64_t{ 1 } << (kPrecision - 1))) + 1);
+
+	if (m_registers[ix] < rank)
+		m_registers[ix] = rank;
+}
+
+void hyperloglog::merge(const hyperloglog &rhs)
+{
+	if (rhs.m_registers.empty())
+		return;
+
+	if (m_registers.empty())
+		m_registers.resize(kRegisterCount);
+
+	for (size_t i = 0; i < kRegisterCount; ++i)
+	{
+		if (m_registers[i] < rhs.m_registers[i])
+			m_registers[i] = rhs.m_registers[i];
+	}
+}
+
+size_t hyperloglog::estimate() const
+{
+	if (m_registers.empty())
+		return 0;
+
+	const double m = kRegisterCount;
+	const double alpha = 0.7213 / (1 + 1.079 / m);
+
+	double sum = 0;
+	size_t zeros = 0;
+
+	for (auto r : m_registers)
+	{
+		sum += std::ldexp(1.0, -r);
+		if (r == 0)
+			++zeros;
+	}
+
+	double result = alpha * m * m / sum;
+
+	// small range correction, use linear counting
+	if (result <= 2.5 * m and zeros > 0)
+		result = m * std::log(m / zeros);
+
+	return static_cast<size_t>(std::llround(result));
+}
+
+// --------------------------------------------------------------------
+
+namespace detail
+{
+	void item_counters::add(std::string_view value)
+	{
+		++m_value_count;
+
+		if (value == ".")
+			++m_null_count;
+		else if (value.empty() or value == "?")
+			++m_unknown_count;
+		else
+		{
+			m_distinct.add(value);
+
+			double v;
+			if (parse_number(value, v))
+			{
+				if (m_numeric_count++ == 0)
+					m_min = m_max = v;
+				else if (v < m_min)
+					m_min = v;
+				else if (v > m_max)
+					m_max = v;
+			}
+		}
+	}
+
+	void item_counters::remove(std::string_view value)
+	{
+		--m_value_count;
+
+		if (value == ".")
+			--m_null_count;
+		else if (value.empty() or value == "?")
+			--m_unknown_count;
+		else
+		{
+			// The sketch cannot forget a value
+			m_stale = true;
+
+			double v;
+			if (parse_number(value, v))
+				--m_numeric_count;
+		}
+	}
+} // namespace detail
+
+} // namespace cif
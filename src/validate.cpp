@@ -29,9 +29,21 @@
 #include "cif++/gzio.hpp"
 #include "cif++/utilities.hpp"
 
+#include "binary_io.hpp"
+#include "validation_tasks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
 
 // The validator depends on regular expressions. Unfortunately,
 // the implementation of std::regex in g++ is buggy and crashes
@@ -65,13 +77,239 @@ validation_exception::validation_exception(std::error_code ec, std::string_view
 }
 
 // --------------------------------------------------------------------
+// Most values are validated against a handful of simple regular expressions
+// for numbers, dates and tokens made up of a set of characters. Matching
+// these with the regex engine is slow, so these are recognized and matched
+// using hand written code instead. The regex remains the fallback.
+
+namespace
+{
+	bool is_digit(char ch) { return ch >= '0' and ch <= '9'; }
+	bool is_alnum(char ch) { return is_digit(ch) or (ch >= 'a' and ch <= 'z') or (ch >= 'A' and ch <= 'Z'); }
+
+	// Skip over digits starting at @a i, returns the number of digits skipped
+	size_t skip_digits(std::string_view s, size_t &i)
+	{
+		size_t n = 0;
+		while (i < s.length() and is_digit(s[i]))
+			++i, ++n;
+		return n;
+	}
+
+	// [+-]?[0-9]+
+	bool match_int(std::string_view s)
+	{
+		size_t i = 0;
+		if (i < s.length() and (s[i] == '+' or s[i] == '-'))
+			++i;
+		return skip_digits(s, i) > 0 and i == s.length();
+	}
+
+	// [+]?[1-9][0-9]*
+	bool match_positive_int(std::string_view s)
+	{
+		size_t i = 0;
+		if (i < s.length() and s[i] == '+')
+			++i;
+		if (i == s.length() or s[i] < '1' or s[i] > '9')
+			return false;
+		skip_digits(s, i);
+		return i == s.length();
+	}
+
+	// -?(([0-9]+)[.]?|([0-9]*[.][0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?
+	bool match_float(std::string_view s)
+	{
+		size_t i = 0;
+		if (i < s.length() and s[i] == '-')
+			++i;
+
+		size_t n = skip_digits(s, i);
+		if (i < s.length() and s[i] == '.')
+		{
+			++i;
+			n += skip_digits(s, i);
+		}
+
+		if (n == 0)
+			return false;
+
+		if (i < s.length() and s[i] == '(')
+		{
+			++i;
+			if (skip_digits(s, i) == 0 or i == s.length() or s[i] != ')')
+				return false;
+			++i;
+		}
+
+		if (i < s.length() and (s[i] == 'e' or s[i] == 'E'))
+		{
+			++i;
+			if (i < s.length() and (s[i] == '+' or s[i] == '-'))
+				++i;
+			if (skip_digits(s, i) == 0)
+				return false;
+		}
+
+		return i == s.length();
+	}
+
+	// [0-9]?[0-9]?[0-9][0-9]-[0-9]?[0-9]-[0-9][0-9]
+	bool match_date(std::string_view s)
+	{
+		size_t i = 0, n = skip_digits(s, i);
+		if (n < 2 or n > 4 or i == s.length() or s[i++] != '-')
+			return false;
+
+		n = skip_digits(s, i);
+		if (n < 1 or n > 2 or i == s.length() or s[i++] != '-')
+			return false;
+
+		return skip_digits(s, i) == 2 and i == s.length();
+	}
+
+	// [+]?[A-Za-z0-9] and [+]?[A-Za-z0-9][A-Za-z0-9]?[A-Za-z0-9]?
+	template <size_t N>
+	bool match_uchar(std::string_view s)
+	{
+		if (not s.empty() and s.front() == '+')
+			s.remove_prefix(1);
+		return not s.empty() and s.length() <= N and std::all_of(s.begin(), s.end(), is_alnum);
+	}
+
+	struct known_pattern
+	{
+		std::string_view m_rx;
+		bool (*m_match)(std::string_view);
+	};
+
+	const known_pattern kKnownPatterns[] = {
+		{ "[+-]?[0-9]+", &match_int },
+		{ "[+]?[1-9][0-9]*", &match_positive_int },
+		{ "-?(([0-9]+)[.]?|([0-9]*[.][0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?", &match_float },
+		{ "[0-9]?[0-9]?[0-9][0-9]-[0-9]?[0-9]-[0-9][0-9]", &match_date },
+		{ "[+]?[A-Za-z0-9]", &match_uchar<1> },
+		{ "[+]?[A-Za-z0-9][A-Za-z0-9]?[A-Za-z0-9]?", &match_uchar<3> },
+	};
+
+	// Values used to check a hand written matcher gives the same result as the regex
+	const std::string_view kProbes[] = {
+		"", "0", "7", "-1", "+1", "+", "-", "12", "012", "+0", "1.", ".5", ".", "-.5", "1.5", "-1.5",
+		"1.5(3)", "1.5(", "1.5()", "(3)", "1e5", "1E-5", "1.5e+05", "1.5(3)e2", "e5", "1e", "1e+",
+		"2024-01-31", "24-1-31", "2024-1-3", "12024-01-31", "2024-01-311", "2024/01/31",
+		"a", "Z", "+a", "ab", "abc", "abcd", "+abc", "+abcd", "a b", "a\nb", "\\n", "x-y", "1,2", " 1", "1 ", "?"
+	};
+
+	// Return true if @a rx consists of a single bracket expression or a
+	// dot followed by a * or + and nothing else.
+	bool is_single_set(std::string_view rx)
+	{
+		if (rx.length() < 2 or (rx.back() != '*' and rx.back() != '+'))
+			return false;
+
+		rx.remove_suffix(1);
+
+		if (rx == ".")
+			return true;
+
+		if (rx.front() != '[' or rx.back() != ']')
+			return false;
+
+		size_t i = 1;
+		if (i < rx.length() and rx[i] == '^')
+			++i;
+		if (i < rx.length() and rx[i] == ']')
+			++i;
+
+		while (i < rx.length() and rx[i] != ']')
+		{
+			// character classes, equivalence classes and collating symbols
+			if (rx[i] == '[' and i + 1 < rx.length() and (rx[i + 1] == ':' or rx[i + 1] == '=' or rx[i + 1] == '.'))
+			{
+				auto e = rx.find(std::string{ rx[i + 1], ']' }, i + 2);
+				if (e == std::string_view::npos)
+					return false;
+				i = e + 2;
+			}
+			else
+				++i;
+		}
+
+		return i == rx.length() - 1;
+	}
+} // namespace
 
 struct regex_impl : public regex
 {
 	regex_impl(std::string_view rx)
 		: regex(rx.begin(), rx.end(), regex::extended | regex::optimize)
+		, m_source(rx)
 	{
+		if (is_single_set(rx))
+		{
+			// Ask the regex engine which characters are allowed
+			for (int ch = 0; ch < 256; ++ch)
+			{
+				char c = static_cast<char>(ch);
+				m_allowed[ch] = regex_match(&c, &c + 1, static_cast<const regex &>(*this));
+			}
+
+			m_allow_empty = rx.back() == '*';
+			m_kind = kind::char_set;
+		}
+		else
+		{
+			for (auto &kp : kKnownPatterns)
+			{
+				if (kp.m_rx != rx)
+					continue;
+
+				// Make sure the hand written code gives the same results as the regex engine
+				bool same = std::all_of(std::begin(kProbes), std::end(kProbes), [this, &kp](std::string_view s)
+					{ return kp.m_match(s) == regex_match(s.begin(), s.end(), static_cast<const regex &>(*this)); });
+
+				if (same)
+				{
+					m_match = kp.m_match;
+					m_kind = kind::known;
+				}
+				else if (VERBOSE > 0)
+					std::cerr << "Not using the fast path for regular expression " << rx << '\n';
+
+				break;
+			}
+		}
 	}
+
+	bool match(std::string_view value) const
+	{
+		switch (m_kind)
+		{
+			case kind::char_set:
+				return (m_allow_empty or not value.empty()) and
+				       std::all_of(value.begin(), value.end(), [this](char ch)
+						   { return m_allowed[static_cast<unsigned char>(ch)]; });
+
+			case kind::known:
+				return m_match(value);
+
+			default:
+				return regex_match(value.begin(), value.end(), static_cast<const regex &>(*this));
+		}
+	}
+
+	std::string m_source; // kept for the binary validator cache
+
+	enum class kind
+	{
+		regex,
+		char_set,
+		known
+	} m_kind = kind::regex;
+
+	std::bitset<256> m_allowed;
+	bool m_allow_empty = false;
+	bool (*m_match)(std::string_view) = nullptr;
 };
 
 // --------------------------------------------------------------------
@@ -226,7 +464,7 @@ bool item_validator::validate_value(std::string_view value, std::error_code &ec)
 
 	if (not value.empty() and value != "?" and value != ".")
 	{
-		if (m_type != nullptr and not regex_match(value.begin(), value.end(), *m_type->m_rx))
+		if (m_type != nullptr and not m_type->m_rx->match(value))
 			ec = make_error_code(validation_error::value_does_not_match_rx);
 		else if (not m_enums.empty() and m_enums.count(std::string{ value }) == 0)
 			ec = make_error_code(validation_error::value_is_not_in_enumeration_list);
@@ -245,17 +483,27 @@ void category_validator::add_item_validator(item_validator &&v)
 	v.m_category = this;
 
 	auto r = m_item_validators.insert(std::move(v));
-	if (not r.second and VERBOSE >= 4)
+	if (r.second)
+		m_item_validator_index.emplace(r.first->m_item_name, &*r.first);
+	else if (VERBOSE >= 4)
 		std::cout << "Could not add validator for item " << v.m_item_name << " to category " << m_name << '\n';
 }
 
 const item_validator *category_validator::get_validator_for_item(std::string_view item_name) const
 {
 	const item_validator *result = nullptr;
-	auto i = m_item_validators.find(item_validator{ std::string(item_name) });
-	if (i != m_item_validators.end())
-		result = &*i;
-	else if (VERBOSE > 4)
+
+	if (m_item_validator_index.empty() and not m_item_validators.empty())
+	{
+		// This is a copy, see item_validator_index
+		auto i = m_item_validators.find(item_validator{ std::string{ item_name } });
+		if (i != m_item_validators.end())
+			result = &*i;
+	}
+	else if (auto i = m_item_validator_index.find(item_name); i != m_item_validator_index.end())
+		result = i->second;
+
+	if (result == nullptr and VERBOSE > 4)
 		std::cout << "No validator for item " << item_name << '\n';
 	return result;
 }
@@ -287,7 +535,9 @@ const item_validator *category_validator::get_validator_for_aliased_item(std::st
 void validator::add_type_validator(type_validator &&v)
 {
 	auto r = m_type_validators.insert(std::move(v));
-	if (not r.second and VERBOSE > 4)
+	if (r.second)
+		m_type_index.emplace(r.first->m_name, &*r.first);
+	else if (VERBOSE > 4)
 		std::cout << "Could not add validator for type " << v.m_name << '\n';
 }
 
@@ -295,9 +545,9 @@ const type_validator *validator::get_validator_for_type(std::string_view typeCod
 {
 	const type_validator *result = nullptr;
 
-	auto i = m_type_validators.find(type_validator{ std::string(typeCode), DDL_PrimitiveType::Char, {} });
-	if (i != m_type_validators.end())
-		result = &*i;
+	auto i = m_type_index.find(typeCode);
+	if (i != m_type_index.end())
+		result = i->second;
 	else if (VERBOSE > 4)
 		std::cout << "No validator for type " << typeCode << '\n';
 	return result;
@@ -306,16 +556,18 @@ const type_validator *validator::get_validator_for_type(std::string_view typeCod
 void validator::add_category_validator(category_validator &&v)
 {
 	auto r = m_category_validators.insert(std::move(v));
-	if (not r.second and VERBOSE > 4)
+	if (r.second)
+		m_category_index.emplace(r.first->m_name, &*r.first);
+	else if (VERBOSE > 4)
 		std::cout << "Could not add validator for category " << v.m_name << '\n';
 }
 
 const category_validator *validator::get_validator_for_category(std::string_view category) const
 {
 	const category_validator *result = nullptr;
-	auto i = m_category_validators.find(category_validator{ std::string(category) });
-	if (i != m_category_validators.end())
-		result = &*i;
+	auto i = m_category_index.find(category);
+	if (i != m_category_index.end())
+		result = i->second;
 	else if (VERBOSE > 4)
 		std::cout << "No validator for category " << category << '\n';
 	return result;
@@ -325,8 +577,18 @@ item_validator *validator::get_validator_for_item(std::string_view item_name) co
 {
 	item_validator *result = nullptr;
 
-	std::string cat, item;
-	std::tie(cat, item) = split_item_name(item_name);
+	// Same as split_item_name, but without copying
+	if (item_name.empty())
+		throw std::runtime_error("empty item_name");
+	if (item_name[0] != '_')
+		throw std::runtime_error("item_name '" + std::string{ item_name } + "' does not start with underscore");
+
+	std::string_view cat, item = item_name.substr(1);
+	if (auto s = item_name.find('.'); s != std::string_view::npos)
+	{
+		cat = item_name.substr(1, s - 1);
+		item = item_name.substr(s + 1);
+	}
 
 	auto *cv = get_validator_for_category(cat);
 	if (cv != nullptr)
@@ -368,41 +630,115 @@ void validator::add_link_validator(link_validator &&v)
 			const_cast<item_validator *>(civ)->m_type = piv->m_type;
 	}
 
-	m_link_validators.emplace_back(std::move(v));
+	add_link(std::move(v));
 }
 
-std::vector<const link_validator *> validator::get_links_for_parent(std::string_view category) const
+void validator::add_link(link_validator &&v)
 {
-	std::vector<const link_validator *> result;
+	auto &l = m_link_validators.emplace_back(std::move(v));
 
-	for (auto &l : m_link_validators)
-	{
-		if (iequals(l.m_parent_category, category))
-			result.push_back(&l);
-	}
+	m_links_by_parent[l.m_parent_category].push_back(&l);
+	m_links_by_child[l.m_child_category].push_back(&l);
 
-	return result;
+	auto parent_nr = get_link_category_nr(l.m_parent_category);
+	auto child_nr = get_link_category_nr(l.m_child_category);
+	m_link_parents[child_nr].push_back(parent_nr);
 }
 
-std::vector<const link_validator *> validator::get_links_for_child(std::string_view category) const
+uint32_t validator::get_link_category_nr(std::string_view category)
+{
+	auto [i, inserted] = m_link_category_nrs.emplace(category, static_cast<uint32_t>(m_link_parents.size()));
+	if (inserted)
+		m_link_parents.emplace_back();
+	return i->second;
+}
+
+std::vector<size_t> validator::order_parents_first(const std::vector<std::string_view> &categories) const
 {
-	std::vector<const link_validator *> result;
+	const size_t n = categories.size();
+	const uint32_t kNoLinks = std::numeric_limits<uint32_t>::max();
+
+	// The link category number for each category and the reverse
+	std::vector<uint32_t> nrs(n, kNoLinks);
+	std::vector<size_t> ix_for_nr(m_link_parents.size(), n);
+
+	for (size_t ix = 0; ix < n; ++ix)
+	{
+		if (auto i = m_link_category_nrs.find(categories[ix]); i != m_link_category_nrs.end())
+		{
+			nrs[ix] = i->second;
+			if (ix_for_nr[i->second] == n)
+				ix_for_nr[i->second] = ix;
+		}
+	}
 
-	for (auto &l : m_link_validators)
+	// The rank is one more than the sum of the ranks of the parents, a parent
+	// that is still being ranked, as in a cycle, counts as minus one. Categories
+	// that end up with a negative rank are ranked again, with their parents done.
+	std::vector<int> rank(n, -1);
+	std::vector<bool> visited(n, false);
+
+	auto calculate_rank = [&](auto &self, size_t ix) -> void
 	{
-		if (iequals(l.m_child_category, category))
-			result.push_back(&l);
+		visited[ix] = true;
+
+		int parent_rank = 0;
+
+		if (nrs[ix] != kNoLinks)
+		{
+			for (auto parent_nr : m_link_parents[nrs[ix]])
+			{
+				auto pix = ix_for_nr[parent_nr];
+				if (pix == n)
+					continue;
+
+				if (not visited[pix])
+					self(self, pix);
+
+				parent_rank += rank[pix];
+			}
+		}
+
+		rank[ix] = parent_rank + 1;
+	};
+
+	for (size_t ix = 0; ix < n; ++ix)
+	{
+		if (rank[ix] < 0)
+			calculate_rank(calculate_rank, ix);
 	}
 
+	std::vector<size_t> result(n);
+	std::iota(result.begin(), result.end(), 0);
+
+	std::sort(result.begin(), result.end(), [&](size_t a, size_t b)
+		{
+			int d = rank[a] - rank[b];
+			if (d == 0)
+				d = categories[b].compare(categories[a]);
+			return d < 0; });
+
 	return result;
 }
 
+std::vector<const link_validator *> validator::get_links_for_parent(std::string_view category) const
+{
+	auto i = m_links_by_parent.find(category);
+	return i == m_links_by_parent.end() ? std::vector<const link_validator *>{} : i->second;
+}
+
+std::vector<const link_validator *> validator::get_links_for_child(std::string_view category) const
+{
+	auto i = m_links_by_child.find(category);
+	return i == m_links_by_child.end() ? std::vector<const link_validator *>{} : i->second;
+}
+
 void validator::report_error(std::error_code ec, bool fatal) const
 {
 	if (m_strict or fatal)
 		throw validation_exception(ec);
 	else
-		std::cerr << ec.message() << '\n';
+		detail::validation_output() << ec.message() << '\n';
 }
 
 void validator::report_error(std::error_code ec, std::string_view category,
@@ -415,7 +751,262 @@ void validator::report_error(std::error_code ec, std::string_view category,
 	if (m_strict or fatal)
 		throw ex;
 	else
-		std::cerr << ex.what() << '\n';
+		detail::validation_output() << ex.what() << '\n';
+}
+
+// --------------------------------------------------------------------
+
+namespace
+{
+	std::atomic<size_t> s_validation_thread_count{ 1 };
+
+	// The output of the validation task running in this thread, if any
+	thread_local std::ostream *t_validation_output = nullptr;
+} // namespace
+
+void set_validation_thread_count(size_t n)
+{
+	if (n == 0)
+		n = std::max(std::thread::hardware_concurrency(), 1U);
+	s_validation_thread_count = n;
+}
+
+size_t get_validation_thread_count()
+{
+	return s_validation_thread_count;
+}
+
+namespace detail
+{
+	std::ostream &validation_output()
+	{
+		return t_validation_output != nullptr ? *t_validation_output : std::cerr;
+	}
+
+	bool run_validation_tasks(const std::vector<validation_task> &tasks)
+	{
+		bool result = true;
+
+		size_t nr_of_threads = std::min(get_validation_thread_count(), tasks.size());
+
+		if (nr_of_threads <= 1 or t_validation_output != nullptr)
+		{
+			for (auto &task : tasks)
+				result = task() and result;
+			return result;
+		}
+
+		struct task_result
+		{
+			std::ostringstream m_output;
+			std::exception_ptr m_exception;
+			bool m_valid = true;
+		};
+
+		std::vector<task_result> results(tasks.size());
+		std::atomic<size_t> next{ 0 };
+
+		auto worker = [&tasks, &results, &next]()
+		{
+			for (size_t ix = next++; ix < tasks.size(); ix = next++)
+			{
+				auto &r = results[ix];
+
+				t_validation_output = &r.m_output;
+
+				try
+				{
+					r.m_valid = tasks[ix]();
+				}
+				catch (...)
+				{
+					r.m_exception = std::current_exception();
+				}
+
+				t_validation_output = nullptr;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < nr_of_threads; ++i)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (auto &t : threads)
+			t.join();
+
+		for (auto &r : results)
+		{
+			std::cerr << r.m_output.str();
+
+			if (r.m_exception)
+				std::rethrow_exception(r.m_exception);
+
+			result = r.m_valid and result;
+		}
+
+		return result;
+	}
+} // namespace detail
+
+// --------------------------------------------------------------------
+// Binary representation of a validator, see binary_io.hpp
+
+namespace
+{
+	const char kValidatorCacheMagic[8] = { 'C', 'I', 'F', 'P', 'P', 'V', 'A', 'L' };
+	const uint32_t kValidatorCacheVersion = 1;
+
+	using detail::binary_reader;
+	using detail::binary_writer;
+} // namespace
+
+uint64_t validator::checksum(std::string_view text)
+{
+	return detail::checksum(text);
+}
+
+void validator::save_binary(std::ostream &os, uint64_t checksum) const
+{
+	binary_writer w(os);
+
+	os.write(kValidatorCacheMagic, sizeof(kValidatorCacheMagic));
+	w.write(detail::kBinaryByteOrder);
+	w.write(kValidatorCacheVersion);
+	w.write(checksum);
+
+	w.write(m_name);
+	w.write(m_version);
+
+	w.write(static_cast<uint32_t>(m_type_validators.size()));
+	for (auto &tv : m_type_validators)
+	{
+		w.write(tv.m_name);
+		w.write(static_cast<uint8_t>(tv.m_primitive_type));
+		w.write(tv.m_rx->m_source);
+	}
+
+	w.write(static_cast<uint32_t>(m_category_validators.size()));
+	for (auto &cv : m_category_validators)
+	{
+		w.write(cv.m_name);
+		w.write_strings(cv.m_keys);
+		w.write_strings(cv.m_groups);
+		w.write_strings(cv.m_mandatory_items);
+
+		w.write(static_cast<uint32_t>(cv.m_item_validators.size()));
+		for (auto &iv : cv.m_item_validators)
+		{
+			w.write(iv.m_item_name);
+			w.write(static_cast<uint8_t>(iv.m_mandatory));
+			w.write(iv.m_type != nullptr ? std::string_view{ iv.m_type->m_name } : std::string_view{});
+			w.write_strings(iv.m_enums);
+			w.write(iv.m_default);
+
+			w.write(static_cast<uint32_t>(iv.m_aliases.size()));
+			for (auto &alias : iv.m_aliases)
+			{
+				w.write(alias.m_name);
+				w.write(alias.m_dict);
+				w.write(alias.m_vers);
+			}
+		}
+	}
+
+	w.write(static_cast<uint32_t>(m_link_validators.size()));
+	for (auto &lv : m_link_validators)
+	{
+		w.write(static_cast<int32_t>(lv.m_link_group_id));
+		w.write(lv.m_parent_category);
+		w.write_strings(lv.m_parent_keys);
+		w.write(lv.m_child_category);
+		w.write_strings(lv.m_child_keys);
+		w.write(lv.m_link_group_label);
+	}
+}
+
+std::optional<validator> validator::load_binary(std::string_view data, uint64_t checksum)
+{
+	if (data.length() < sizeof(kValidatorCacheMagic) or
+		data.compare(0, sizeof(kValidatorCacheMagic), kValidatorCacheMagic, sizeof(kValidatorCacheMagic)) != 0)
+		return {};
+
+	binary_reader r(data.substr(sizeof(kValidatorCacheMagic)));
+
+	if (r.read<uint32_t>() != detail::kBinaryByteOrder or
+		r.read<uint32_t>() != kValidatorCacheVersion or
+		r.read<uint64_t>() != checksum)
+		return {};
+
+	validator result(r.read_string());
+	result.set_version(std::string{ r.read_string() });
+
+	for (auto n = r.read<uint32_t>(); n > 0; --n)
+	{
+		auto name = r.read_string();
+		auto type = static_cast<DDL_PrimitiveType>(r.read<uint8_t>());
+		auto rx = r.read_string();
+
+		result.add_type_validator(type_validator(name, type, rx));
+	}
+
+	for (auto n = r.read<uint32_t>(); n > 0; --n)
+	{
+		std::string cat_name{ r.read_string() };
+
+		category_validator cv{ cat_name };
+		cv.m_keys = r.read_strings<std::vector<std::string>>();
+		cv.m_groups = r.read_strings<iset>();
+		auto mandatory_items = r.read_strings<iset>();
+
+		// Item validators point back to their category validator, so add
+		// them after the category validator has found its place
+		result.add_category_validator(std::move(cv));
+		auto cvp = const_cast<category_validator *>(result.get_validator_for_category(cat_name));
+
+		for (auto ni = r.read<uint32_t>(); ni > 0; --ni)
+		{
+			item_validator iv{ std::string{ r.read_string() } };
+			iv.m_mandatory = r.read<uint8_t>() != 0;
+
+			auto type_name = r.read_string();
+			iv.m_type = type_name.empty() ? nullptr : result.get_validator_for_type(type_name);
+
+			iv.m_enums = r.read_strings<iset>();
+			iv.m_default = r.read_string();
+
+			for (auto na = r.read<uint32_t>(); na > 0; --na)
+			{
+				std::string alias_name{ r.read_string() };
+				std::string dict{ r.read_string() };
+				std::string vers{ r.read_string() };
+				iv.m_aliases.emplace_back(alias_name, dict, vers);
+			}
+
+			cvp->add_item_validator(std::move(iv));
+		}
+
+		cvp->m_mandatory_items = std::move(mandatory_items);
+	}
+
+	for (auto n = r.read<uint32_t>(); n > 0; --n)
+	{
+		link_validator lv;
+		lv.m_link_group_id = r.read<int32_t>();
+		lv.m_parent_category = r.read_string();
+		lv.m_parent_keys = r.read_strings<std::vector<std::string>>();
+		lv.m_child_category = r.read_string();
+		lv.m_child_keys = r.read_strings<std::vector<std::string>>();
+		lv.m_link_group_label = r.read_string();
+
+		result.add_link(std::move(lv));
+	}
+
+	if (not r.at_end())
+		throw std::runtime_error("Validator cache data contains trailing data");
+
+	return result;
 }
 
 // --------------------------------------------------------------------
@@ -426,6 +1017,25 @@ validator_factory &validator_factory::instance()
 	return s_instance;
 }
 
+validator_factory::validator_factory()
+{
+	// The cache is only used when asked for
+	if (auto dir = getenv("LIBCIFPP_CACHE_DIR"); dir != nullptr)
+		m_cache_dir = dir;
+}
+
+void validator_factory::set_cache_directory(const std::filesystem::path &dir)
+{
+	std::lock_guard lock(m_mutex);
+	m_cache_dir = dir;
+}
+
+std::filesystem::path validator_factory::get_cache_directory()
+{
+	std::lock_guard lock(m_mutex);
+	return m_cache_dir;
+}
+
 const validator &validator_factory::operator[](std::string_view dictionary_name)
 {
 	try
@@ -520,7 +1130,74 @@ const validator &validator_factory::operator[](std::string_view dictionary_name)
 
 const validator &validator_factory::construct_validator(std::string_view name, std::istream &is)
 {
-	return m_validators.emplace_back(parse_dictionary(name, is));
+	if (m_cache_dir.empty())
+		return m_validators.emplace_back(parse_dictionary(name, is));
+
+	// The checksum over the dictionary text tells whether the cached version is still valid
+	std::string text;
+	{
+		std::ostringstream s;
+		s << is.rdbuf();
+		text = std::move(s).str();
+	}
+
+	auto checksum = validator::checksum(text);
+
+	// The same dictionary can be requested with or without the .dic extension
+	auto key = std::filesystem::path(name).filename();
+	if (key.extension() == ".dic")
+		key.replace_extension();
+
+	auto cache_file = m_cache_dir / (key.string() + ".validator");
+
+	try
+	{
+		std::ifstream in(cache_file, std::ios::binary);
+		if (in.is_open())
+		{
+			std::string data{ std::istreambuf_iterator<char>(in), {} };
+
+			auto v = validator::load_binary(data, checksum);
+			if (v.has_value())
+				return m_validators.emplace_back(std::move(*v));
+		}
+	}
+	catch (const std::exception &ex)
+	{
+		if (VERBOSE > 0)
+			std::cerr << "Ignoring validator cache " << cache_file << ": " << ex.what() << '\n';
+	}
+
+	std::istringstream dict(std::move(text));
+	auto &result = m_validators.emplace_back(parse_dictionary(name, dict));
+
+	// Write the cache file, using a temporary file to avoid other processes reading a partial one
+	std::error_code ec;
+	std::filesystem::create_directories(m_cache_dir, ec);
+
+	auto tmp_file = cache_file;
+	tmp_file += "." + std::to_string(std::random_device{}()) + ".tmp";
+
+	{
+		std::ofstream out(tmp_file, std::ios::binary);
+		if (out.is_open())
+			result.save_binary(out, checksum);
+		if (not out.good())
+			ec = std::make_error_code(std::errc::io_error);
+	}
+
+	if (not ec)
+		std::filesystem::rename(tmp_file, cache_file, ec);
+
+	if (ec)
+	{
+		std::filesystem::remove(tmp_file, ec);
+
+		if (VERBOSE > 0)
+			std::cerr << "Could not write validator cache " << cache_file << '\n';
+	}
+
+	return result;
 }
 
 } // namespace cif
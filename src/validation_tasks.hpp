@@ -0,0 +1,57 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+/// \file validation_tasks.hpp
+/// Internal support for running validations concurrently
+
+namespace cif::detail
+{
+
+/// A piece of validation work, returns false if the data is not valid
+using validation_task = std::function<bool()>;
+
+/// Run all @a tasks, concurrently when more than one validation thread was
+/// requested. The error reports of each task are collected and written in the
+/// order of the tasks afterwards, so the output is the same as when the tasks
+/// run sequentially. The same goes for exceptions, the exception thrown by the
+/// first failing task is rethrown after writing the output of the tasks before it.
+/// Calls from within a task run sequentially.
+///
+/// @return true if all tasks returned true
+bool run_validation_tasks(const std::vector<validation_task> &tasks);
+
+/// The stream to write validation errors to, this is std::cerr unless
+/// running inside a concurrent validation task.
+std::ostream &validation_output();
+
+} // namespace cif::detail
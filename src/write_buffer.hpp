@@ -0,0 +1,144 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// \file write_buffer.hpp
+/// Internal support for writing categories, formatted into large buffers
+/// that may be filled concurrently
+
+namespace cif::detail
+{
+
+/// The writer formats into a large buffer that is written to the
+/// std::ostream in big blocks, avoiding the overhead of operator<<
+/// for each value and padding. A write_buffer without a stream
+/// keeps all data, it can be appended to another buffer later on.
+class write_buffer
+{
+  public:
+	static constexpr size_t kFlushSize = 1024 * 1024;
+
+	write_buffer() = default;
+
+	write_buffer(std::ostream &os)
+		: m_os(&os)
+	{
+		m_data.reserve(kFlushSize + kFlushSize / 4);
+	}
+
+	write_buffer(write_buffer &&) = default;
+	write_buffer &operator=(write_buffer &&) = default;
+
+	write_buffer(const write_buffer &) = delete;
+	write_buffer &operator=(const write_buffer &) = delete;
+
+	// The owner should call flush to see errors, a destructor cannot
+	// report them. This is a last resort that must not throw.
+	~write_buffer()
+	{
+		try
+		{
+			flush();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void append(std::string_view s) { m_data.append(s); }
+	void append(char ch) { m_data.push_back(ch); }
+	void append(const write_buffer &b) { m_data.append(b.m_data); }
+	void pad(size_t n) { m_data.append(n, ' '); }
+
+	// Called between rows, writes the data once enough is collected
+	void flush_if_full()
+	{
+		if (m_data.size() >= kFlushSize)
+			flush();
+	}
+
+	void flush()
+	{
+		if (m_os != nullptr and not m_data.empty())
+		{
+			m_os->write(m_data.data(), m_data.size());
+			m_data.clear();
+		}
+	}
+
+  private:
+	std::ostream *m_os = nullptr;
+	std::string m_data;
+};
+
+/// The maximum length of a line, longer values are written as text fields
+const uint32_t kMaxLineLength = 132;
+
+/// How a value should be written, decided once per value
+enum class value_quoting : uint8_t
+{
+	none,
+	single_quote,
+	double_quote,
+	text_field,      // the value contains a newline or is too long
+	plain_text_field // the value cannot be quoted
+};
+
+/// Return how @a value should be quoted
+value_quoting get_quoting(std::string_view value);
+
+/// The number of characters a value takes on a line, text fields are
+/// counted as if they were quoted.
+size_t get_value_length(std::string_view value, value_quoting quoting);
+
+/// Write @a value to @a buffer using @a quoting, padded to @a width. The
+/// value starts at position @a offset in the line, the new offset is returned.
+size_t write_value(write_buffer &buffer, std::string_view value, value_quoting quoting, size_t offset, size_t width, bool right_aligned);
+
+/// Categories with more rows than this are formatted in partitions
+/// of this many rows, when more than one write thread was requested
+const size_t kWritePartitionSize = 10000;
+
+/// A piece of formatting work
+using write_task = std::function<void()>;
+
+/// Run all @a tasks, concurrently when more than one write thread was
+/// requested. Exceptions are rethrown afterwards, in the order of the tasks.
+/// Calls from within a task run sequentially.
+void run_write_tasks(const std::vector<write_task> &tasks);
+
+/// Return true if the calling thread is running a write task
+bool in_write_task();
+
+} // namespace cif::detail
@@ -4,6 +4,8 @@
 
 #include <cif++.hpp>
 
+#include <random>
+
 std::filesystem::path gTestDir = std::filesystem::current_path();
 
 int main(int argc, char *argv[])
@@ -40,5 +42,14 @@ int main(int argc, char *argv[])
 
 	cif::compound_factory::instance().push_dictionary(gTestDir / "HEM.cif");
 
-	return session.run();
+	// keep cached validators out of the system directories
+	auto cache_dir = std::filesystem::temp_directory_path() / ("cifpp-test-cache-" + std::to_string(std::random_device{}()));
+	cif::validator_factory::instance().set_cache_directory(cache_dir);
+
+	int result = session.run();
+
+	std::error_code ec;
+	std::filesystem::remove_all(cache_dir, ec);
+
+	return result;
 }
\ No newline at end of file
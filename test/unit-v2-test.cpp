@@ -30,7 +30,10 @@
 
 #include "cif++/dictionary_parser.hpp"
 
+#include "test_views.hpp"
+
 #include <stdexcept>
+#include <thread>
 
 // --------------------------------------------------------------------
 
@@ -1586,7 +1589,7 @@ _cat_2.parent_id3
 
 // --------------------------------------------------------------------
 
-TEST_CASE("d6")
+TEST_CASE("join_1")
 {
 	const char dict[] = R"(
 data_test_dict.dic
@@ -1603,20 +1606,19 @@ data_test_dict.dic
     _item_type_list.code
     _item_type_list.primitive_code
     _item_type_list.construct
-               code      char
+               ucode     uchar
                '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
 
-               text      char
-               '[][ \n\t()_,.;:"&<>/\{}'`~!@#$%?+=*A-Za-z0-9|^-]*'
-
                int       numb
                '[+-]?[0-9]+'
 
 save_cat_1
     _category.description     'A simple test category'
     _category.id              cat_1
-    _category.mandatory_code  yes
+    _category.mandatory_code  no
+    loop_
     _category_key.name        '_cat_1.id'
+                              '_cat_1.name'
     save_
 
 save__cat_1.id
@@ -1626,11 +1628,11 @@ save__cat_1.id
     _item_type.code           int
     save_
 
-save__cat_1.id_2
-    _item.name                '_cat_1.id_2'
+save__cat_1.name
+    _item.name                '_cat_1.name'
     _item.category_id         cat_1
-    _item.mandatory_code      no
-    _item_type.code           int
+    _item.mandatory_code      yes
+    _item_type.code           ucode
     save_
 
 save_cat_2
@@ -1650,15 +1652,15 @@ save__cat_2.id
 save__cat_2.parent_id
     _item.name                '_cat_2.parent_id'
     _item.category_id         cat_2
-    _item.mandatory_code      yes
+    _item.mandatory_code      no
     _item_type.code           int
     save_
 
-save__cat_2.parent_id_2
-    _item.name                '_cat_2.parent_id_2'
+save__cat_2.parent_name
+    _item.name                '_cat_2.parent_name'
     _item.category_id         cat_2
     _item.mandatory_code      no
-    _item_type.code           code
+    _item_type.code           ucode
     save_
 
 loop_
@@ -1667,8 +1669,8 @@ _pdbx_item_linked_group_list.link_group_id
 _pdbx_item_linked_group_list.child_name
 _pdbx_item_linked_group_list.parent_name
 _pdbx_item_linked_group_list.parent_category_id
-cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
-cat_2 1 '_cat_2.parent_id_2' '_cat_1.id_2' cat_1
+cat_2 1 '_cat_2.parent_id'   '_cat_1.id'   cat_1
+cat_2 1 '_cat_2.parent_name' '_cat_1.name' cat_1
 
 loop_
 _pdbx_item_linked_group.category_id
@@ -1698,22 +1700,23 @@ cat_2 1 cat_2:cat_1:1
 data_test
 loop_
 _cat_1.id
-_cat_1.id_2
-1 1
-2 2
-3 ?
+_cat_1.name
+1 aap
+1 noot
+2 aap
+3 mies
 
 loop_
 _cat_2.id
 _cat_2.parent_id
-_cat_2.parent_id_2
- 0 1 1
- 1 1 ?
- 2 ? 1
- 3 ? ?
- 4 2 2
- 5 3 1
- 6 3 ?
+_cat_2.parent_name
+ 1 1 aap
+ 2 1 NOOT
+ 3 2 ?
+ 4 ? aap
+ 5 4 aap
+ 6 ? ?
+ 7 3 Mies
     )";
 
 	// --------------------------------------------------------------------
@@ -1729,80 +1732,2566 @@ _cat_2.parent_id_2
 	std::istream is_data(&data_buffer);
 	f.load(is_data);
 
-	// auto &cat1 = f.front()["cat_1"];
+	auto &cat1 = f.front()["cat_1"];
 	auto &cat2 = f.front()["cat_2"];
 
-	// f.front().validate_links();
-	// REQUIRE(not );
+	auto links = validator.get_links_for_child("cat_2");
+	REQUIRE(links.size() == 1);
 
-	using namespace cif::literals;
+	// child to parent, should be the same as get_parents for each row
 
-	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 0)));
-	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 1)));
-	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 2)));
-	REQUIRE(not	cat2.has_parents(cat2.find1("id"_key == 3)));
-	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 4)));
-	REQUIRE(not	cat2.has_parents(cat2.find1("id"_key == 5)));
-	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 6)));
+	auto j1 = cat2.join(cat1, *links.front());
+	REQUIRE(j1.size() == cat2.size());
+
+	std::map<int, size_t> expected{ { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 2 }, { 5, 0 }, { 6, 0 }, { 7, 1 } };
+
+	for (auto &[r, parents] : j1)
+	{
+		REQUIRE(parents.size() == expected[r["id"].as<int>()]);
+
+		auto p = cat2.get_parents(r, cat1);
+		std::sort(p.begin(), p.end(), [](cif::row_handle a, cif::row_handle b) { return a.get<std::string>("name") < b.get<std::string>("name"); });
+		std::sort(parents.begin(), parents.end(), [](cif::row_handle a, cif::row_handle b) { return a.get<std::string>("name") < b.get<std::string>("name"); });
+
+		CHECK(p == parents);
+	}
+
+	// parent to child
+
+	auto j2 = cat1.join(cat2);
+	REQUIRE(j2.size() == cat1.size());
+
+	std::vector<std::vector<int>> children;
+	for (auto &[r, linked] : j2)
+	{
+		std::vector<int> ids;
+		for (auto c : linked)
+			ids.push_back(c["id"].as<int>());
+		children.push_back(ids);
+	}
+
+	CHECK(children == std::vector<std::vector<int>>{ { 1, 4 }, { 2 }, { 3, 4 }, { 7 } });
+
+	// categories that are not linked
+
+	CHECK_THROWS(cat1.join(cat1, *links.front()));
+
+	// row 5 has no parent
+
+	CHECK_FALSE(cat2.validate_links());
+	cat2.erase(cif::key("id") == 5);
+	CHECK(cat2.validate_links());
+
+	// values are matched as the type validator compares them, numbers by
+	// value and text with spaces collapsed
+
+	cat1.emplace({ { "id", 4 }, { "name", "x" } });
+	cat1.back().assign("name", "big  cat", false, false);
+
+	cat2.emplace({ { "id", 8 }, { "parent_id", 2 }, { "parent_name", "AAP" } });
+	cat2.back().assign("parent_id", "2.0", false, false);
+	cat2.emplace({ { "id", 9 }, { "parent_id", 4 }, { "parent_name", "x" } });
+	cat2.back().assign("parent_name", "Big cat", false, false);
+
+	CHECK(cat2.validate_links());
+
+	for (auto &[r, parents] : cat2.join(cat1, *links.front()))
+	{
+		auto id = r["id"].as<int>();
+		if (id == 8)
+			CHECK(parents == std::vector<cif::row_handle>{ cat1.find1(cif::key("id") == 2) });
+		else if (id == 9)
+			CHECK(parents == std::vector<cif::row_handle>{ cat1.find1(cif::key("id") == 4) });
+	}
+
+	cat2.back().assign("parent_id", "4.5", false, false);
+	CHECK_FALSE(cat2.validate_links());
 }
 
 // --------------------------------------------------------------------
 
-TEST_CASE("c1")
+TEST_CASE("validator_cache_1")
 {
-	cif::VERBOSE = 1;
+	const char dict[] = R"(
+data_cache_test.dic
+    _datablock.id	cache_test.dic
+    _dictionary.title           cache_test.dic
+    _dictionary.datablock_id    cache_test.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+               ucode     uchar
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.kind
+    _item.name                '_cat_1.kind'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           ucode
+    _item_default.value       a
+    loop_
+    _item_enumeration.value
+    a b c
+    save_
+
+save_cat_2
+    _category.description     'A second simple test category'
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.id'
+    save_
+
+save__cat_2.id
+    _item.name                '_cat_2.id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id
+    _item.name                '_cat_2.parent_id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
 
-	auto f = R"(data_TEST
-#
 loop_
-_test.id
-_test.name
-1 aap
-2 noot
-3 mies
-4 .
-5 ?
-    )"_cf;
+_pdbx_item_linked_group_list.child_category_id
+_pdbx_item_linked_group_list.link_group_id
+_pdbx_item_linked_group_list.child_name
+_pdbx_item_linked_group_list.parent_name
+_pdbx_item_linked_group_list.parent_category_id
+cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
 
-	auto &db = f.front();
+loop_
+_pdbx_item_linked_group.category_id
+_pdbx_item_linked_group.link_group_id
+_pdbx_item_linked_group.label
+cat_2 1 cat_2:cat_1:1
+    )";
 
-	for (auto r : db["test"].find(cif::key("id") == 1))
+	const std::string_view text(dict, sizeof(dict) - 1);
+	auto checksum = cif::validator::checksum(text);
+
+	std::istringstream is_dict{ std::string{ text } };
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	std::ostringstream os;
+	validator.save_binary(os, checksum);
+	auto data = os.str();
+
+	CHECK_FALSE(cif::validator::load_binary(data, checksum + 1).has_value());
+	CHECK_FALSE(cif::validator::load_binary("not a cache", checksum).has_value());
+	CHECK_THROWS(cif::validator::load_binary(std::string_view(data).substr(0, data.length() - 3), checksum));
+
+	auto v = cif::validator::load_binary(data, checksum);
+	REQUIRE(v.has_value());
+
+	CHECK(v->name() == validator.name());
+	CHECK(v->version() == validator.version());
+
+	// saving the loaded validator results in the same data
+	std::ostringstream os2;
+	v->save_binary(os2, checksum);
+	CHECK(os2.str() == data);
+
+	auto cv = v->get_validator_for_category("cat_1");
+	REQUIRE(cv != nullptr);
+	CHECK(cv->m_keys == std::vector<std::string>{ "id" });
+	CHECK(cv->m_mandatory_items == cif::iset{ "id" });
+
+	auto iv = cv->get_validator_for_item("kind");
+	REQUIRE(iv != nullptr);
+	CHECK(iv->m_category == cv);
+	CHECK(iv->m_default == "a");
+	CHECK(iv->m_enums == cif::iset{ "a", "b", "c" });
+	REQUIRE(iv->m_type != nullptr);
+	CHECK(iv->m_type->m_primitive_type == cif::DDL_PrimitiveType::UChar);
+	CHECK(iv->m_type == v->get_validator_for_type("ucode"));
+
+	std::error_code ec;
+	CHECK(cv->get_validator_for_item("id")->validate_value("12", ec));
+	CHECK_FALSE(cv->get_validator_for_item("id")->validate_value("x12", ec));
+
+	auto links = v->get_links_for_child("cat_2");
+	REQUIRE(links.size() == 1);
+	CHECK(links.front()->m_parent_category == "cat_1");
+	CHECK(links.front()->m_parent_keys == std::vector<std::string>{ "id" });
+	CHECK(links.front()->m_child_keys == std::vector<std::string>{ "parent_id" });
+	CHECK(links.front()->m_link_group_label == "cat_2:cat_1:1");
+
+	// lookups ignore character case
+	CHECK(v->get_validator_for_category("CAT_1") == cv);
+	CHECK(cv->get_validator_for_item("Kind") == iv);
+	CHECK(v->get_links_for_parent("Cat_1").size() == 1);
+	CHECK(v->get_links_for_parent("cat_2").empty());
+
+	// The factory writes the cache on first use and reads it the next time
+	auto cache_dir = std::filesystem::temp_directory_path() / "cifpp-validator-cache-test";
+	std::filesystem::remove_all(cache_dir);
+
+	auto &factory = cif::validator_factory::instance();
+
+	// Restore the original cache directory, also when a check below fails
+	struct restore_cache_directory
 	{
-		const auto &[id, name] = r.get<int, std::string>("id", "name");
-		REQUIRE(id == 1);
-		REQUIRE(name == "aap");
-	}
+		~restore_cache_directory()
+		{
+			cif::validator_factory::instance().set_cache_directory(m_dir);
+			std::filesystem::remove_all(m_test_dir);
+		}
 
-	for (auto r : db["test"].find(cif::key("id") == 4))
+		std::filesystem::path m_dir, m_test_dir;
+	} restore{ factory.get_cache_directory(), cache_dir };
+
+	factory.set_cache_directory(cache_dir);
+	CHECK(factory.get_cache_directory() == cache_dir);
+
+	std::istringstream is_dict2{ std::string{ text } };
+	auto &v2 = factory.construct_validator("cache_test.dic", is_dict2);
+	CHECK(std::filesystem::exists(cache_dir / "cache_test.validator"));
+
+	std::istringstream is_dict3{ std::string{ text } };
+	auto &v3 = factory.construct_validator("cache_test.dic", is_dict3);
+	CHECK(&v2 != &v3);
+	CHECK(v3.get_validator_for_category("cat_2") != nullptr);
+	CHECK(v3.get_links_for_parent("cat_1").size() == 1);
+
+	// the name without extension uses the same cache file
+	std::istringstream is_dict4{ std::string{ text } };
+	factory.construct_validator("cache_test", is_dict4);
+	CHECK(std::distance(std::filesystem::directory_iterator(cache_dir), std::filesystem::directory_iterator()) == 1);
+}
+
+TEST_CASE("fast_validation_1")
+{
+	struct
 	{
-		const auto &[id, name] = r.get<int, std::string>("id", "name");
-		REQUIRE(id == 4);
-		REQUIRE(name.empty());
-	}
+		std::string_view rx;
+		std::vector<std::string_view> valid, invalid;
+	} tests[] = {
+		{ "[+-]?[0-9]+", { "0", "12", "-3", "+4", "007" }, { "1.0", "+", "1 ", "a", "1e3" } },
+		{ "[+]?[1-9][0-9]*", { "1", "+20", "99" }, { "0", "-1", "01", "+" } },
+		{ "-?(([0-9]+)[.]?|([0-9]*[.][0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?",
+			{ "1", "1.", ".5", "-1.5", "1.5(3)", "1e5", "-2.5E-3", "1.5(12)e+2", "10" },
+			{ "-", "+1", "1.5(", "1.5()", "e5", "1e", "1.2.3", "1,5", "NaN" } },
+		{ "[0-9]?[0-9]?[0-9][0-9]-[0-9]?[0-9]-[0-9][0-9]", { "2024-01-31", "24-1-31", "124-12-01" }, { "2024-1-3", "2024-001-31", "2024/01/31", "12024-01-31" } },
+		{ "[+]?[A-Za-z0-9]", { "a", "Z", "+1" }, { "ab", "+", "-a" } },
+		{ "[+]?[A-Za-z0-9][A-Za-z0-9]?[A-Za-z0-9]?", { "a", "ALA", "+AB" }, { "ABCD", "+", "A-" } },
+		{ R"([][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*)", { "ATOM", "C1'", "[x]", "a|b", "\\" }, { "a b", "a\tb", "a?b", "a=b" } },
+		{ "[^ ]+", { "x", "xyz" }, { "a b", " " } },
+		{ "[[:digit:]]+", { "1", "12" }, { "a", "1a" } },
+		{ "[A-Z]{2}", { "AB" }, { "A", "ABC", "ab" } },
+	};
 
-	for (auto r : db["test"].find(cif::key("id") == 5))
+	for (auto &t : tests)
 	{
-		const auto &[id, name] = r.get<int, std::string>("id", "name");
-		REQUIRE(id == 5);
-		REQUIRE(name.empty());
+		INFO(t.rx);
+
+		cif::type_validator tv("test", cif::DDL_PrimitiveType::Char, t.rx);
+		cif::item_validator iv{ "test", false, &tv };
+
+		std::error_code ec;
+
+		for (auto v : t.valid)
+		{
+			INFO(v);
+			CHECK(iv.validate_value(v, ec));
+		}
+
+		for (auto v : t.invalid)
+		{
+			INFO(v);
+			CHECK_FALSE(iv.validate_value(v, ec));
+		}
 	}
+}
 
-	// optional
+TEST_CASE("validation_memo_1")
+{
+	const char dict[] = R"(
+data_memo_test.dic
+    _dictionary.title           memo_test.dic
+    _dictionary.version         1.0
 
-	for (auto r : db["test"])
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.id_2
+    _item.name                '_cat_1.id_2'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           int
+    save_
+    )";
+
+	struct membuf : public std::streambuf
 	{
-		const auto &[id, name] = r.get<int, std::optional<std::string>>("id", "name");
-		switch (id)
+		membuf(char *text, size_t length)
 		{
-			case 1: REQUIRE(name == "aap"); break;
-			case 2: REQUIRE(name == "noot"); break;
-			case 3: REQUIRE(name == "mies"); break;
-			case 4:
-			case 5: REQUIRE(not name); break;
-			default:
-				REQUIRE(false);
+			this->setg(text, text, text + length);
 		}
-	}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("memo_test", is_dict);
+
+	cif::datablock db("test");
+	auto &cat_1 = db["cat_1"];
+
+	// unique values in id, a few repeated values in id_2 of which one is invalid
+	const char *kValues[] = { "1", "2", "x", "3" };
+	for (int i = 0; i < 1000; ++i)
+		cat_1.emplace({ { "id", i }, { "id_2", kValues[i % 4] } });
+
+	db.set_validator(&validator);
+
+	std::stringstream errors;
+	auto saved = std::cerr.rdbuf(errors.rdbuf());
+
+	bool valid = cat_1.is_valid();
+
+	std::cerr.rdbuf(saved);
+
+	CHECK(valid);
+
+	// Every occurrence of the invalid value should be reported
+	size_t n = 0;
+	for (std::string line; std::getline(errors, line);)
+		++n;
+
+	CHECK(n == 250);
+}
+
+TEST_CASE("validation_parallel_1")
+{
+	const char dict[] = R"(
+data_parallel_test.dic
+    _dictionary.title           parallel_test.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.value
+    _item.name                '_cat_1.value'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           int
+    save_
+
+save_cat_2
+    _category.description     'A second simple test category'
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.id'
+    save_
+
+save__cat_2.id
+    _item.name                '_cat_2.id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id
+    _item.name                '_cat_2.parent_id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+loop_
+_pdbx_item_linked_group_list.child_category_id
+_pdbx_item_linked_group_list.link_group_id
+_pdbx_item_linked_group_list.child_name
+_pdbx_item_linked_group_list.parent_name
+_pdbx_item_linked_group_list.parent_category_id
+cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
+
+loop_
+_pdbx_item_linked_group.category_id
+_pdbx_item_linked_group.link_group_id
+_pdbx_item_linked_group.label
+cat_2 1 cat_2:cat_1:1
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("parallel_test", is_dict);
+
+	cif::datablock db("test");
+
+	// Enough rows to be split in partitions, with invalid values spread out
+	auto &cat_1 = db["cat_1"];
+	for (int i = 0; i < 50000; ++i)
+		cat_1.emplace({ { "id", i }, { "value", i % 4999 == 0 ? "x" + std::to_string(i) : std::to_string(i % 7) } });
+
+	auto &cat_2 = db["cat_2"];
+	for (int i = 0; i < 100; ++i)
+		cat_2.emplace({ { "id", i }, { "parent_id", i % 10 == 0 ? 100000 + i : i } });
+
+	db["cat_3"].emplace({ { "id", 1 } });
+
+	db.set_validator(&validator);
+
+	auto validate = [&db](size_t nr_of_threads)
+	{
+		cif::set_validation_thread_count(nr_of_threads);
+
+		std::stringstream errors;
+		auto saved = std::cerr.rdbuf(errors.rdbuf());
+
+		bool valid = std::as_const(db).is_valid();
+		bool links_valid = db.validate_links();
+
+		std::cerr.rdbuf(saved);
+
+		cif::set_validation_thread_count(1);
+
+		return std::make_tuple(valid, links_valid, errors.str());
+	};
+
+	auto [valid, links_valid, errors] = validate(1);
+
+	CHECK_FALSE(valid);
+	CHECK_FALSE(links_valid);
+	CHECK(errors.find("cat_1") != std::string::npos);
+	CHECK(errors.find("cat_3") != std::string::npos);
+	CHECK(errors.find("cat_2:cat_1:1") != std::string::npos);
+
+	for (size_t nr_of_threads : { 2, 4, 0 })
+	{
+		auto [p_valid, p_links_valid, p_errors] = validate(nr_of_threads);
+
+		CHECK(p_valid == valid);
+		CHECK(p_links_valid == links_valid);
+		CHECK(p_errors == errors);
+	}
+}
+
+TEST_CASE("incremental_validation_1")
+{
+	const char dict[] = R"(
+data_incremental_test.dic
+    _dictionary.title           incremental_test.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save_cat_2
+    _category.description     'A second simple test category'
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.id'
+    save_
+
+save__cat_2.id
+    _item.name                '_cat_2.id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id
+    _item.name                '_cat_2.parent_id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+loop_
+_pdbx_item_linked_group_list.child_category_id
+_pdbx_item_linked_group_list.link_group_id
+_pdbx_item_linked_group_list.child_name
+_pdbx_item_linked_group_list.parent_name
+_pdbx_item_linked_group_list.parent_category_id
+cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
+
+loop_
+_pdbx_item_linked_group.category_id
+_pdbx_item_linked_group.link_group_id
+_pdbx_item_linked_group.label
+cat_2 1 cat_2:cat_1:1
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("incremental_test", is_dict);
+
+	cif::datablock db("test");
+	db.set_validator(&validator);
+
+	auto &cat_1 = db["cat_1"];
+	auto &cat_2 = db["cat_2"];
+
+	for (int i = 1; i <= 10; ++i)
+	{
+		cat_1.emplace({ { "id", i } });
+		cat_2.emplace({ { "id", i }, { "parent_id", i } });
+	}
+
+	// Return the number of lines written to std::cerr by @a f
+	auto reported = [](auto f)
+	{
+		std::stringstream errors;
+		auto saved = std::cerr.rdbuf(errors.rdbuf());
+
+		f();
+
+		std::cerr.rdbuf(saved);
+
+		size_t n = 0;
+		for (std::string line; std::getline(errors, line);)
+			++n;
+		return n;
+	};
+
+	REQUIRE(db.is_valid_incremental());
+	REQUIRE(db.validate_links_incremental());
+
+	// an invalid value in a modified row, it is reported until fixed
+
+	auto r = cat_2.find1(cif::key("id") == 3);
+	r.assign("parent_id", "x", false, false);
+
+	CHECK(reported([&db] { db.is_valid_incremental(); }) == 1);
+	CHECK(reported([&db] { db.is_valid_incremental(); }) == 1);
+	CHECK(reported([&db] { db.is_valid(); }) == 1);
+
+	r.assign("parent_id", "3", false, false);
+	CHECK(reported([&db] { db.is_valid_incremental(); }) == 0);
+
+	// a modified row without parent
+
+	r.assign("parent_id", "11", false, false);
+	CHECK_FALSE(db.validate_links_incremental());
+
+	cat_1.emplace({ { "id", 11 } });
+	CHECK(db.validate_links_incremental());
+
+	// a changed key in the parent, without updating the children
+
+	cat_1.find1(cif::key("id") == 5).assign("id", "12", false, false);
+	CHECK_FALSE(db.validate_links_incremental());
+
+	cat_1.emplace({ { "id", 5 } });
+	CHECK(db.validate_links_incremental());
+
+	// removing a parent
+
+	cat_1.erase(cif::key("id") == 11);
+	CHECK_FALSE(cat_2.contains(cif::key("parent_id") == 11));
+	CHECK(db.validate_links_incremental());
+
+	CHECK(db.is_valid_incremental());
+	CHECK(db.is_valid());
+	CHECK(db.validate_links());
+
+	// modified rows are reported in the order of the category, not in the order of modification
+
+	auto errors_for = [](auto f)
+	{
+		std::stringstream errors;
+		auto saved = std::cerr.rdbuf(errors.rdbuf());
+
+		f();
+
+		std::cerr.rdbuf(saved);
+		return errors.str();
+	};
+
+	// a new row may reuse the memory of a removed one, it is still the last row
+	cat_2.erase(cif::key("id") == 1);
+	cat_2.emplace({ { "id", 1 }, { "parent_id", 1 } });
+	REQUIRE(db.is_valid_incremental());
+
+	auto r1 = cat_2.find1(cif::key("id") == 1);
+	auto r2 = cat_2.find1(cif::key("id") == 2);
+
+	r1.assign("parent_id", "x", false, false);
+	r2.assign("id", "x", false, false);
+
+	auto text = errors_for([&db] { db.is_valid_incremental(); });
+	auto p1 = text.find("item: parent_id\n"), p2 = text.find("item: id\n");
+	REQUIRE(p1 != std::string::npos);
+	CHECK(p2 < p1);
+
+	r2.assign("id", "2", false, false);
+
+	for (int id : { 9, 6, 2 })
+		cat_2.find1(cif::key("id") == id).assign("parent_id", std::to_string(100 - id), false, false);
+
+	int saved_verbose = std::exchange(cif::VERBOSE, 1);
+	text = errors_for([&db] { db.validate_links_incremental(); });
+	cif::VERBOSE = saved_verbose;
+
+	p2 = text.find("98");
+	auto p6 = text.find("94"), p9 = text.find("91");
+	REQUIRE(p9 != std::string::npos);
+	CHECK(p2 < p6);
+	CHECK(p6 < p9);
+}
+
+TEST_CASE("category_validator_copy_1")
+{
+	// A copy of a category_validator does not refer to the item validators of the original
+
+	std::optional<cif::category_validator> copy;
+
+	{
+		cif::category_validator cv{ "cat" };
+		cv.add_item_validator(cif::item_validator{ "id", true, nullptr });
+		cv.add_item_validator(cif::item_validator{ "name", false, nullptr });
+
+		copy = cv;
+	}
+
+	auto iv = copy->get_validator_for_item("ID");
+	REQUIRE(iv != nullptr);
+	CHECK(iv->m_item_name == "id");
+	CHECK(iv == &*copy->m_item_validators.find(*iv));
+	CHECK(copy->get_validator_for_item("other") == nullptr);
+
+	// Moving keeps the item validators in place
+	cif::category_validator moved(std::move(*copy));
+	iv = moved.get_validator_for_item("name");
+	REQUIRE(iv != nullptr);
+	CHECK(iv == &*moved.m_item_validators.find(*iv));
+}
+
+TEST_CASE("load_validation_1")
+{
+	const char dict[] = R"(
+data_load_test.dic
+    _dictionary.title           load_test.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               ucode     uchar
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.kind
+    _item.name                '_cat_1.kind'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           ucode
+    loop_
+    _item_enumeration.value
+    a b c
+    save_
+    )";
+
+	std::istringstream is_dict(dict);
+	auto validator = cif::parse_dictionary("load_test", is_dict);
+
+	const char valid_data[] = R"(data_test
+loop_
+_cat_1.id
+_cat_1.kind
+1 a
+2 b
+3 ?
+)";
+
+	const char invalid_data[] = R"(data_test
+loop_
+_cat_1.id
+_cat_1.kind
+1 a
+x b
+3 d
+4 c
+)";
+
+	using load_validation = cif::file::load_validation;
+
+	{
+		cif::file f;
+		f.set_validator(&validator);
+
+		std::istringstream is(valid_data);
+		CHECK(f.load(is, load_validation::fail_fast));
+		CHECK(f.front()["cat_1"].size() == 3);
+		CHECK(f.get_validator() == &validator);
+	}
+
+	{
+		cif::file f;
+		f.set_validator(&validator);
+
+		std::stringstream errors;
+		auto saved = std::cerr.rdbuf(errors.rdbuf());
+
+		std::istringstream is(invalid_data);
+		bool valid = f.load(is, load_validation::report);
+
+		std::cerr.rdbuf(saved);
+
+		CHECK_FALSE(valid);
+		CHECK(f.front()["cat_1"].size() == 4);
+
+		size_t n = 0;
+		for (std::string line; std::getline(errors, line);)
+			++n;
+		CHECK(n == 2);
+	}
+
+	{
+		cif::file f;
+		f.set_validator(&validator);
+
+		std::istringstream is(invalid_data);
+		CHECK_THROWS_AS(f.load(is, load_validation::fail_fast), cif::validation_exception);
+
+		// The validator is kept after a failed load
+		CHECK(f.get_validator() == &validator);
+
+		std::istringstream is_broken("data_test\nloop_\n_cat_1.id\n_cat_2.id\n");
+		CHECK_THROWS(f.load(is_broken, load_validation::report));
+		CHECK(f.get_validator() == &validator);
+	}
+
+	{
+		cif::file f;
+
+		std::istringstream is(valid_data);
+		CHECK_THROWS(f.load(is, load_validation::report));
+	}
+}
+
+TEST_CASE("statistics_1")
+{
+	auto f = R"(data_test
+loop_
+_cat_1.id
+_cat_1.name
+_cat_1.value
+1 aap  1.5
+2 noot .
+3 mies ?
+4 aap  -2.25(3)
+5 noot 10
+)"_cf;
+
+	auto &db = f.front();
+	auto &cat1 = db["cat_1"];
+
+	CHECK(cat1.size() == 5);
+	CHECK(db.row_count() == 5);
+
+	auto s = cat1.get_item_statistics("value");
+	CHECK(s.m_name == "value");
+	CHECK(s.m_null_count == 1);
+	CHECK(s.m_unknown_count == 1);
+	CHECK(s.m_numeric_count == 3);
+	CHECK(s.m_distinct_count == 3);
+	REQUIRE(s.m_min.has_value());
+	CHECK(*s.m_min == -2.25);
+	CHECK(*s.m_max == 10);
+
+	s = cat1.get_item_statistics("name");
+	CHECK(s.m_distinct_count == 3);
+	CHECK(s.m_numeric_count == 0);
+	CHECK_FALSE(s.m_min.has_value());
+
+	// statistics are updated when rows are added or modified
+	cat1.emplace({ { "id", 6 }, { "name", "zus" } });
+	CHECK(cat1.size() == 6);
+
+	s = cat1.get_item_statistics("value");
+	CHECK(s.m_unknown_count == 2);
+	CHECK(cat1.get_item_statistics("name").m_distinct_count == 4);
+
+	cat1.find1(cif::key("id") == 5)["value"] = 20;
+	s = cat1.get_item_statistics("value");
+	CHECK(*s.m_max == 20);
+
+	// removing the largest value requires collecting the range again
+	cat1.erase(cif::key("id") == 5);
+	CHECK(cat1.size() == 5);
+
+	s = cat1.get_item_statistics("value");
+	CHECK(s.m_numeric_count == 2);
+	CHECK(*s.m_max == 1.5);
+
+	// an item added later on is unknown for the existing rows
+	cat1.front()["extra"] = "x";
+	s = cat1.get_item_statistics("extra");
+	CHECK(s.m_unknown_count == 4);
+	CHECK(s.m_distinct_count == 1);
+
+	CHECK(cat1.get_item_statistics("no_such_item").m_unknown_count == 5);
+
+	cat1.clear();
+	CHECK(cat1.size() == 0);
+	CHECK(cat1.get_item_statistics("value").m_distinct_count == 0);
+}
+
+TEST_CASE("statistics_2")
+{
+	cif::category cat("cat_1");
+	for (int i = 0; i < 1000; ++i)
+		cat.emplace({ { "id", i }, { "value", i % 100 } });
+
+	// statistics are collected lazily by a const method, concurrent readers should be fine
+	const cif::category &ccat = cat;
+
+	std::vector<cif::item_statistics> stats(4);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < stats.size(); ++i)
+		threads.emplace_back([&ccat, &stats, i]
+			{ stats[i] = ccat.get_item_statistics("value"); });
+
+	for (auto &t : threads)
+		t.join();
+
+	for (auto &s : stats)
+	{
+		CHECK(s.m_numeric_count == 1000);
+		CHECK(s.m_distinct_count == stats.front().m_distinct_count);
+		REQUIRE(s.m_max.has_value());
+		CHECK(*s.m_max == 99);
+	}
+}
+
+TEST_CASE("hyperloglog_1")
+{
+	cif::hyperloglog hll;
+	CHECK(hll.estimate() == 0);
+
+	for (int i = 0; i < 100000; ++i)
+		hll.add(std::to_string(i % 50000));
+
+	auto n = hll.estimate();
+	CHECK(n > 50000 * 0.9);
+	CHECK(n < 50000 * 1.1);
+
+	cif::hyperloglog hll2;
+	for (int i = 25000; i < 75000; ++i)
+		hll2.add(std::to_string(i));
+
+	hll.merge(hll2);
+	n = hll.estimate();
+	CHECK(n > 75000 * 0.9);
+	CHECK(n < 75000 * 1.1);
+}
+
+TEST_CASE("gzio_parallel_1")
+{
+	// Enough data for several blocks, with repeats across block boundaries
+	std::string text;
+	for (int i = 0; text.length() < 5 * cif::gzio::kParallelBlockSize / 2; ++i)
+		text += "ATOM " + std::to_string(i) + ' ' + std::to_string(i % 977) + " CA ALA\n";
+
+	auto file = std::filesystem::temp_directory_path() / "cifpp-gzio-parallel-test.txt.gz";
+
+	for (auto options : { cif::gzio::compression_options{ 1, 1 }, cif::gzio::compression_options{ 6, 4 }, cif::gzio::compression_options{ 9, 0 } })
+	{
+		{
+			cif::gzio::ofstream out(file, options);
+			REQUIRE(out.is_open());
+			out << text;
+		}
+
+		cif::gzio::ifstream in(file);
+		std::string result{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		CHECK(result == text);
+	}
+
+	// An empty file is a valid gzip file too
+	{
+		cif::gzio::ofstream out(file, cif::gzio::compression_options{ 6, 4 });
+	}
+
+	cif::gzio::ifstream in(file);
+	CHECK(in.get() == std::char_traits<char>::eof());
+
+	std::filesystem::remove(file);
+}
+
+TEST_CASE("bgzf_1")
+{
+	cif::file f;
+	for (int i = 0; i < 20; ++i)
+	{
+		auto &db = f.emplace_back("db_" + std::to_string(i));
+		auto &cat = db["cat"];
+		for (int j = 0; j < 1000; ++j)
+			cat.emplace({ { "id", j }, { "name", "row-" + std::to_string(i * 1000 + j) }, { "value", (i * j) % 97 } });
+	}
+
+	std::ostringstream expected;
+	expected << f;
+
+	auto file = std::filesystem::temp_directory_path() / "cifpp-bgzf-test.cif.gz";
+	f.save(file, cif::gzio::compression_options{ 6, 2, true });
+
+	// The file ends with the BGZF end-of-file marker
+	{
+		std::ifstream raw(file, std::ios::binary);
+		raw.seekg(-28, std::ios::end);
+		char marker[28];
+		raw.read(marker, 28);
+		CHECK(std::equal(marker, marker + 28, reinterpret_cast<const char *>(cif::gzio::detail::kBGZFEOFMarker)));
+	}
+
+	// Reading sequentially
+	{
+		cif::gzio::ifstream in(file);
+		std::string text{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		CHECK(text == expected.str());
+	}
+
+	// Reading a single datablock using an index
+	cif::parser::datablock_index index;
+
+	{
+		cif::gzio::ifstream in(file);
+		cif::file f2;
+		cif::parser p(in, f2);
+		index = p.index_datablocks();
+	}
+
+	CHECK(index.size() == 20);
+
+	// The keys in the index are upper case, except for the first character
+	auto find = [&index](std::string_view name)
+	{
+		return std::find_if(index.begin(), index.end(), [name](auto &i)
+			{ return cif::iequals(i.first, name); });
+	};
+
+	auto db_5 = find("db_5"), db_17 = find("db_17");
+	REQUIRE(db_5 != index.end());
+	REQUIRE(db_17 != index.end());
+
+	// The data spans several blocks
+	CHECK((db_17->second >> 16) > (db_5->second >> 16));
+
+	{
+		cif::gzio::ifstream in(file);
+		cif::file f2;
+		cif::parser p(in, f2);
+		CHECK(p.parse_single_datablock(db_17->first, index));
+
+		REQUIRE(f2.size() == 1);
+		CHECK(cif::iequals(f2.front().name(), "db_17"));
+
+		auto &cat = f2.front()["cat"];
+		CHECK(cat.size() == 1000);
+		CHECK(cat.find1<std::string>(cif::key("id") == 999, "name") == "row-17999");
+	}
+
+	// Seeking to a virtual offset, which points right after the data_ line
+	{
+		cif::gzio::ifstream in(file);
+		in.seekg(db_5->second);
+
+		char text[256];
+		in.read(text, sizeof(text));
+		REQUIRE(in.gcount() == sizeof(text));
+
+		auto pos = expected.str().find("data_db_5\n") + 10;
+		CHECK(std::string_view(text, sizeof(text)) == expected.str().substr(pos, sizeof(text)));
+	}
+
+	std::filesystem::remove(file);
+}
+
+TEST_CASE("bgzf_2")
+{
+	// Malformed block headers are rejected without reading past the buffers
+
+	using bgzf_streambuf = cif::gzio::basic_ibgzf_streambuf<char, std::char_traits<char>>;
+
+	auto read_all = [](const std::string &data)
+	{
+		std::stringbuf upstream(data);
+		bgzf_streambuf sb;
+		REQUIRE(sb.init(&upstream) != nullptr);
+
+		std::istream in(&sb);
+		return std::string{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	};
+
+	const std::string header{ '\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff' };
+
+	// The largest possible extra field, followed by that much data
+	CHECK(read_all(header + "\xff\xff" + std::string(70000, 'B')).empty());
+
+	// A BC subfield that extends past the extra field
+	CHECK(read_all(header + std::string{ 4, 0, 'B', 'C', 2, 0, '\xff', '\x00' } + std::string(100, 0)).empty());
+
+	// A subfield length that runs past the extra field
+	CHECK(read_all(header + std::string{ 6, 0, 'X', 'Y', '\xff', '\xff', 0, 0 } + std::string(100, 0)).empty());
+
+	// A truncated header
+	CHECK(read_all(header.substr(0, 6)).empty());
+}
+
+TEST_CASE("sniff_format_1")
+{
+	using cif::gzio::compression_format;
+
+	// A streambuf that cannot seek, with all data in its get area
+	struct unseekable_buf : public std::streambuf
+	{
+		unseekable_buf(std::string data)
+			: m_data(std::move(data))
+		{
+			this->setg(m_data.data(), m_data.data(), m_data.data() + m_data.length());
+		}
+
+		std::string m_data;
+	};
+
+	auto sniff = [](const std::string &data, bool seekable)
+	{
+		std::stringbuf seekable_buf(data);
+		unseekable_buf unseekable(data);
+
+		std::streambuf *sb = seekable ? static_cast<std::streambuf *>(&seekable_buf) : &unseekable;
+		auto result = cif::gzio::sniff_format(sb);
+
+		// The position is left unchanged
+		CHECK(sb->sgetc() == (data.empty() ? EOF : static_cast<unsigned char>(data.front())));
+
+		return result;
+	};
+
+	for (bool seekable : { true, false })
+	{
+		CHECK(sniff("", seekable) == compression_format::none);
+		CHECK(sniff("(", seekable) == compression_format::none);
+		CHECK(sniff("(\xb5", seekable) == compression_format::none);
+		CHECK(sniff("\x04\x22\x4d", seekable) == compression_format::none);
+		CHECK(sniff("(not zstd)", seekable) == compression_format::none);
+		CHECK(sniff("\x1f\x8b\x08", seekable) == compression_format::gzip);
+		CHECK(sniff("\x28\xb5\x2f\xfd data", seekable) == compression_format::zstd);
+		CHECK(sniff("\x04\x22\x4d\x18 data", seekable) == compression_format::lz4);
+		CHECK(sniff("data_test\n", seekable) == compression_format::none);
+	}
+
+	// A streambuf that cannot seek and returns one character at a time,
+	// like a pipe, nothing can be put back beyond its get area
+	struct trickle_buf : public std::streambuf
+	{
+		trickle_buf(std::string data)
+			: m_data(std::move(data))
+		{
+		}
+
+		int_type underflow() override
+		{
+			if (m_next >= m_data.length())
+				return traits_type::eof();
+
+			m_ch = m_data[m_next++];
+			this->setg(&m_ch, &m_ch, &m_ch + 1);
+			return traits_type::to_int_type(m_ch);
+		}
+
+		std::string m_data;
+		size_t m_next = 0;
+		char m_ch;
+	};
+
+	for (std::string data : { "\x1f\x8b\x08 data", "data_test\n", "\x28\xb5\x2f\xfd data" })
+	{
+		trickle_buf sb(data);
+		auto format = cif::gzio::sniff_format(&sb);
+		CHECK(format == (data.front() == '\x1f' ? compression_format::gzip : compression_format::none));
+
+		// Nothing was consumed
+		std::string read(std::istreambuf_iterator<char>(&sb), {});
+		CHECK(read == data);
+	}
+}
+
+TEST_CASE("compression_formats_1")
+{
+	cif::file f;
+	for (int i = 0; i < 5; ++i)
+	{
+		auto &db = f.emplace_back("db_" + std::to_string(i));
+		auto &cat = db["cat"];
+		for (int j = 0; j < 1000; ++j)
+			cat.emplace({ { "id", j }, { "name", "row-" + std::to_string(i * 1000 + j) } });
+	}
+
+	std::ostringstream expected;
+	expected << f;
+
+	std::vector<std::pair<std::string, cif::gzio::compression_options>> formats{
+		{ ".gz", {} }
+	};
+
+#if CIFPP_HAVE_ZSTD
+	formats.emplace_back(".zst", cif::gzio::compression_options{ .level = 3, .threads = 2, .long_distance_matching = true });
+#else
+	auto zst = std::filesystem::temp_directory_path() / "cifpp-format-test.cif.zst";
+	CHECK_THROWS_AS(f.save(zst), std::runtime_error);
+	std::filesystem::remove(zst);
+#endif
+
+#if CIFPP_HAVE_LZ4
+	formats.emplace_back(".lz4", cif::gzio::compression_options{ .level = 1 });
+#endif
+
+	for (auto &[ext, options] : formats)
+	{
+		auto file = std::filesystem::temp_directory_path() / ("cifpp-format-test.cif" + ext);
+		f.save(file, options);
+
+		{
+			cif::gzio::ifstream in(file);
+			std::string text{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+			CHECK(text == expected.str());
+		}
+
+		// The format is recognized by its content, not by the extension
+		auto renamed = std::filesystem::temp_directory_path() / "cifpp-format-test.cif";
+		std::filesystem::rename(file, renamed);
+
+		cif::file f2(renamed);
+		CHECK(f2.size() == 5);
+		CHECK(f2["db_4"]["cat"].size() == 1000);
+
+		std::filesystem::remove(renamed);
+	}
+}
+
+TEST_CASE("write_quoting_1")
+{
+	const std::vector<std::string> values{
+		"?", "a b", "it's", "say \"hi\"", "end'", "x' y", "x'y\" z' q\"", "line1\nline2",
+		std::string(140, 'x'), std::string(131, 'y'), "data_x", "loop_", "_name",
+		"#hash", ";semi", "trail ", "'", "\"", "''"
+	};
+
+	cif::file f;
+	auto &db = f.emplace_back("test");
+
+	auto &loop = db["loop"];
+	for (size_t i = 0; i < values.size(); ++i)
+		loop.emplace({ { "id", i }, { "value", values[i] }, { "reversed", values[values.size() - i - 1] } });
+
+	for (size_t i = 0; i < values.size(); ++i)
+		db["single_" + std::to_string(i)].emplace({ { "value", values[i] } });
+
+	std::stringstream ss;
+	ss << f;
+
+	cif::file f2(ss);
+	auto &db2 = f2.front();
+
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		auto &&[value, reversed] = db2["loop"].find1<std::string, std::string>(cif::key("id") == i, "value", "reversed");
+
+		// A question mark is read back as an empty value
+		if (values[i] != "?")
+			CHECK(value == values[i]);
+		if (values[values.size() - i - 1] != "?")
+			CHECK(reversed == values[values.size() - i - 1]);
+
+		if (values[i] != "?")
+			CHECK(db2["single_" + std::to_string(i)].front().get<std::string>("value") == values[i]);
+	}
+
+	// No line is longer than 132 characters, except for text fields
+	std::string line;
+	ss.clear();
+	ss.seekg(0);
+	while (std::getline(ss, line))
+		CHECK((line.length() <= 132 or line.find("xxxx") != std::string::npos));
+}
+
+TEST_CASE("parallel_write_1")
+{
+	cif::file f;
+	auto &db = f.emplace_back("test");
+
+	for (int i = 0; i < 10; ++i)
+	{
+		auto &cat = db["small_" + std::to_string(i)];
+		for (int j = 0; j <= i; ++j)
+			cat.emplace({ { "id", j }, { "name", "name " + std::to_string(i * j) } });
+	}
+
+	// The widest value is in the last partition of rows
+	auto &large = db["large"];
+	for (int i = 0; i < 25000; ++i)
+		large.emplace({ { "id", i }, { "value", std::string(i / 1000 + 1, 'x') }, { "text", i % 7 == 0 ? "a b" : "c" } });
+
+	std::ostringstream serial;
+	serial << f;
+
+	cif::set_write_thread_count(4);
+
+	std::ostringstream parallel;
+	parallel << f;
+
+	cif::set_write_thread_count(1);
+
+	CHECK(serial.str() == parallel.str());
+}
+
+TEST_CASE("write_error_1")
+{
+	// Errors writing to the stream reach the caller, also for the data written last
+
+	struct failing_buf : public std::streambuf
+	{
+		std::streamsize xsputn(const char *, std::streamsize) override { return 0; }
+		int_type overflow(int_type) override { return traits_type::eof(); }
+	} buf;
+
+	std::ostream os(&buf);
+	os.exceptions(std::ios::badbit);
+
+	cif::file f;
+	auto &db = f.emplace_back("test");
+	auto &cat = db["cat"];
+	cat.emplace({ { "id", 1 }, { "name", "aap" } });
+
+	CHECK_THROWS_AS(cat.write(os), std::ios::failure);
+	os.clear();
+
+	CHECK_THROWS_AS(db.write(os), std::ios::failure);
+	os.clear();
+
+	cif::set_write_thread_count(4);
+	CHECK_THROWS_AS(db.write(os), std::ios::failure);
+	cif::set_write_thread_count(1);
+	os.clear();
+
+	// and for a category that is written as it was read
+	std::istringstream is("data_test\n_cat.id 1\n");
+	cif::file f2(is);
+
+	CHECK_THROWS_AS(f2.front()["cat"].write(os), std::ios::failure);
+}
+
+TEST_CASE("bcif_1")
+{
+	cif::file f;
+	auto &db = f.emplace_back("TEST");
+
+	auto &atoms = db["atom_site"];
+	for (int i = 0; i < 2000; ++i)
+	{
+		atoms.emplace({
+			{ "id", i + 1 },
+			{ "type_symbol", i % 3 == 0 ? "C" : "N" },
+			{ "label_seq_id", i / 10 },
+			{ "Cartn_x", (i % 17) * 1.125 - 9, 3 },
+			{ "Cartn_y", i * -0.5, 3 },
+			{ "B_iso_or_equiv", 10 + (i % 100) * 0.25, 2 },
+			{ "occupancy", i % 50 == 0 ? "?" : "1.00" },
+			{ "pdbx_PDB_ins_code", i % 20 == 0 ? "A" : "." },
+			{ "large", int64_t(i) * 1000000 - 1000000000 } });
+	}
+
+	// values that must be kept as text
+	auto &mixed = db["mixed"];
+	const std::vector<std::string> values{ "1.5", "1.50", "007", "-0.000", "+1", "1e5", "a b", "12345678901234", "?", ".", "-2147483648", "'" };
+	for (size_t i = 0; i < values.size(); ++i)
+		mixed.emplace({ { "id", i }, { "value", values[i] } });
+
+	db["entry"].emplace({ { "id", "1ABC" } });
+
+	std::stringstream ss;
+	cif::bcif::write(ss, f);
+
+	CHECK(cif::bcif::is_bcif(ss));
+
+	cif::file f2(ss);
+
+	std::ostringstream expected, result;
+	expected << f;
+	result << f2;
+
+	CHECK(expected.str() == result.str());
+
+	auto &db2 = f2.front();
+	CHECK(db2.name() == "TEST");
+	CHECK(db2["atom_site"].size() == 2000);
+	CHECK(db2["atom_site"].find1<std::string>(cif::key("id") == 51, "occupancy") == "");
+	CHECK(db2["mixed"].find1<std::string>(cif::key("id") == 3, "value") == "-0.000");
+
+	// Saving to a file named .bcif writes BinaryCIF, loading recognizes it by content
+	auto path = std::filesystem::temp_directory_path() / "bcif-test.bcif.gz";
+	f.save(path);
+
+	cif::file f3(path);
+	std::ostringstream reloaded;
+	reloaded << f3;
+	CHECK(expected.str() == reloaded.str());
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("bcif_2")
+{
+	// Malformed BinaryCIF data results in an exception
+
+	// Minimal MessagePack encoding, strings shorter than 32 characters and small integers
+	auto map = [](int n) { return std::string(1, static_cast<char>(0x80 | n)); };
+	auto array = [](int n) { return std::string(1, static_cast<char>(0x90 | n)); };
+	auto str = [](std::string_view s) { return static_cast<char>(0xa0 | s.length()) + std::string{ s }; };
+	auto num = [](int v) { return std::string(1, static_cast<char>(v)); };
+	auto int32 = [](int32_t v)
+	{
+		std::string result = "\xd2";
+		for (int i = 3; i >= 0; --i)
+			result += static_cast<char>((v >> (8 * i)) & 0xff);
+		return result;
+	};
+
+	// A single column with the run length encoded values in @a runs
+	auto make = [&](std::vector<int32_t> runs, int32_t src_size)
+	{
+		std::string data;
+		for (auto v : runs)
+		{
+			for (int i = 0; i < 4; ++i)
+				data += static_cast<char>((v >> (8 * i)) & 0xff);
+		}
+
+		return map(1) + str("dataBlocks") + array(1) +
+		       map(2) + str("header") + str("test") + str("categories") + array(1) +
+		       map(3) + str("name") + str("_cat") + str("rowCount") + num(1) + str("columns") + array(1) +
+		       map(3) + str("name") + str("id") + str("mask") + "\xc0" + str("data") +
+		       map(2) + str("data") + "\xc4" + static_cast<char>(data.length()) + data + str("encoding") + array(2) +
+		       map(3) + str("kind") + str("RunLength") + str("srcType") + num(3) + str("srcSize") + int32(src_size) +
+		       map(2) + str("kind") + str("ByteArray") + str("type") + num(3);
+	};
+
+	auto load = [](const std::string &data)
+	{
+		cif::file f;
+		std::istringstream is(data);
+		f.load(is);
+		return f;
+	};
+
+	auto f = load(make({ 5, 1 }, 1));
+	CHECK(f.front()["cat"].front()["id"].as<int>() == 5);
+
+	CHECK_THROWS_AS(load(make({ 5, -1 }, 1)), std::runtime_error);
+	CHECK_THROWS_AS(load(make({ 5, 1000000000 }, 1)), std::runtime_error);
+	CHECK_THROWS_AS(load(make({ 5, 1 }, -1)), std::runtime_error);
+	CHECK_THROWS_AS(load(make({ 5, 1 }, 0x7fffffff)), std::runtime_error);
+
+	// Deeply nested arrays
+	CHECK_THROWS_AS(load(map(1) + str("dataBlocks") + std::string(100000, '\x91') + "\xc0"), std::runtime_error);
+}
+
+TEST_CASE("snapshot_1")
+{
+	cif::file f(gTestDir / "HEM.cif");
+
+	auto path = std::filesystem::temp_directory_path() / "snapshot-test.snap";
+	f.save_snapshot(path);
+
+	std::ostringstream expected;
+	expected << f;
+
+	cif::file f2;
+	REQUIRE(f2.open_snapshot(path));
+
+	std::ostringstream result;
+	result << f2;
+	CHECK(expected.str() == result.str());
+	CHECK(f2.front()["chem_comp_atom"].size() == f.front()["chem_comp_atom"].size());
+
+	// The validator of the file is attached to the data read
+	cif::validator v("snapshot-test");
+	cif::file f3;
+	f3.set_validator(&v);
+	REQUIRE(f3.open_snapshot(path));
+	CHECK(f3.get_validator() == &v);
+	CHECK(f3.front().get_validator() == &v);
+
+	// A snapshot with another version of the format is ignored
+	std::string data;
+	{
+		std::ifstream in(path, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(in), {});
+	}
+
+	auto write = [&path](const std::string &data)
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(data.data(), data.length());
+	};
+
+	auto modified = data;
+	modified[12] ^= 0x7f;
+	write(modified);
+	CHECK_FALSE(f2.open_snapshot(path));
+
+	// as is a corrupt snapshot, the contents of f2 is not changed
+	modified = data;
+	modified[data.length() / 2] ^= 0x7f;
+	write(modified);
+	CHECK_FALSE(f2.open_snapshot(path));
+
+	write(data.substr(0, data.length() - 1));
+	CHECK_FALSE(f2.open_snapshot(path));
+
+	std::ostringstream unchanged;
+	unchanged << f2;
+	CHECK(expected.str() == unchanged.str());
+
+	// and so is a regular file
+	CHECK_FALSE(f2.open_snapshot(gTestDir / "HEM.cif"));
+
+	// or a missing one
+	std::filesystem::remove(path);
+	CHECK_FALSE(f2.open_snapshot(path));
+}
+
+TEST_CASE("category_writer_1")
+{
+	// The output of a category_writer equals that of category::write
+	// when the widths are calculated from all rows
+
+	cif::category cat("atom_site");
+
+	std::ostringstream streamed;
+
+	{
+		cif::category_writer w(streamed, "atom_site", { "group_PDB", "id", "type_symbol", "Cartn_x", "occupancy", "label_alt_id", "details" });
+		w.set_precision("Cartn_x", 3);
+
+		for (int i = 0; i < 100; ++i)
+		{
+			double x = i * -1.25 + 0.0005;
+			std::optional<float> occupancy;
+			if (i % 3)
+				occupancy = 0.5f;
+			std::string details = i % 10 == 0 ? "a value with spaces" : (i == 42 ? std::string(140, 'x') : "");
+
+			w.emplace_row(i < 90 ? "ATOM" : "HETATM", i + 1, i % 2 == 1, x, occupancy, ".", details);
+
+			cat.emplace({ { "group_PDB", i < 90 ? "ATOM" : "HETATM" },
+				{ "id", i + 1 },
+				{ "type_symbol", i % 2 == 1 },
+				{ "Cartn_x", x, 3 },
+				{ "occupancy", occupancy },
+				{ "label_alt_id", "." },
+				{ "details", details } });
+		}
+
+		CHECK(w.row_count() == 100);
+	}
+
+	std::ostringstream expected;
+	cat.write(expected);
+
+	CHECK(streamed.str() == expected.str());
+
+	// Rows beyond the sample and rows written using fixed widths are read back correctly
+
+	for (int fixed = 0; fixed < 2; ++fixed)
+	{
+		std::stringstream ss;
+		ss << "data_test\n";
+
+		{
+			auto w = fixed
+			             ? std::make_unique<cif::category_writer>(ss, "test", std::vector<std::string>{ "id", "value" }, std::vector<size_t>{ 4, 2 })
+			             : std::make_unique<cif::category_writer>(ss, "test", std::vector<std::string>{ "id", "value" }, 10);
+
+			for (int i = 0; i < 50; ++i)
+				w->emplace_row(i, std::string(i, 'v'));
+		}
+
+		cif::file f(ss);
+		auto &test = f.front()["test"];
+
+		REQUIRE(test.size() == 50);
+		for (auto &&[id, value] : test.rows<int, std::string>("id", "value"))
+			CHECK(value == std::string(id, 'v'));
+	}
+
+	// Nothing is written for an empty category
+	std::ostringstream empty;
+	cif::category_writer(empty, "empty", { "id" }).close();
+	CHECK(empty.str().empty());
+}
+
+TEST_CASE("category_writer_2")
+{
+	// A single row is written as item/value pairs, like category::write does
+
+	for (int fixed = 0; fixed < 2; ++fixed)
+	{
+		std::ostringstream streamed;
+
+		{
+			auto w = fixed
+			             ? std::make_unique<cif::category_writer>(streamed, "entry", std::vector<std::string>{ "id", "chain", "details" }, std::vector<size_t>{ 4, 1, 1 })
+			             : std::make_unique<cif::category_writer>(streamed, "entry", std::vector<std::string>{ "id", "chain", "details" }, 1);
+
+			w->emplace_row("1ABC", 'A', "a value with spaces");
+		}
+
+		cif::category cat("entry");
+		cat.emplace({ { "id", "1ABC" }, { "chain", "A" }, { "details", "a value with spaces" } });
+
+		std::ostringstream expected;
+		cat.write(expected);
+
+		CHECK(streamed.str() == expected.str());
+	}
+
+	// The decision for a loop_ is taken when the second row is added
+	std::ostringstream ss;
+	cif::category_writer w(ss, "test", { "id", "chain" }, 1);
+
+	w.emplace_row(1, 'A');
+	CHECK(ss.str().empty());
+
+	w.emplace_row(2, 'B');
+	w.close();
+
+	CHECK(ss.str() == "loop_\n_test.id \n_test.chain \n1 A \n2 B \n# \n");
+
+	// close reports errors writing to the stream, the destructor does not throw
+	std::ostringstream bad;
+	bad.setstate(std::ios::badbit);
+
+	cif::category_writer w2(bad, "test", { "id" });
+	w2.emplace_row(1);
+	CHECK_THROWS_AS(w2.close(), std::runtime_error);
+
+	cif::category_writer(bad, "test", { "id" }).emplace_row(1);
+}
+
+TEST_CASE("keep_source_text_1")
+{
+	// Categories that are not modified are written as they were read
+
+	const std::string text = R"(data_test
+# a comment
+_entry.id   TEST   # kept
+#
+loop_
+_odd.id
+_odd.value
+1 'a b'    2 "c"
+3   ?
+#
+loop_
+_changed.id
+_changed.value
+1   one
+2   two
+#
+)";
+
+	for (auto eol : { "\n", "\r\n" })
+	{
+		std::string data = text;
+		cif::replace_all(data, "\n", eol);
+
+		cif::file f;
+		f.set_keep_source_text(true);
+
+		std::istringstream is(data);
+		f.load(is);
+
+		auto &db = f.front();
+
+		auto entry = data.find("_entry"), odd = data.find("loop_"), changed = data.find(std::string("loop_") + eol + "_changed");
+		auto entry_text = data.substr(entry, odd - entry);
+		auto odd_text = data.substr(odd, changed - odd);
+
+		CHECK(db["entry"].get_source_text() == entry_text);
+		CHECK(db["odd"].get_source_text() == odd_text);
+		CHECK(db["odd"].size() == 3);
+
+		// A copy keeps the text, a modification drops it
+		cif::category copy(db["odd"]);
+		CHECK(copy.get_source_text() == odd_text);
+		copy.erase(copy.begin());
+		CHECK(copy.get_source_text().empty());
+
+		db["changed"].front().assign("value", "uno", false);
+		CHECK(db["changed"].get_source_text().empty());
+
+		std::ostringstream formatted;
+		db["changed"].write(formatted);
+
+		std::ostringstream os;
+		f.save(os);
+
+		CHECK(os.str() == "data_test\n# \n" + entry_text + odd_text + formatted.str());
+	}
+
+	// Without keeping the source text, categories are formatted
+	cif::file f(text.data(), text.length());
+	CHECK(f.front()["odd"].get_source_text().empty());
+}
+
+TEST_CASE("write_order_1")
+{
+	// Parent categories are written before their children
+
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+save_cat_a
+    _category.id              cat_a
+    _category.mandatory_code  no
+    _category_key.name        '_cat_a.id'
+    save_
+
+save__cat_a.id
+    _item.name                '_cat_a.id'
+    _item.category_id         cat_a
+    _item.mandatory_code      yes
+    _item_linked.child_name   '_cat_b.a_id'
+    _item_linked.parent_name  '_cat_a.id'
+    _item_type.code           code
+    save_
+
+save_cat_b
+    _category.id              cat_b
+    _category.mandatory_code  no
+    _category_key.name        '_cat_b.id'
+    save_
+
+save__cat_b.id
+    _item.name                '_cat_b.id'
+    _item.category_id         cat_b
+    _item.mandatory_code      yes
+    _item_linked.child_name   '_cat_c.b_id'
+    _item_linked.parent_name  '_cat_b.id'
+    _item_type.code           code
+    save_
+
+save__cat_b.a_id
+    _item.name                '_cat_b.a_id'
+    _item.category_id         cat_b
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save_cat_c
+    _category.id              cat_c
+    _category.mandatory_code  no
+    _category_key.name        '_cat_c.id'
+    save_
+
+save__cat_c.id
+    _item.name                '_cat_c.id'
+    _item.category_id         cat_c
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__cat_c.b_id
+    _item.name                '_cat_c.b_id'
+    _item.category_id         cat_c
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+)";
+
+	std::istringstream is_dict(dict);
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	// cat_a and the unknown category x have no parents, ties are ordered by name descending
+	CHECK(validator.order_parents_first({ "cat_c", "cat_b", "x", "cat_a" }) == std::vector<size_t>{ 2, 3, 1, 0 });
+
+	// without cat_b, cat_c has no parent
+	CHECK(validator.order_parents_first({ "cat_c", "cat_a" }) == std::vector<size_t>{ 0, 1 });
+
+	cif::file f;
+
+	auto &db = f.emplace_back("test");
+	db["cat_c"].emplace({ { "id", "1" }, { "b_id", "1" } });
+	db["cat_b"].emplace({ { "id", "1" }, { "a_id", "1" } });
+	db["cat_a"].emplace({ { "id", "1" } });
+
+	f.set_validator(&validator);
+
+	std::ostringstream os;
+	db.write(os);
+
+	auto text = os.str();
+	CHECK(text.find("_cat_a.id") < text.find("_cat_b.id"));
+	CHECK(text.find("_cat_b.id") < text.find("_cat_c.id"));
+
+	// An explicit order, category names are compared case insensitively
+	std::ostringstream os2;
+	db.write(os2, { "_cat_c.b_id", "_cat_B.a_id", "_cat_c.id", "_cat_b.id" });
+
+	text = os2.str();
+	CHECK(text.find("_cat_c.b_id") < text.find("_cat_c.id"));
+	CHECK(text.find("_cat_c.id") < text.find("_cat_b.a_id"));
+	CHECK(text.find("_cat_b.a_id") < text.find("_cat_b.id"));
+	CHECK(text.find("_cat_b.id") < text.find("_cat_a.id"));
+}
+
+// --------------------------------------------------------------------
+// Typed views, generated by category-view-generator from category-view-test.dic
+
+TEST_CASE("category_view_1")
+{
+	auto f = R"(data_test
+loop_
+_atom.id
+_atom.label_atom_id
+_atom.cartn_x
+1 N  1.5
+2 CA 2.25
+3 C  ?
+)"_cf;
+
+	auto &atom = f.front()["atom"];
+	test_views::atom_view view(atom);
+
+	CHECK(view.size() == 3);
+	CHECK(test_views::atom_view::category_name == "atom");
+
+	std::vector<int> ids;
+	float sum = 0;
+	for (auto r : view)
+	{
+		ids.push_back(r.id());
+		sum += r.cartn_x();
+		CHECK(r.occupancy() == 0);
+		CHECK(r.position().empty());
+	}
+
+	static_assert(std::is_same_v<decltype(view(atom.front()).position()), std::string>);
+
+	CHECK(ids == std::vector<int>{ 1, 2, 3 });
+	CHECK(sum == 3.75f);
+
+	auto ca = view(atom.find1(cif::key("id") == 2));
+	REQUIRE(ca);
+	CHECK(ca.label_atom_id() == "CA");
+	CHECK(ca.handle() == atom.find1(cif::key("label_atom_id") == "CA"));
+
+	// Items added after constructing the view remain missing in the view
+	for (auto r : atom)
+		r["occupancy"] = "0.5";
+
+	for (auto r : view)
+	{
+		CHECK(r.occupancy() == 0);
+		CHECK(r.position().empty());
+	}
+}
+
+TEST_CASE("category_view_2")
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code          char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+               int           numb  '[+-]?[0-9]+'
+               positive_int  numb  '[+]?[1-9][0-9]*'
+               float         numb  '-?[0-9]+([.][0-9]*)?'
+               int-range     numb  '[+-]?[0-9]+-[+-]?[0-9]+'
+               point         numb  '-?[0-9]+,-?[0-9]+'
+
+save_cat_1
+    _category.description     'A test category'
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.count
+    _item.name                '_cat_1.count'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           positive_int
+    save_
+
+save__cat_1.value
+    _item.name                '_cat_1.value'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           float
+    save_
+
+save__cat_1.range
+    _item.name                '_cat_1.range'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           int-range
+    save_
+
+save__cat_1.pos
+    _item.name                '_cat_1.pos'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           point
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+
+save__cat_1.class
+    _item.name                '_cat_1.class'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	auto cv = validator.get_validator_for_category("cat_1");
+	REQUIRE(cv != nullptr);
+
+	std::ostringstream os;
+	cif::write_category_view(os, *cv);
+	auto text = os.str();
+
+	CHECK(text.find("class cat_1_row : public cif::category_row_view<7>") != std::string::npos);
+	CHECK(text.find("class cat_1_view : public cif::category_view<cat_1_row, 7>") != std::string::npos);
+	CHECK(text.find("static constexpr std::string_view category_name = \"cat_1\";") != std::string::npos);
+
+	CHECK(text.find("\tint id() const { return get<int>(") != std::string::npos);
+	CHECK(text.find("\tint count() const { return get<int>(") != std::string::npos);
+	CHECK(text.find("\tfloat value() const { return get<float>(") != std::string::npos);
+	CHECK(text.find("\tstd::string range() const { return get<std::string>(") != std::string::npos);
+	CHECK(text.find("\tstd::string pos() const { return get<std::string>(") != std::string::npos);
+	CHECK(text.find("\tstd::string name() const { return get<std::string>(") != std::string::npos);
+	CHECK(text.find("\tstd::string class_() const { return get<std::string>(") != std::string::npos);
+}
+
+TEST_CASE("d6")
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _datablock.description
+;
+    A test dictionary
+;
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+               text      char
+               '[][ \n\t()_,.;:"&<>/\{}'`~!@#$%?+=*A-Za-z0-9|^-]*'
+
+               int       numb
+               '[+-]?[0-9]+'
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.id_2
+    _item.name                '_cat_1.id_2'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           int
+    save_
+
+save_cat_2
+    _category.description     'A second simple test category'
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.id'
+    save_
+
+save__cat_2.id
+    _item.name                '_cat_2.id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id
+    _item.name                '_cat_2.parent_id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id_2
+    _item.name                '_cat_2.parent_id_2'
+    _item.category_id         cat_2
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+
+loop_
+_pdbx_item_linked_group_list.child_category_id
+_pdbx_item_linked_group_list.link_group_id
+_pdbx_item_linked_group_list.child_name
+_pdbx_item_linked_group_list.parent_name
+_pdbx_item_linked_group_list.parent_category_id
+cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
+cat_2 1 '_cat_2.parent_id_2' '_cat_1.id_2' cat_1
+
+loop_
+_pdbx_item_linked_group.category_id
+_pdbx_item_linked_group.link_group_id
+_pdbx_item_linked_group.label
+cat_2 1 cat_2:cat_1:1
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+
+	// --------------------------------------------------------------------
+
+	const char data[] = R"(
+data_test
+loop_
+_cat_1.id
+_cat_1.id_2
+1 1
+2 2
+3 ?
+
+loop_
+_cat_2.id
+_cat_2.parent_id
+_cat_2.parent_id_2
+ 0 1 1
+ 1 1 ?
+ 2 ? 1
+ 3 ? ?
+ 4 2 2
+ 5 3 1
+ 6 3 ?
+    )";
+
+	// --------------------------------------------------------------------
+
+	struct data_membuf : public std::streambuf
+	{
+		data_membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} data_buffer(const_cast<char *>(data), sizeof(data) - 1);
+
+	std::istream is_data(&data_buffer);
+	f.load(is_data);
+
+	// auto &cat1 = f.front()["cat_1"];
+	auto &cat2 = f.front()["cat_2"];
+
+	// f.front().validate_links();
+	// REQUIRE(not );
+
+	using namespace cif::literals;
+
+	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 0)));
+	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 1)));
+	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 2)));
+	REQUIRE(not	cat2.has_parents(cat2.find1("id"_key == 3)));
+	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 4)));
+	REQUIRE(not	cat2.has_parents(cat2.find1("id"_key == 5)));
+	REQUIRE(	cat2.has_parents(cat2.find1("id"_key == 6)));
+}
+
+// --------------------------------------------------------------------
+
+TEST_CASE("c1")
+{
+	cif::VERBOSE = 1;
+
+	auto f = R"(data_TEST
+#
+loop_
+_test.id
+_test.name
+1 aap
+2 noot
+3 mies
+4 .
+5 ?
+    )"_cf;
+
+	auto &db = f.front();
+
+	for (auto r : db["test"].find(cif::key("id") == 1))
+	{
+		const auto &[id, name] = r.get<int, std::string>("id", "name");
+		REQUIRE(id == 1);
+		REQUIRE(name == "aap");
+	}
+
+	for (auto r : db["test"].find(cif::key("id") == 4))
+	{
+		const auto &[id, name] = r.get<int, std::string>("id", "name");
+		REQUIRE(id == 4);
+		REQUIRE(name.empty());
+	}
+
+	for (auto r : db["test"].find(cif::key("id") == 5))
+	{
+		const auto &[id, name] = r.get<int, std::string>("id", "name");
+		REQUIRE(id == 5);
+		REQUIRE(name.empty());
+	}
+
+	// optional
+
+	for (auto r : db["test"])
+	{
+		const auto &[id, name] = r.get<int, std::optional<std::string>>("id", "name");
+		switch (id)
+		{
+			case 1: REQUIRE(name == "aap"); break;
+			case 2: REQUIRE(name == "noot"); break;
+			case 3: REQUIRE(name == "mies"); break;
+			case 4:
+			case 5: REQUIRE(not name); break;
+			default:
+				REQUIRE(false);
+		}
+	}
+}
+
+TEST_CASE("c1_param")
+{
+	auto f = R"(data_TEST
+#
+loop_
+_test.id
+_test.name
+_test.value
+1 aap  1
+2 noot 1
+3 mies 2
+4 .    2
+5 ?    3
+    )"_cf;
+
+	auto &cat = f.front()["test"];
+
+	auto c = cif::key("name") == cif::parameter(0) and cif::key("value") == cif::parameter(1);
+	c.prepare(cat);
+	REQUIRE(c.is_prepared());
+
+	CHECK(cat.contains(c.bind("aap", 1)));
+	CHECK(not cat.contains(c.bind("aap", 2)));
+	CHECK(cat.count(c.bind("mies", 2)) == 1);
+	CHECK(cat.count(c.bind("", 2)) == 1);
+	CHECK(cat.find(c.bind("noot", 1)).front()["id"].as<int>() == 2);
+
+	std::vector<int> ids;
+	for (auto r : cat.find(c.bind(std::string{}, 3)))
+		ids.push_back(r["id"].as<int>());
+	CHECK(ids == std::vector<int>{ 5 });
+
+	std::string_view values[] = { "noot", "1" };
+	CHECK(cat.find(c.bind(values)).front()["id"].as<int>() == 2);
+
+	// Missing values for the parameters
+	CHECK_THROWS(c.bind("aap"));
+
+	// An item that does not exist when preparing
+
+	auto c2 = cif::key("extra") == cif::parameter(0);
+	c2.prepare(cat);
+	CHECK(not cat.contains(c2.bind("x")));
+
+	cat.front()["extra"] = "x";
+	CHECK(cat.count(c2.bind("x")) == 1);
+
+	// erase, the condition can be used again afterwards
+
+	auto c3 = cif::key("value") == cif::parameter(0);
+	c3.prepare(cat);
+
+	CHECK(cat.erase(c3.bind(1)) == 2);
+	CHECK(cat.erase(c3.bind(2)) == 2);
+	CHECK(cat.size() == 1);
+}
+
+TEST_CASE("c1_block")
+{
+	// More rows than fit in one block
+	cif::category cat("test");
+
+	for (int i = 0; i < 2500; ++i)
+	{
+		cat.emplace({
+			{ "id", i },
+			{ "name", i % 7 == 0 ? "" : std::string(1, 'a' + i % 5) },
+			{ "value", i % 11 == 0 ? "?" : std::to_string(i % 13) } });
+	}
+
+	std::function<cif::condition()> factories[] = {
+		[]() { return cif::key("name") == "b"; },
+		[]() { return cif::key("name") == cif::null; },
+		[]() { return cif::key("name") != cif::null; },
+		[]() { return cif::key("value") > 5 and cif::key("value") <= 10.0; },
+		[]() { return cif::key("value") < 3 or cif::key("name") == "c"; },
+		[]() { return not(cif::key("name") == "a" or cif::key("name") == cif::null); },
+		[]() { return cif::key("name") == "d" or cif::key("name") == cif::null; },
+		[]() { return cif::key("value") >= 12 and cif::all(); },
+		[]() { return cif::key("name") == "e" and (cif::key("value") == 4 or cif::key("id") == 9); },
+	};
+
+	for (auto &f : factories)
+	{
+		size_t n = 0;
+		for (auto r : cat)
+		{
+			auto c = f();
+			c.prepare(cat);
+			if (c(r))
+				++n;
+		}
+
+		CHECK(n > 0);
+		CHECK(cat.count(f()) == n);
+		CHECK(cat.find(f()).size() == n);
+	}
+
+	auto c = cif::key("name") == cif::parameter(0);
+	c.prepare(cat);
+
+	CHECK(cat.count(c.bind("B")) == 0);
+	CHECK(cat.count(c.bind("b")) == cat.count(cif::key("name") == "b"));
+	CHECK(cat.count(c.bind("")) == cat.count(cif::key("name") == cif::null));
+}
+
+TEST_CASE("c1_range")
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+
+               int       numb
+               '[+-]?[0-9]+'
+
+               float     numb
+               '-?(([0-9]+)[.]?|([0-9]*[.][0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?'
+
+save_cat_1
+    _category.description     'A category with an integer key'
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+
+save_cat_2
+    _category.description     'A category with a float key'
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.x'
+    save_
+
+save__cat_2.x
+    _item.name                '_cat_2.x'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           float
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	std::string data = "data_test\nloop_\n_cat_1.id\n_cat_1.name\n";
+	for (int i = 0; i < 1000; ++i)
+		data += std::to_string((i * 7919) % 1000) + " n" + std::to_string(i % 3) + "\n";
+	data += ". n1\n? n2\n+1001 n0\n";
+
+	data += "loop_\n_cat_2.x\n";
+	for (int i = 0; i < 200; ++i)
+		data += std::to_string((i * 37) % 200) + "." + std::to_string(i % 10) + "\n";
+	data += "0.1\n0.10000001\n1.5(3)\n-1e2\n";
+
+	struct data_membuf : public std::streambuf
+	{
+		data_membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} data_buffer(data.data(), data.length());
+
+	std::istream is_data(&data_buffer);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.load(is_data);
+
+	auto &db = f.front();
+
+	auto check = [](cif::category &cat, std::function<cif::condition()> factory)
+	{
+		// the key values are unique
+		std::vector<std::string> expected;
+		for (auto r : cat)
+		{
+			auto c = factory();
+			c.prepare(cat);
+			if (c(r))
+				expected.emplace_back(r[0].text());
+		}
+
+		auto c = factory();
+		c.prepare(cat);
+		CHECK(c.range().has_value());
+
+		std::vector<std::string> found;
+		for (auto r : cat.find(factory()))
+			found.emplace_back(r[0].text());
+
+		std::sort(expected.begin(), expected.end());
+		std::sort(found.begin(), found.end());
+
+		CHECK(found == expected);
+		CHECK(cat.count(factory()) == expected.size());
+		CHECK(cat.contains(factory()) == not expected.empty());
+
+		found.clear();
+		for (auto r : cat.query().where(factory()))
+			found.emplace_back(r[0].text());
+
+		std::sort(found.begin(), found.end());
+
+		CHECK(found == expected);
+		CHECK(cat.query().where(factory()).count() == expected.size());
+	};
+
+	auto &cat1 = db["cat_1"];
+
+	check(cat1, []() { return cif::key("id") < 100; });
+	check(cat1, []() { return cif::key("id") <= 100; });
+	check(cat1, []() { return cif::key("id") > 900; });
+	check(cat1, []() { return cif::key("id") >= 900; });
+	check(cat1, []() { return cif::key("id") >= 100 and cif::key("id") <= 200; });
+	check(cat1, []() { return cif::key("id") > 100 and cif::key("id") < 200 and cif::key("name") == "n1"; });
+	check(cat1, []() { return cif::key("id") > 2000; });
+	check(cat1, []() { return cif::key("id") < -1; });
+	check(cat1, []() { return cif::key("id") >= 500 and cif::key("id") < 100; });
+
+	CHECK(cat1.count(cif::key("id") > 998) == 4);
+	CHECK(cat1.count(cif::key("id") >= 100 and cif::key("id") <= 200) == 101);
+
+	// A query uses the index as well, the rows are then in the order of the index
+	std::vector<int> ids;
+	for (int id : cat1.query().where(cif::key("id") >= 100).where(cif::key("id") < 105).select<int>("id"))
+		ids.push_back(id);
+	CHECK(ids == std::vector<int>{ 100, 101, 102, 103, 104 });
+	CHECK(cat1.query().where(cif::key("id") >= 100 and cif::key("id") < 105).limit(2).count() == 2);
+
+	// Values that are not integers compare larger than any number, whether the index is used or not
+	std::vector<cif::row_handle> malformed;
+	for (std::string_view id : { "-5abc", "1.5", "-3000000000" })
+	{
+		auto r = cat1.find1(cif::key("id") == static_cast<int>(malformed.size() + 5));
+		r.assign("id", id, true, false);
+		malformed.push_back(r);
+	}
+
+	check(cat1, []() { return cif::key("id") > 100; });
+	check(cat1, []() { return cif::key("id") >= 900 and cif::key("id") < 950; });
+	CHECK(cat1.count(cif::key("id") > 998) == 7);
+
+	for (size_t i = 0; i < malformed.size(); ++i)
+		malformed[i].assign("id", std::to_string(i + 5), true, false);
+
+	CHECK(cat1.count(cif::key("id") > 998) == 4);
+	check(cat1, []() { return cif::key("id") > 100; });
+
+	auto &cat2 = db["cat_2"];
+
+	check(cat2, []() { return cif::key("x") < 10.5; });
+	check(cat2, []() { return cif::key("x") <= 0.1f; });
+	check(cat2, []() { return cif::key("x") <= 0.1; });
+	check(cat2, []() { return cif::key("x") < 1.6f; });
+
+	// not on the key, or not a numeric comparison
+	auto c = cif::key("name") < 3;
+	c.prepare(cat1);
+	CHECK_FALSE(c.range().has_value());
+
+	c = cif::key("x") > 10.0;
+	c.prepare(cat2);
+	CHECK_FALSE(c.range().has_value());
+
+	c = cif::key("id") < 10 or cif::key("id") > 20;
+	c.prepare(cat1);
+	CHECK_FALSE(c.range().has_value());
+}
+
+TEST_CASE("query_1")
+{
+	cif::category cat("test");
+
+	for (int i = 0; i < 100; ++i)
+	{
+		cat.emplace({
+			{ "id", i },
+			{ "name", i % 2 ? "odd" : "even" },
+			{ "x", i * 0.5f },
+			{ "y", i * 1.5f },
+			{ "z", i % 10 == 0 ? "?" : std::to_string(i) } });
+	}
+
+	CHECK(cat.query().count() == 100);
+	CHECK(cat.query().limit(7).count() == 7);
+	CHECK(cat.query().where(cif::key("name") == "odd").count() == 50);
+	CHECK(cat.query().where(cif::key("name") == "odd").where(cif::key("id") < 10).count() == 5);
+	CHECK(cat.query().where(cif::key("name") == "odd").limit(100).count() == 50);
+	CHECK(cat.query().where(cif::key("name") == "none").empty());
+	CHECK(cat.query().where(cif::key("name") == "odd").where(cif::key("id") == 3));
+
+	int n = 0;
+	for (const auto &[id, x, y] : cat.query().where(cif::key("name") == "even").select<int, float, float>("id", "x", "y").limit(5))
+	{
+		CHECK(id == 2 * n);
+		CHECK(x == id * 0.5f);
+		CHECK(y == id * 1.5f);
+		++n;
+	}
+	CHECK(n == 5);
+
+	std::vector<std::optional<int>> z;
+	for (auto v : cat.query().where(cif::key("id") >= 9).select<std::optional<int>>("z").limit(3))
+		z.push_back(v);
+	CHECK(z == std::vector<std::optional<int>>{ 9, std::nullopt, 11 });
+
+	CHECK(cat.query().where(cif::key("id") > 42).select<std::string>("name").front() == "odd");
+
+	const auto &ccat = cat;
+	auto q = ccat.query().where(cif::key("id") == 3);
+	for (auto it = q.begin(); it != q.end(); ++it)
+		CHECK(it.row()["name"].as<std::string>() == "odd");
+
+	for (cif::row_handle r : ccat.query().where(cif::key("name") == "odd").limit(1))
+		CHECK(r["id"].as<int>() == 1);
 }
 
 TEST_CASE("c2")